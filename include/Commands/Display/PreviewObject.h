@@ -4,18 +4,21 @@
 #include "Commands/Display/PreviewMesh.h"
 #include "Commands/Display/PreviewTexture.h"
 #include "Commands/Display/ShaderProgram.h"
-#include "assimp/mesh.h"
-#include "assimp/scene.h"
+#include "FileTypes/LevelGeometry/Scene.h"
+#include <vector>
 
 namespace SPMEditor {
     class PreviewObject {
         public:
             ~PreviewObject();
             PreviewObject() = default;
-            PreviewObject(const aiScene* scene, aiNode* mesh);
+            /**
+             * @param meshCache One slot per scene mesh, objects that use the same scene mesh share its PreviewMesh
+             * @param nodeObjects One slot per scene node, filled with the object created for it. Null for nodes that aren't shown
+             */
+            PreviewObject(const Scene* scene, s32 nodeIndex, std::vector<PreviewMesh*>& meshCache, std::vector<PreviewObject*>& nodeObjects);
 
             void Draw(ShaderProgram& program, glm::mat4 parentMatrix, PreviewTexture* textures);
-            PreviewObject* FindNode(const char* name);
             void SetAnimationState(glm::vec3 pos, glm::vec3 rot, glm::vec3 scale) { 
                 mAnimPosition = pos; 
                 mAnimRotation = rot;
@@ -2,4 +2,5 @@
 
 namespace SPMEditor::TPLCommands {
     void Dump(u32 argc, const char** argv);
+    void List(u32 argc, const char** argv);
 }
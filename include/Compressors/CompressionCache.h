@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace SPMEditor
+{
+    /**
+     * @brief Persistent on disk cache of compressed data.
+     * Entries are keyed by a hash of the uncompressed bytes and the compression level so unchanged
+     * archives (the common case when rebuilding several maps) are copied from disk instead of recompressed.
+     *
+     * The cache lives in $SPME_CACHE_DIR, falling back to $XDG_CACHE_HOME/spme and then ~/.cache/spme.
+     * Setting SPME_NO_CACHE disables it entirely. Once the cache is over SPME_CACHE_MAX_MB megabytes (1024 by default)
+     * the least recently used entries are removed.
+     */
+    class CompressionCache {
+        public:
+            /**
+             * @brief Compresses data with LZSS::CompressLzss10, using a cached result when one exists
+             *
+             * @param data The uncompressed data
+             * @param size The number of bytes in data
+             * @return The lzss10 compressed data
+             */
+            static std::vector<u8> CompressLzss10(const u8* data, u64 size);
+
+            static bool TryGet(const u8* data, u64 size, u32 level, std::vector<u8>& outCompressed);
+            static void Store(const u8* data, u64 size, u32 level, const std::vector<u8>& compressed);
+
+        private:
+            static constexpr u64 DefaultMaxSize = 1024ull * 1024 * 1024;
+
+            struct EntryHeader {
+                static const u32 Magic = 0x53434348; // "SCCH"
+                u32 magic;
+                u32 level;
+                u64 uncompressedSize;
+                u64 hash;
+                u64 compressedSize;
+            };
+
+            static bool IsEnabled();
+            /**
+             * @brief Removes the least recently used entries until the cache is under its size limit
+             */
+            static void Trim();
+            static std::string GetCacheDirectory();
+            static std::string GetEntryPath(u64 hash, u64 size, u32 level);
+    };
+}
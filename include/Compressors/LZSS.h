@@ -5,6 +5,9 @@ namespace SPMEditor
 {
     class LZSS {
         public:
+            // Identifies the output of CompressLzss10. Bump this whenever the compressor changes so cached results are not reused
+            static constexpr u32 Lzss10Level = 0;
+
             static std::vector<u8> DecompressBytes(const u8* data, int length);
             static std::vector<u8> CompressLzss10(const std::vector<u8>& data);
             static std::vector<u8> CompressLzss10(u8* data, u64 size);
@@ -1,7 +1,7 @@
 #pragma once
 #include "FileTypes/LevelGeometry/MapStructures.h"
+#include "FileTypes/LevelGeometry/Scene.h"
 #include "FileTypes/U8Archive.h"
-#include "assimp/scene.h"
 #include <vector>
 
 namespace SPMEditor {
@@ -13,7 +13,7 @@ namespace SPMEditor {
 
             U8Archive u8Files;
             std::string name;
-            aiScene* geometry;
+            Scene* geometry;
             std::vector<MapStructures::FogEntry> fogSettings;
     };
 }
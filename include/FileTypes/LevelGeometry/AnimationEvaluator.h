@@ -0,0 +1,59 @@
+#pragma once
+#include "FileTypes/LevelGeometry/Scene.h"
+#include <vector>
+
+namespace SPMEditor {
+    struct AnimationPose {
+        Vector3 mPosition;
+        Vector3 mRotation; // Euler angles in radians
+        Vector3 mScale;
+    };
+
+    /**
+     * @brief Plays back every transform animation of a scene. The keys of all channels are copied into one array per property,
+     * and each channel remembers the key it sampled last, so playing forward only ever looks at the next key
+     */
+    class AnimationEvaluator {
+        public:
+            AnimationEvaluator(const Scene* scene);
+
+            // Channels are numbered across every animation, in the order the scene lists them
+            u32 GetChannelCount() const { return mChannels.size(); }
+            s32 GetChannelNode(u32 channel) const { return mChannels[channel].mNode; }
+
+            /**
+             * @brief Gets the pose of the channel's first key, which the animation's other keys are relative to
+             */
+            AnimationPose GetRestPose(u32 channel) const;
+
+            /**
+             * @brief Samples one channel, interpolating linearly between the keys around the time.
+             * Times before the first key or after the last one hold that key
+             *
+             * @param time The time in frames, wrapped to the duration of the channel's animation. A double so long running clocks keep their fraction
+             */
+            AnimationPose Sample(u32 channel, double time);
+
+            /**
+             * @brief Samples every channel at the same time
+             *
+             * @param poses One pose per channel
+             */
+            void Evaluate(double time, AnimationPose* poses);
+
+        private:
+            struct Channel {
+                s32 mNode;
+                u32 mFirstKey; // Index into the key arrays
+                u32 mKeyCount;
+                u32 mCursor; // The key sampled last, relative to mFirstKey
+                float mDuration;
+            };
+
+            std::vector<Channel> mChannels;
+            std::vector<float> mTimes;
+            std::vector<Vector3> mPositions;
+            std::vector<Vector3> mRotations;
+            std::vector<Vector3> mScales;
+    };
+}
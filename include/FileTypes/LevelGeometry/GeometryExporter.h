@@ -1,5 +1,6 @@
 #pragma once
 #include "FileTypes/LevelGeometry/MapStructures.h"
+#include "FileTypes/LevelGeometry/TextureAtlas.h"
 #include "FileTypes/MapConfig.h"
 #include "assimp/scene.h"
 #include <map>
@@ -9,7 +10,6 @@ namespace SPMEditor {
     // Todo
     // Add lights
     // Add fog
-    // Optimize triangle strips, like at all
     class GeometryExporter {
         public:
             ~GeometryExporter();
@@ -63,6 +63,42 @@ namespace SPMEditor {
             void WriteVertexData(u8 vertexScale = 8, u8 uvScale = 8);
             void GetMeshDataRecursive(const aiNode* node);
 
+            // Textures
+            /**
+             * @brief Decodes the scene textures into mTextures, leaving out duplicates
+             */
+            void BuildTextureList();
+            /**
+             * @brief Gets the format of each texture in mTextures, choosing automatic formats on its source image. Choosing encodes the image in every candidate format
+             *
+             * @param sources The decoded image of each texture in mTextures
+             */
+            std::vector<TPLImageFormat> ChooseTextureFormats(const std::vector<TPL::Image>& sources);
+            /**
+             * @brief Downscales the textures in mTextures that are over the texture size limit, or together over maxMapSize bytes.
+             * With a map budget, automatic formats are chosen on the final pixels and stored in mTextureConfigs
+             *
+             * @param sources The decoded image of each texture in mTextures, textures are always resized from these
+             * @param sourceFormats The formats from ChooseTextureFormats, only used with a map budget
+             * @param maxMapSize The most bytes of texture data, 0 for no limit
+             * @return Whether the textures fit in maxMapSize
+             */
+            bool EnforceTextureBudget(const std::vector<TPL::Image>& sources, const std::vector<TPLImageFormat>& sourceFormats, u64 maxMapSize);
+            /**
+             * @brief Packs small textures that share a texture config into atlas pages, replacing them in mTextures
+             */
+            void BuildTextureAtlas();
+            /**
+             * @brief Finds the scene texture used by a material
+             *
+             * @return The index of the texture in the scene, or -1 if the material is untextured
+             */
+            int FindMaterialTexture(u32 materialIndex);
+            /**
+             * @brief Gets the UV of a vertex, moved into the texture's atlas page if it has one
+             */
+            aiVector3D GetMeshUV(const aiMesh* mesh, u32 vertex);
+
 
             /**
              * @brief Adds a string to the string table. If the string was already added to the table, the previous string's offset is returned.
@@ -121,6 +157,15 @@ namespace SPMEditor {
             std::vector<MaterialSubData> mMaterialSubdatas;
             std::vector<int> mPointerList;
 
+            // Textures written to the tpl. Unique scene textures that weren't packed into an atlas, followed by the atlas pages
+            std::vector<aiTexture*> mTextures;
+            std::vector<TextureConfig> mTextureConfigs;
+            std::vector<int> mTextureRemap; // Scene texture index to index in mTextures
+            std::vector<TextureAtlasRect> mAtlasRects; // For each scene texture, mPage is the index of its page in mTextures or -1
+            u32 mAtlasPageCount; // The number of pages at the end of mTextures
+            std::vector<aiTexture*> mOwnedTextures; // Decoded copies of the scene textures and atlas pages
+            std::vector<int> mMaterialTextures; // The scene texture of each material, or -1
+
             std::vector<int> mTextureNameTable;
             std::map<std::string, int> mTextureNameToIndex;
             std::vector<int> mMeshTable;
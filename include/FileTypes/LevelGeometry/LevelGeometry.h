@@ -3,15 +3,67 @@
 #include "FileTypes/TPL.h"
 #include "assimp/scene.h"
 #include "FileTypes/LevelGeometry/MapStructures.h"
+#include "FileTypes/LevelGeometry/Scene.h"
+#include <unordered_map>
 
 using namespace SPMEditor::MapStructures;
 
 namespace SPMEditor {
+    // The map.dat sections the loader understands
+    enum class MapSection : u32 {
+        Information,
+        TextureTable,
+        MaterialNameTable,
+        VCDTable,
+        LightTable,
+        FogTable,
+        AnimationTable,
+        CurveTable,
+        Count,
+    };
+
     class LevelGeometry
     {
         public:
-            static aiScene* LoadFromBytes(const std::vector<u8>& data, TPL textures, LevelData* level);
-            static aiScene* LoadFromBytes(const u8* data, u64 size, TPL textures, LevelData* level);
+            static Scene* LoadFromBytes(const std::vector<u8>& data, TPL textures, LevelData* level);
+            static Scene* LoadFromBytes(const u8* data, u64 size, TPL textures, LevelData* level);
+
+            /**
+             * @brief Replaces every uncompressed texture in an assimp scene with an embedded PNG, for exporters that can't store raw texels.
+             * Used on the result of Scene::ToAssimp
+             */
+            static void EncodeTexturesAsPNG(aiScene* scene);
+
+            /**
+             * @brief Reads only the file header and the section table. Each section is decoded the first time one of the getters below needs it,
+             * along with the sections it depends on. The data and textures must stay alive as long as the LevelGeometry does
+             *
+             * @param textures The map's texture.tpl, or null to only read the texture names
+             */
+            LevelGeometry(const u8* data, u64 size, const TPL* textures = nullptr);
+            ~LevelGeometry();
+            LevelGeometry(const LevelGeometry&) = delete;
+            LevelGeometry& operator=(const LevelGeometry&) = delete;
+
+            bool HasSection(MapSection section) const { return mSectionOffsets[(u32)section] != -1; }
+
+            const SceneTexture* GetTextures(u32& count);
+            const SceneMaterial* GetMaterials(u32& count);
+            const SceneNode* GetObjects(u32& count); // Also fills in the scene's node meshes
+            const SceneMesh* GetMeshes(u32& count);
+            const SceneAnimation* GetAnimations(u32& count);
+            const std::vector<FogEntry>& GetFog();
+            u32 GetLightCount();
+
+            /**
+             * @return The scene holding every section decoded so far, still owned by the LevelGeometry
+             */
+            Scene* GetScene() { return mScene; }
+
+            /**
+             * @brief Hands the scene over to the caller. The getters can't be used afterwards
+             */
+            Scene* ReleaseScene();
 
         private:
             struct Vertex
@@ -22,27 +74,62 @@ namespace SPMEditor {
                 Vector2 uv;
             };
 
-            static Section FindSection(const std::string& name, int sectionTableOffset, int sectionCount);
-            static void ReadSection(Section section);
-            static void ReadMaterialNameTable(int tableOffset, int textureCount);
-            static aiNode* ReadInfoSection(int offset, std::vector<aiMesh*>& meshes);
-            static aiNode* ReadObject(int objectOffset, int& nextSibling, std::vector<aiMesh*>& meshes, std::string indent = "");
-            static aiMesh* ReadMesh(int offset);
-            static void ReadFogTable(int offset);
-            static void ReadAnimationTable(int tableOffset);
-            static void ReadTextureAnimation(int offset);
-            static void ReadTransformAnimation(int offset, aiAnimation* animation);
-            static void ReadCurveTable(int offset);
-
-            static std::vector<std::string> ReadTextureNames(int offset);
-            static VCDTable ReadVCDTable(int offset);
-            static void ReadVertices(VCDTable vcd, int offset, VertexAttributes attributes, std::vector<Vertex>& vertices, std::vector<int>& indices);
-
-
-            static const u8* sData;
-            static aiScene* sCurrentScene;
-            static int s_FirstMaterialAddress; // Required to calculate the material index for each mesh
-            static VCDTable s_VCDTable;
-            static LevelData* s_CurrentLevel;
+            // A mesh found while reading the object tree, decoded once the whole tree is read
+            struct MeshReference
+            {
+                int offset;
+                u32 materialIndex;
+                const char* name;
+            };
+
+            // Set for each section once it is decoded
+            bool IsRead(MapSection section) const { return (mReadSections & (1u << (u32)section)) != 0; }
+            void MarkRead(MapSection section) { mReadSections |= 1u << (u32)section; }
+
+            void ReadSectionDirectory(int sectionTableOffset, int sectionCount);
+            void ReadMaterialNameTable(int tableOffset);
+            void ReadInfoSection(int offset);
+            /**
+             * @return The index of the object's node in mNodes
+             */
+            s32 ReadObject(int objectOffset, s32 parent, int& nextSibling, std::string indent = "");
+            void ReadMesh(int offset, SceneMesh& mesh);
+            void ReadFogTable(int offset);
+            void ReadAnimationTable(int tableOffset);
+            void ReadTextureAnimation(int offset);
+            void ReadTransformAnimation(int offset, SceneAnimation& animation);
+            void ReadCurveTable(int offset);
+
+            std::vector<std::string> ReadTextureNames(int offset);
+            /**
+             * @brief Reads the VCD table into mVCDTable and dequantizes its positions, normals and uvs
+             */
+            void ReadVCDTable(int offset);
+            /**
+             * @brief Reads a triangle strip, adding only the vertices whose indices haven't been seen in the mesh yet
+             *
+             * @param vertexLookup The vertex for each set of indices read so far, shared by every strip of a mesh
+             */
+            void ReadVertices(int offset, VertexAttributes attributes, std::vector<Vertex>& vertices, std::vector<int>& indices, std::unordered_map<u64, int>& vertexLookup);
+
+            // Parse state of a single map.dat
+            const u8* mData;
+            u64 mSize;
+            const TPL* mTPL;
+            Scene* mScene;
+            s32 mSectionOffsets[(u32)MapSection::Count]; // -1 for sections the file doesn't have
+            u32 mReadSections;
+
+            int mFirstMaterialAddress; // Required to calculate the material index for each mesh
+            VCDTable mVCDTable;
+            std::vector<float> mPositions; // The VCD arrays as floats, with the components of each entry next to each other
+            std::vector<float> mNormals;
+            std::vector<float> mUVs;
+            int mObjectCount;
+            std::unordered_map<u64, u32> mMeshIndices; // Mesh offset and material index to the index of the mesh in the scene
+            std::vector<MeshReference> mMeshReferences;
+            std::vector<SceneNode> mNodes; // The object tree while it is read, moved into the scene's arena afterwards
+            std::vector<u32> mNodeMeshes;
+            std::vector<FogEntry> mFog;
     };
 }
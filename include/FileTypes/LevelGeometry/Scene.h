@@ -0,0 +1,122 @@
+#pragma once
+#include "Types/Types.h"
+#include "assimp/scene.h"
+#include "core/arena.h"
+
+namespace SPMEditor {
+    struct SceneMesh {
+        const char* mName;
+        u32 mMaterialIndex;
+        u32 mVertexCount;
+        u32 mIndexCount; // Three per triangle
+
+        // One array per attribute, each mVertexCount long. mColors is null when the mesh has no vertex colors
+        Vector3* mPositions;
+        Vector3* mNormals;
+        Vector2* mUVs;
+        Color* mColors;
+        u32* mIndices;
+    };
+
+    struct SceneMaterial {
+        const char* mName;
+        const char* mTextureName; // Null when the material has no texture
+        s32 mTextureIndex; // Index into Scene::mTextures, -1 when the material has no texture
+        Color mColor;
+    };
+
+    struct SceneTexture {
+        const char* mName;
+        u32 mWidth;
+        u32 mHeight;
+        Color* mPixels; // RGBA, top row first
+    };
+
+    struct SceneNode {
+        const char* mName;
+        u64 mNameHash;
+
+        // Indices into Scene::mNodes, -1 when there is none
+        s32 mParent;
+        s32 mFirstChild;
+        s32 mNextSibling;
+
+        Vector3 mPosition;
+        Vector3 mRotation; // Euler angles in radians
+        Vector3 mScale;
+
+        u32 mFirstMesh; // Index into Scene::mNodeMeshes
+        u32 mMeshCount;
+    };
+
+    struct SceneKeyframe {
+        float mTime; // In frames
+        Vector3 mPosition;
+        Vector3 mRotation; // Euler angles in radians
+        Vector3 mScale;
+    };
+
+    struct SceneAnimationChannel {
+        s32 mNode;
+        u32 mKeyframeCount;
+        SceneKeyframe* mKeyframes;
+    };
+
+    struct SceneAnimation {
+        const char* mName;
+        float mDuration; // In frames
+        float mFramesPerSecond;
+        u32 mChannelCount;
+        SceneAnimationChannel* mChannels;
+    };
+
+    /**
+     * @brief A map as it is decoded from map.dat. Every array and string lives in one arena, so the whole scene is freed at once
+     */
+    class Scene {
+        public:
+            Scene();
+            ~Scene();
+            Scene(const Scene&) = delete;
+            Scene& operator=(const Scene&) = delete;
+
+            /**
+             * @brief Sorts the nodes by their name hashes for FindNode. Called once the node array is final
+             */
+            void BuildNodeIndex();
+
+            /**
+             * @return The index of the first node with the name, or -1 if there is none
+             */
+            s32 FindNode(const char* name) const;
+
+            /**
+             * @brief Copies the scene into a new aiScene, for assimp's exporters. Textures are uncompressed aiTexels, see LevelGeometry::EncodeTexturesAsPNG
+             */
+            aiScene* ToAssimp() const;
+
+            Arena* mArena;
+
+            SceneNode* mNodes; // Parents come before their children, node 0 is the root
+            u32 mNodeCount;
+            u32* mNodeMeshes; // The mesh indices of every node, back to back
+            u32 mNodeMeshCount;
+
+            SceneMesh* mMeshes;
+            u32 mMeshCount;
+            SceneMaterial* mMaterials;
+            u32 mMaterialCount;
+            SceneTexture* mTextures;
+            u32 mTextureCount;
+            SceneAnimation* mAnimations;
+            u32 mAnimationCount;
+
+        private:
+            struct NodeIndexEntry {
+                u64 mNameHash;
+                s32 mNode;
+            };
+
+            NodeIndexEntry* mNodeIndex; // mNodeCount entries sorted by hash
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "FileTypes/LevelGeometry/MapStructures.h"
+#include <vector>
+
+namespace SPMEditor {
+    struct TextureAtlasRect {
+        int mWidth; // The size of the texture, without the guard band
+        int mHeight;
+
+        // Set by TextureAtlas::Pack
+        int mPage = -1;
+        int mX = 0; // The top left pixel of the texture in the page, inside the guard band
+        int mY = 0;
+    };
+
+    struct TextureAtlasPage {
+        int mWidth;
+        int mHeight;
+    };
+
+    class TextureAtlas {
+        public:
+            // Pixels copied around each texture so filtering doesn't sample a neighbouring texture.
+            // One GX block wide, so block based formats never mix two textures in one block
+            static constexpr int GuardBand = 4;
+            // Each mip level halves the guard band, so past log2(GuardBand) levels below the base it is gone and pages stop there
+            static constexpr int MaxMipmapCount = 3;
+
+            /**
+             * @brief Packs rects into as few pages as possible using MaxRects with the best short side fit heuristic
+             *
+             * @param pageSize The maximum width and height of a page. Must be a power of two
+             * @return The pages, each shrunk to the smallest power of two size that holds its rects
+             */
+            static std::vector<TextureAtlasPage> Pack(std::vector<TextureAtlasRect>& rects, int pageSize);
+
+            /**
+             * @brief Copies a texture into its page and fills the rest of its cell, the guard band and the padding to the block size, by wrapping the texture with its wrap modes
+             */
+            static void Blit(const Color* pixels, const TextureAtlasRect& rect, MapStructures::MapTexture::WrapMode wrapU, MapStructures::MapTexture::WrapMode wrapV, Color* page, int pageWidth);
+    };
+}
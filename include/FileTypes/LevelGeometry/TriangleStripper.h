@@ -0,0 +1,23 @@
+#pragma once
+#include "Types/Types.h"
+#include <vector>
+
+namespace SPMEditor {
+    class TriangleStripper {
+        public:
+            // Strips store their vertex count as a u16
+            static constexpr u32 MaxStripLength = 0xffff;
+
+            /**
+             * @brief Converts triangles into strips with a greedy SGI style stripifier. Each strip starts at the unused triangle with the
+             * fewest unused neighbours out of the next few in the input order, and is grown from whichever of its edges gives the longest strip.
+             * Strips are made in roughly the input order, so triangles sorted by VertexCache::Optimize stay in a cache friendly order.
+             * Strips keep the winding of the triangles: triangle k of a strip is (k, k + 1, k + 2) for even k and (k + 1, k, k + 2) for odd k
+             *
+             * @param triangles Three vertex indices per triangle. Triangles that use a vertex twice are left out
+             * @param stitch Joins the strips into as few strips as possible with degenerate triangles
+             * @param maxLength The most vertices in one strip, at least 3
+             */
+            static std::vector<std::vector<u32>> Build(const std::vector<u32>& triangles, bool stitch, u32 maxLength = MaxStripLength);
+    };
+}
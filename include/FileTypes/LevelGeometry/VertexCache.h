@@ -0,0 +1,26 @@
+#pragma once
+#include "Types/Types.h"
+#include <vector>
+
+namespace SPMEditor {
+    class VertexCache {
+        public:
+            // The GX keeps recently fetched indexed vertices in a small cache. Its exact size isn't documented, so this is an estimate
+            static constexpr u32 GXCacheSize = 16;
+
+            /**
+             * @brief Reorders triangles so they reuse the vertices of recent triangles, with Tom Forsyth's linear-speed vertex cache optimisation
+             *
+             * @param triangles Three vertex indices per triangle. Each triangle keeps its winding
+             * @param vertexCount One more than the largest index
+             * @return The reordered triangles
+             */
+            static std::vector<u32> Optimize(const std::vector<u32>& triangles, u32 vertexCount, u32 cacheSize = GXCacheSize);
+
+            /**
+             * @brief Counts the vertices a FIFO cache would have to fetch while drawing a stream of vertices.
+             * Divided by the triangle count this is the average cache miss ratio (ACMR)
+             */
+            static u32 CountMisses(const u32* vertices, size_t count, u32 cacheSize = GXCacheSize);
+    };
+}
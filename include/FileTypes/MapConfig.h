@@ -15,6 +15,10 @@ namespace SPMEditor {
         bool mUseTransparency;
         MapTexture::WrapMode mWrapModeU;
         MapTexture::WrapMode mWrapModeV;
+        TPLImageFormat mFormat = TPLImageFormat::RGBA32;
+        TPLCompressionQuality mCompressionQuality = TPLCompressionQuality::Fast; // Only used by CMPR, C4 and C8
+        bool mDither = false; // Only used by C4 and C8
+        bool mGenerateMipmaps = false; // Only used by power of two textures that aren't C4 or C8
     };
 
     struct MaterialConfig {
@@ -23,10 +27,26 @@ namespace SPMEditor {
         bool mUseVertexColor;
     };
 
+    // Packs small textures with matching settings into shared atlas pages
+    struct AtlasConfig {
+        bool mEnabled = false;
+        u32 mMaxTextureSize = 128; // Textures with a larger side are left on their own
+        u32 mPageSize = 512; // Must be a power of two. Larger textures than 512x512 are untested in game
+    };
+
+    // Limits on texture memory, textures over the limits are downscaled when exporting
+    struct TextureBudgetConfig {
+        u32 mMaxTextureSize = 512; // The largest width or height of a single texture
+        u32 mMaxMapSize = 0; // The most bytes of texture data in a map, 0 for no limit
+    };
+
     struct MapConfig {
         std::string mMapName;
         std::vector<TextureConfig> mTextureConfigs;
         std::vector<MaterialConfig> mMaterialConfigs;
+        AtlasConfig mAtlasConfig;
+        TextureBudgetConfig mTextureBudget;
+        bool mStitchStrips = true; // Joins the triangle strips of each mesh with degenerate triangles
 
         /**
          * @brief Creates a config from an existing model (i.e. he1_01.glb)
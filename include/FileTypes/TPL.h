@@ -1,5 +1,7 @@
 #pragma once
 #include "assimp/texture.h"
+#include <memory>
+#include <span>
 #include <vector>
 namespace SPMEditor
 {
@@ -15,11 +17,29 @@ namespace SPMEditor
         C8 = 9,
         C14X2 = 0xA,
         CMPR = 0xE,
+        Auto = 0xFFFFFFFF, // Not stored in files, CreateTPL replaces it with the smallest format that fits the image content
+    };
+
+    // The format of the entries in a C4 / C8 / C14X2 palette
+    enum class TPLPaletteFormat : u32 {
+        IA8 = 0,
+        RGB565 = 1,
+        RGB5A3 = 2,
+    };
+
+    // Controls the speed / quality trade off of lossy encoders
+    enum class TPLCompressionQuality : u32 {
+        Fast = 0, // Range fit, endpoints are the extremes along the principal axis
+        High = 1, // Cluster fit, tries every ordered partition of the block's colors
     };
 
     struct TPLImageCreateInfo {
         aiTexture* mTexture;
         TPLImageFormat mFormat;
+        TPLCompressionQuality mQuality;
+        bool mDither; // Only used by palette formats
+        bool mGenerateMipmaps; // Ignored for palette formats and textures that aren't a power of two in size
+        int mMaxMipmapCount; // The most levels to generate including the base level, 0 for the full chain
     };
 
     class TPLCreateInfo {
@@ -37,6 +57,16 @@ namespace SPMEditor
                 Mirror = 2,
             };
 
+            // GX texture filters, used for minFilter and magFilter
+            enum class ImageFilter : u32 {
+                Near = 0,
+                Linear = 1,
+                NearMipNear = 2,
+                LinearMipNear = 3,
+                NearMipLinear = 4,
+                LinearMipLinear = 5,
+            };
+
             struct ImageHeader
             {
                 u16	height;
@@ -53,7 +83,7 @@ namespace SPMEditor
                 u8	maxLOD;
                 u8	padding;
 
-                ImageHeader SwapBytes();
+                ImageHeader SwapBytes() const;
             };
 
             struct Image
@@ -61,6 +91,9 @@ namespace SPMEditor
                 ImageHeader header;
                 std::string name;
                 std::vector<Color> pixels;
+                TPLCompressionQuality quality = TPLCompressionQuality::Fast; // Used when writing lossy formats
+                bool dither = false; // Used when writing palette formats
+                std::vector<std::vector<Color>> mipmaps; // Levels after the base level, each half the size of the one before
             };
 
             std::vector<Image> images;
@@ -72,38 +105,137 @@ namespace SPMEditor
 
             void Write(const std::string& path);
 
+            /**
+             * @brief Gets the RGBA pixels of an embedded texture, decoding it first if it is compressed (mHeight == 0)
+             */
+            static std::vector<Color> ReadTexturePixels(const aiTexture* texture, int& width, int& height);
+
+            /**
+             * @brief Creates an uncompressed aiTexture (mHeight != 0) holding a copy of the image's pixels in aiTexel (BGRA) order
+             */
+            static aiTexture* CreateTexture(const Image& image);
+
+            static void GetBlockSize(TPLImageFormat format, int& width, int& height);
+            static u32 GetBlockByteSize(TPLImageFormat format);
+            static u32 GetImageDataSize(TPLImageFormat format, int width, int height);
+            static const char* GetFormatName(TPLImageFormat format);
+            static bool IsPaletteFormat(TPLImageFormat format);
+
+            /**
+             * @brief Finds the format with the given name (i.e. "CMPR")
+             *
+             * @return false if no format has that name
+             */
+            static bool TryParseFormatName(const std::string& name, TPLImageFormat& format);
+
+            /**
+             * @brief Decodes a whole image from its encoded blocks
+             *
+             * @param output width * height pixels
+             * @param palette The palette of palette formats, ignored by other formats
+             */
+            static void DecodeImage(const u8* data, int width, int height, TPLImageFormat format, Color* output, const Color* palette = nullptr);
+
+            /**
+             * @brief Decodes one block of encoded image data
+             *
+             * @param data The encoded block
+             * @param output The top left pixel of the block in the output image
+             * @param stride The width of the output image in pixels
+             */
+            typedef void (*BlockDecoder)(const u8* data, Color* output, int stride);
+
+            // Scalar decoders are the reference, the SIMD ones must match them bit for bit
+            enum class DecoderBackend {
+                Scalar,
+                SSE41,
+                AVX2,
+                Best, // The fastest backend supported by the cpu
+            };
+
+            /**
+             * @brief Gets the block decoder for a format. Falls back to the scalar decoder if the backend is unsupported by the cpu or format
+             */
+            static BlockDecoder GetBlockDecoder(TPLImageFormat format, DecoderBackend backend = DecoderBackend::Best);
+
         private:
+            friend class TPLView;
+
             struct Header {
                 int magic;
                 int numImages;
                 int imageTableOffset;
 
-                Header SwapBytes();
+                Header SwapBytes() const;
             };
 
             struct ImageOffset {
                 int headerOffset;
                 int paletteOffset;
 
-                ImageOffset SwapBytes();
+                ImageOffset SwapBytes() const;
             };
 
             struct PaletteHeader {
-                enum struct Format : u32 { IA8 = 0, RGB565 = 1, RGB5A3 = 2};
                 u16 entryCount;
                 u8 unpacked;
                 u8 padding;
-                Format format;
+                TPLPaletteFormat format;
                 u32 dataOffset;
 
-                PaletteHeader SwapBytes();
+                PaletteHeader SwapBytes() const;
             };
 
         private:
-            static void GetBlockSize(TPLImageFormat format, int& width, int& height);
-            static std::vector<Color> ReadBlock(const u8* data, ImageHeader header, int xPos, int yPos);
-            static std::vector<Color> ReadImage(const u8* data, ImageHeader imageHeader);
-            static std::vector<Color> ReadCMPRBlock(const u8* data);
-            static std::vector<Color> ReadRGBA32Block(const u8* data);
+            static std::vector<Color> ReadPalette(const u8* data, const PaletteHeader& paletteHeader, TPLImageFormat imageFormat);
+            /**
+             * @brief Decodes an image, or a band of its block rows, into output
+             *
+             * @param data The start of the image data, not the band
+             * @param output The whole image
+             * @param blockRowCount The number of block rows to decode starting from firstBlockRow, or -1 for the rest of the image
+             */
+            static void ReadImageInto(const u8* data, const ImageHeader& imageHeader, Color* output, const Color* palette = nullptr, int firstBlockRow = 0, int blockRowCount = -1);
+    };
+
+    /**
+     * @brief A TPL whose headers are read up front but whose images are only decoded when asked for.
+     * Use this over TPL::LoadFromBytes when only some of the images or just their headers are needed
+     */
+    class TPLView
+    {
+        public:
+            static TPLView LoadFromFile(const std::string& path);
+            /**
+             * @brief Reads the headers of a TPL without decoding any images
+             *
+             * @param data Not copied, must outlive the view
+             */
+            static TPLView LoadFromBytes(const u8* data, u64 size);
+
+            u32 GetImageCount() const;
+            const TPL::ImageHeader& GetImageHeader(u32 index) const;
+            /**
+             * @brief Gets the number of levels stored for an image, including the base level.
+             * Only images with a mipmap min filter have more than one, and levels past the end of the image's data aren't counted
+             */
+            u32 GetMipLevelCount(u32 index) const;
+
+            TPL::Image DecodeImage(u32 index) const;
+            /**
+             * @brief Decodes an image into output, which must hold at least width * height pixels
+             */
+            void DecodeImageInto(u32 index, std::span<Color> output) const;
+
+        private:
+            friend class TPL;
+
+            std::vector<Color> ReadPalette(u32 index) const;
+
+            const u8* m_Data = nullptr;
+            u64 m_Size = 0;
+            std::shared_ptr<u8[]> m_File; // Only set when the view owns its data
+            std::vector<TPL::ImageHeader> m_ImageHeaders;
+            std::vector<u32> m_PaletteOffsets; // 0 for images without a palette
     };
 }
@@ -0,0 +1,83 @@
+#pragma once
+#include "FileTypes/TPL.h"
+#include <vector>
+
+namespace SPMEditor
+{
+    struct TPLPalette {
+        TPLPaletteFormat mFormat;
+        u16 mEntryCount;
+        std::vector<u8> mData; // Big endian entries, ready to be written
+        std::vector<Color> mColors; // The entries as the decoder will read them
+    };
+
+    struct TPLFormatChoice {
+        TPLImageFormat mFormat;
+        u32 mSize; // Image data and palette size in bytes
+        double mPSNR; // Of the decoded image against the source, infinite if lossless
+    };
+
+    /**
+     * @brief Converts RGBA pixels into the block layouts used by TPL images
+     */
+    class TPLEncoder
+    {
+        public:
+            // Lowest PSNR in dB that ChooseFormat accepts, below this compression artifacts become easy to spot
+            static constexpr double AutoFormatMinPSNR = 36.0;
+
+            static bool SupportsFormat(TPLImageFormat format);
+
+            /**
+             * @brief Picks the smallest format that can hold the image with a PSNR of at least AutoFormatMinPSNR.
+             * Candidates are limited by the alpha channel (none, 1 bit or graded) and whether the image is grayscale, then each is encoded and measured.
+             */
+            static TPLFormatChoice ChooseFormat(const Color* pixels, int width, int height, TPLCompressionQuality quality, bool dither);
+
+            /**
+             * @brief Gets the peak signal to noise ratio of an image over the RGBA channels. The color of pixels that are transparent in both images is ignored
+             */
+            static double GetPSNR(const Color* a, const Color* b, u64 pixelCount);
+
+            /**
+             * @brief Encodes a full image. Blocks that extend past the edge of the image are padded by repeating the edge pixels.
+             *
+             * @param pixels Row major pixels, width * height long
+             * @param quality Only used by lossy formats (CMPR, C4, C8)
+             * @param dither Dithers palette formats, otherwise ignored
+             * @param palette Output for the palette of palette formats, must not be null for them
+             * @return The encoded image data, TPL::GetImageDataSize(format, width, height) bytes long
+             */
+            static std::vector<u8> EncodeImage(const Color* pixels, int width, int height, TPLImageFormat format, TPLCompressionQuality quality, bool dither = false, TPLPalette* palette = nullptr);
+
+            /**
+             * @brief Halves an image with a gamma correct, alpha weighted 2x2 box filter. Dimensions of 1 are kept.
+             *
+             * @return max(width / 2, 1) * max(height / 2, 1) pixels
+             */
+            static std::vector<Color> Downsample(const Color* pixels, int width, int height);
+
+            /**
+             * @brief Resizes an image with a gamma correct, alpha weighted Lanczos-3 filter
+             *
+             * @return outputWidth * outputHeight pixels
+             */
+            static std::vector<Color> Resize(const Color* pixels, int width, int height, int outputWidth, int outputHeight);
+
+            /**
+             * @brief Gets the number of levels in a full mipmap chain including the base level, or 1 if the size can't be mipmapped
+             */
+            static int GetMipmapCount(int width, int height);
+
+            /**
+             * @brief Encodes one 8x8 CMPR block (2x2 DXT1 sub blocks) into 32 bytes
+             *
+             * @param pixels The top left pixel of the block
+             * @param stride The width in pixels of the rows of pixels
+             */
+            static void EncodeCMPRBlock(const Color* pixels, int stride, TPLCompressionQuality quality, u8* output);
+
+        private:
+            static void EncodeDXT1Block(const Color* pixels, int stride, TPLCompressionQuality quality, u8* output);
+    };
+}
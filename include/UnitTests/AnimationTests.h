@@ -0,0 +1,6 @@
+#pragma once
+
+namespace SPMEditor::Testing {
+
+    bool TestAnimationEvaluator();
+}
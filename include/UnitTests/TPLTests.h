@@ -0,0 +1,13 @@
+#pragma once
+
+namespace SPMEditor::Testing {
+
+    bool TestTPLDecoderBackends();
+    bool TestTPLCMPREncoder();
+    bool TestTPLPaletteRoundTrip();
+    bool TestTPLAutoFormat();
+    bool TestTPLMipmaps();
+    bool TestTPLResize();
+    bool TestTPLParallelDecode();
+    bool TestTPLLazyDecode();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace SPMEditor {
+    typedef struct Arena Arena;
+
+    /**
+     * @brief Creates a bump allocator. Memory is handed out from large blocks and only given back all at once by arena_destroy,
+     * so anything allocated from an arena must not need its destructor to run.
+     *
+     * @param blockSize The size of each block, allocations bigger than this get a block of their own
+     */
+    Arena* arena_create(u64 blockSize = 1 << 20);
+
+    /**
+     * @brief Frees every block of the arena, and with them everything allocated from it
+     */
+    void arena_destroy(Arena* arena);
+
+    /**
+     * @brief Allocates zeroed memory from the arena. Safe to call from several threads at once.
+     *
+     * @param alignment Must be a power of two
+     */
+    void* arena_alloc(Arena* arena, u64 size, u64 alignment = 16);
+
+    /**
+     * @brief Copies a null terminated string into the arena
+     */
+    const char* arena_copy_string(Arena* arena, const char* string);
+
+    /**
+     * @brief Gets the number of bytes handed out by the arena so far, not counting alignment padding
+     */
+    u64 arena_used(const Arena* arena);
+
+    template<typename T>
+    T* arena_alloc_array(Arena* arena, u64 count) {
+        return (T*)arena_alloc(arena, count * sizeof(T), alignof(T));
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SPME_X86 1
+#endif
+
+// Allows a single function to be compiled for an instruction set that the rest of the build doesn't assume.
+// Callers are expected to check the matching cpu_has_* function first.
+#if defined(__GNUC__) || defined(__clang__)
+#define SPME_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define SPME_TARGET(instructionSet)
+#endif
+
+namespace SPMEditor {
+    // These report false on non x86 machines or when the SPME_NO_SIMD environment variable is set
+    bool cpu_has_sse41();
+    bool cpu_has_avx2();
+}
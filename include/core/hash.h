@@ -0,0 +1,18 @@
+#pragma once
+
+namespace SPMEditor {
+    /**
+     * @brief Hashes a block of memory into a 64 bit value. Not cryptographic, only meant for content keys (caches, dedup).
+     *
+     * @param data The data to hash
+     * @param size The number of bytes to hash
+     * @param seed Optional seed, used to derive independent hashes of the same data
+     * @return The 64 bit hash
+     */
+    u64 hash_bytes(const void* data, u64 size, u64 seed = 0);
+
+    /**
+     * @brief Mixes a value into an existing hash. Used to build keys out of several fields.
+     */
+    u64 hash_combine(u64 hash, u64 value);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <functional>
+
+namespace SPMEditor {
+    /**
+     * @brief Runs job(i) for every i in [0, count) on the worker threads and the calling thread, returning once every job is done.
+     * Jobs may run in any order so they must only write to their own output. Calls made from inside a job run serially on that thread.
+     *
+     * @param count The number of jobs
+     * @param job The function to run for each job index
+     */
+    void parallel_for(u32 count, const std::function<void(u32 index)>& job);
+
+    /**
+     * @brief Gets the number of threads parallel_for runs jobs on, including the calling thread.
+     * Defaults to the number of hardware threads, and can be overridden with the SPME_THREADS environment variable (1 disables threading).
+     */
+    u32 parallel_thread_count();
+}
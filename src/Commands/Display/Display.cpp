@@ -3,18 +3,14 @@
 #include "Commands/Display/PreviewObject.h"
 #include "Commands/Display/PreviewTexture.h"
 #include "Commands/Display/ShaderProgram.h"
+#include "FileTypes/LevelGeometry/AnimationEvaluator.h"
 #include "GLFW/glfw3.h"
 #include "Types/Types.h"
-#include "assimp/Importer.hpp"
-#include "assimp/quaternion.h"
 #include "glad/glad.h"
-#include "glm/detail/type_quat.hpp"
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/ext/matrix_transform.hpp"
-#include "glm/ext/scalar_constants.hpp"
 #include "glm/geometric.hpp"
-#include "glm/gtc/quaternion.hpp"
-#include "stb_image.h"
+#include <cstring>
 
 namespace SPMEditor {
     GLFWwindow* s_Window;
@@ -29,13 +25,29 @@ namespace SPMEditor {
     glm::vec3 s_InputDirection;
     float s_CameraSpeed = 10;
 
+    static glm::vec3 ToGlm(const Vector3& vector) {
+        return glm::vec3(vector.x, vector.y, vector.z);
+    }
+
     void Display::DisplayLevel(LevelData& level) {
         if (!s_Initialized)
             InitOpenGL();
 
         // Load scene
         LogTrace("Reading root object");
-        PreviewObject rootObject = PreviewObject(level.geometry, level.geometry->mRootNode);
+        std::vector<PreviewMesh*> previewMeshes(level.geometry->mMeshCount, nullptr);
+        std::vector<PreviewObject*> nodeObjects(level.geometry->mNodeCount, nullptr);
+        PreviewObject rootObject = PreviewObject(level.geometry, 0, previewMeshes, nodeObjects);
+
+        // Resolve the object and rest pose of every animation channel once, rather than every frame
+        AnimationEvaluator animations(level.geometry);
+        std::vector<AnimationPose> poses(animations.GetChannelCount());
+        std::vector<AnimationPose> restPoses(animations.GetChannelCount());
+        std::vector<PreviewObject*> channelObjects(animations.GetChannelCount());
+        for (u32 c = 0; c < animations.GetChannelCount(); c++) {
+            restPoses[c] = animations.GetRestPose(c);
+            channelObjects[c] = nodeObjects[animations.GetChannelNode(c)];
+        }
 
         // Setup shader
         LogTrace("Creating Shaders");
@@ -51,24 +63,18 @@ namespace SPMEditor {
 
         // Load textures
         LogTrace("Loading Textures");
-        PreviewTexture* textures = new PreviewTexture[level.geometry->mNumTextures];
-        stbi_set_flip_vertically_on_load(true);  
+        PreviewTexture* textures = new PreviewTexture[level.geometry->mTextureCount];
 
-        for (u32 i = 0; i < level.geometry->mNumTextures; i++) {
+        for (u32 i = 0; i < level.geometry->mTextureCount; i++) {
             textures[i] = PreviewTexture();
 
-            const aiTexture* tex = level.geometry->mTextures[i];
-            int size, width, height, channels = 0;
-            if (tex->mHeight == 0)
-            {
-                size = tex->mWidth;
-                u8* data = stbi_load_from_memory((u8*)tex->pcData, size, &width, &height, &channels, 4);
-                textures[i].Create(data, width, height, PreviewTexture::PixelFormat::RGBA8, PreviewTexture::WrapType::Repeat, PreviewTexture::FilterType::Nearest);
-                stbi_image_free(data);
-            }
-            else {
-                textures[i].Create(tex->pcData, tex->mWidth, tex->mHeight, PreviewTexture::PixelFormat::RGB8, PreviewTexture::WrapType::Repeat, PreviewTexture::FilterType::Nearest); 
+            // Scene textures start with the top row, OpenGL with the bottom one
+            const SceneTexture& texture = level.geometry->mTextures[i];
+            std::vector<Color> pixels(texture.mWidth * texture.mHeight);
+            for (u32 y = 0; y < texture.mHeight; y++) {
+                memcpy(&pixels[y * texture.mWidth], texture.mPixels + (texture.mHeight - 1 - y) * texture.mWidth, texture.mWidth * sizeof(Color));
             }
+            textures[i].Create(pixels.data(), texture.mWidth, texture.mHeight, PreviewTexture::PixelFormat::RGBA8, PreviewTexture::WrapType::Repeat, PreviewTexture::FilterType::Nearest);
         }
 
         // Final gl init
@@ -92,68 +98,16 @@ namespace SPMEditor {
             glm::mat4 project = glm::perspective(90.0f, (float)s_ScreenWidth / s_ScreenHeight, .1f, 1000.0f);
 
             // Animation
-            for (u32 i = 0; i < level.geometry->mNumAnimations; i++) {
-                const auto animation = level.geometry->mAnimations[i];
-                for (u32 c = 0; c < animation->mNumChannels; c++) {
-                    const auto channel = animation->mChannels[c];
-                    float targetTime = glm::mod(glfwGetTime() * 60, animation->mDuration);
-
-                    glm::vec3 pos, rot, scale;
-                    for (u32 k = 0; k < channel->mNumPositionKeys; k++)
-                        if (targetTime > channel->mPositionKeys[k].mTime)
-                        {
-                            const auto& key = channel->mPositionKeys[k];
-                            const auto& nextKey = channel->mPositionKeys[k + 1];
-                            auto position = (key.mValue + (nextKey.mValue - key.mValue) * (float)(targetTime - key.mTime) / (float)(nextKey.mTime - key.mTime));
-                            pos.x = position.x;
-                            pos.y = position.y;
-                            pos.z = position.z;
-                        }
-
-                    for (u32 k = 0; k < channel->mNumRotationKeys; k++)
-                    {
-                        const auto& key = channel->mRotationKeys[k];
-                        const auto& nextKey = channel->mRotationKeys[k + 1];
-                        if (targetTime > key.mTime)
-                        {
-                            aiQuaternion quat;
-                            key.mValue.Interpolate(quat, key.mValue, nextKey.mValue, (float)(targetTime - key.mTime) / (float)(nextKey.mTime - key.mTime));
-                            glm::quat _quat;
-                            _quat.x = quat.x;
-                            _quat.y = quat.y;
-                            _quat.z = quat.z;
-                            _quat.w = quat.w;
-
-                            glm::quat euler = glm::eulerAngles(_quat);
-                            rot.x = euler.z;
-                            rot.y = euler.y;
-                            rot.z = euler.x;
-                        }
-                    }
-                    for (u32 k = 0; k < channel->mNumScalingKeys; k++)
-                        if (targetTime > channel->mScalingKeys[k].mTime)
-                        {
-                            const auto& key = channel->mScalingKeys[k];
-                            const auto& nextKey = channel->mScalingKeys[k + 1];
-                            auto scaling = (key.mValue + (nextKey.mValue - key.mValue) * (float)(targetTime - key.mTime) / (float)(nextKey.mTime - key.mTime));
-                            scale.x = scaling.x;
-                            scale.y = scaling.y;
-                            scale.z = scaling.z;
-                        }
-
-                    pos.x -= channel->mPositionKeys[0].mValue.x;
-                    pos.y -= channel->mPositionKeys[0].mValue.y;
-                    pos.z -= channel->mPositionKeys[0].mValue.z;
-                    rot /= 180 * glm::pi<float>();
-
-                    const char* nodeName = channel->mNodeName.C_Str();
-                    PreviewObject *node = rootObject.FindNode(nodeName);
-                    if (node != nullptr)
-                    {
-                        Assert(node != nullptr, "Failed to find node '%s', (%p)", nodeName, node);
-                        node->SetAnimationState(pos, rot, scale);
-                    }
-                }
+            animations.Evaluate(glfwGetTime() * 60, poses.data());
+            for (u32 c = 0; c < animations.GetChannelCount(); c++) {
+                if (channelObjects[c] == nullptr)
+                    continue;
+
+                // The preview adds the animation on top of the object's own transform
+                const AnimationPose& pose = poses[c];
+                glm::vec3 pos = ToGlm(pose.mPosition) - ToGlm(restPoses[c].mPosition);
+                glm::vec3 rot = ToGlm(pose.mRotation) - ToGlm(restPoses[c].mRotation);
+                channelObjects[c]->SetAnimationState(pos, rot, ToGlm(pose.mScale));
             }
 
             // Shader setup
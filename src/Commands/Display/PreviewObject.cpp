@@ -2,57 +2,54 @@
 
 #include "Commands/Display/PreviewObject.h"
 #include "Commands/Display/ShaderProgram.h"
-#include "assimp/material.h"
-#include "assimp/vector3.h"
 #include "glm/ext/matrix_float4x4.hpp"
 #include "glm/ext/matrix_transform.hpp"
 
 namespace SPMEditor {
 
-    PreviewObject::PreviewObject(const aiScene* scene, aiNode* node) : mAnimPosition(0), mAnimRotation(0), mAnimScale(1) {
-        name = node->mName.C_Str();
+    PreviewObject::PreviewObject(const Scene* scene, s32 nodeIndex, std::vector<PreviewMesh*>& meshCache, std::vector<PreviewObject*>& nodeObjects) : mAnimPosition(0), mAnimRotation(0), mAnimScale(1) {
+        const SceneNode& node = scene->mNodes[nodeIndex];
+        name = node.mName;
 
         // Skip rendering colliders
-        if (node->mName.length == 1 && node->mName.C_Str()[0] == 'A')
+        if (strcmp(node.mName, "A") == 0)
             return;
 
+        nodeObjects[nodeIndex] = this;
+
         // Get transform data (incompatable by default w/ glm)
-        aiVector3D _scale, _rotation, _position;
-        node->mTransformation.Decompose(_scale, _rotation, _position);
-        m_Scale.x = _scale.x;
-        m_Scale.y = _scale.y;
-        m_Scale.z = _scale.z;
-
-        m_Rotation.x = _rotation.x;
-        m_Rotation.y = _rotation.y;
-        m_Rotation.z = _rotation.z;
-
-        m_Position.x = _position.x;
-        m_Position.y = _position.y;
-        m_Position.z = _position.z;
-
-        m_Meshes.reserve(node->mNumMeshes);
-        m_Children.reserve(node->mNumChildren);
-
-        // Load all meshes
-        for (u32 i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            PreviewMesh* previewMesh = new PreviewMesh(mesh);
-
-            aiString path;
-            aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-            if (mat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), path) == AI_SUCCESS)
-            {
-                std::pair<const aiTexture*, int> textureIndexPair = scene->GetEmbeddedTextureAndIndex(path.C_Str());
-                previewMesh->mTextureIndex = textureIndexPair.second;
+        m_Scale = glm::vec3(node.mScale.x, node.mScale.y, node.mScale.z);
+        m_Rotation = glm::vec3(node.mRotation.x, node.mRotation.y, node.mRotation.z);
+        m_Position = glm::vec3(node.mPosition.x, node.mPosition.y, node.mPosition.z);
+
+        m_Meshes.reserve(node.mMeshCount);
+
+        // Load all meshes, a mesh used by several objects is only uploaded once
+        for (u32 i = 0; i < node.mMeshCount; i++) {
+            u32 meshIndex = scene->mNodeMeshes[node.mFirstMesh + i];
+            PreviewMesh*& cachedMesh = meshCache[meshIndex];
+            if (cachedMesh) {
+                m_Meshes.emplace_back(cachedMesh);
+                continue;
             }
 
+            const SceneMesh& mesh = scene->mMeshes[meshIndex];
+            PreviewMesh* previewMesh = new PreviewMesh(&mesh);
+            cachedMesh = previewMesh;
+            previewMesh->mTextureIndex = scene->mMaterials[mesh.mMaterialIndex].mTextureIndex;
+
             m_Meshes.emplace_back(previewMesh);
         }
 
-        // Then load children recursively
-        for (u32 i = 0; i < node->mNumChildren; i++) {
-            m_Children.emplace_back(PreviewObject(scene, node->mChildren[i]));
+        // Then load children recursively, constructed in place so the pointers in nodeObjects stay valid
+        u32 childCount = 0;
+        for (s32 child = node.mFirstChild; child != -1; child = scene->mNodes[child].mNextSibling) {
+            childCount++;
+        }
+
+        m_Children.reserve(childCount);
+        for (s32 child = node.mFirstChild; child != -1; child = scene->mNodes[child].mNextSibling) {
+            m_Children.emplace_back(scene, child, meshCache, nodeObjects);
         }
     }
 
@@ -84,20 +81,6 @@ namespace SPMEditor {
         }
     }
 
-    PreviewObject* PreviewObject::FindNode(const char* name) {
-        if (this->name)
-            if (strcmp(this->name, name) == 0)
-                return this;
-
-        for (size_t i = 0; i < this->m_Children.size(); i++) {
-            PreviewObject* node = m_Children[i].FindNode(name);
-            if (node)
-                return node;
-        }
-
-        return nullptr;
-    }
-
     PreviewObject::~PreviewObject() {
     }
 }
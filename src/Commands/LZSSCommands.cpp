@@ -2,6 +2,7 @@
 #include "core/Logging.h"
 #include "core/filesystem.h"
 #include "Compressors/LZSS.h"
+#include "Compressors/CompressionCache.h"
 
 namespace SPMEditor::LZSSCommands {
 
@@ -12,8 +13,8 @@ namespace SPMEditor::LZSSCommands {
         Assert(filesystem_exists(input), "File '%s' Does not exist.", input);
 
         FileHandle file_handle = filesystem_read_file(input);
-        std::vector<u8> compressed_data = LZSS::CompressLzss10((u8*)file_handle.data, file_handle.size);
-        filesystem_write_file(output, compressed_data.data(), file_handle.size);
+        std::vector<u8> compressed_data = CompressionCache::CompressLzss10((u8*)file_handle.data, file_handle.size);
+        filesystem_write_file(output, compressed_data.data(), compressed_data.size());
     }
 
     void Decompress(u32 argc, const char** argv) {
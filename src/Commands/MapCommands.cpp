@@ -2,6 +2,7 @@
 #include <filesystem>
 #include "FileTypes/LevelData.h"
 #include "FileTypes/LevelGeometry/GeometryExporter.h"
+#include "FileTypes/LevelGeometry/LevelGeometry.h"
 #include <assimp/Exporter.hpp>
 #include "assimp/Importer.hpp"
 #include "assimp/postprocess.h"
@@ -22,8 +23,11 @@ namespace SPMEditor::MapCommands {
 
         LogInfo("------- Exporting Model -------");
         Assimp::Exporter exporter;
-        const aiReturn exportSuccess = exporter.Export(level.geometry, "fbx", outputFile, aiProcess_EmbedTextures | aiProcess_Triangulate | aiProcess_GenBoundingBoxes | aiProcess_FlipWindingOrder);
+        aiScene* scene = level.geometry->ToAssimp(); // The assimp copy of the map is only made for exporting
+        LevelGeometry::EncodeTexturesAsPNG(scene); // Fbx can only embed compressed textures
+        const aiReturn exportSuccess = exporter.Export(scene, "fbx", outputFile, aiProcess_EmbedTextures | aiProcess_Triangulate | aiProcess_GenBoundingBoxes | aiProcess_FlipWindingOrder);
         Assert(exportSuccess == aiReturn_SUCCESS, "Failed to export %s", level.name.c_str());
+        delete scene;
     }
 
     void FromGLB(u32 argc, const char** argv) {
@@ -1,33 +1,99 @@
 #include "Commands/TPLCommands.h"
 #include "FileTypes/TPL.h"
+#include "core/jobs.h"
+#include "fpng.h"
 #include "stb_image_write.h"
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace SPMEditor::TPLCommands {
     void Dump(u32 argc, const char** argv) {
         const char* input_file = argv[0];
         const char* output_directory = argv[1];
 
+        // fpng is many times faster, stb compresses better and is readable by every png decoder
+        bool useStb = false;
+        if (argc > 2) {
+            useStb = strcmp(argv[2], "stb") == 0;
+            if (!useStb && strcmp(argv[2], "fpng") != 0)
+                LogWarn("Unknown png encoder '%s', using fpng. Valid encoders are 'fpng' and 'stb'", argv[2]);
+        }
+
         if (!std::filesystem::exists(output_directory))
             std::filesystem::create_directory(output_directory);
 
         LogInfo("Dumping tpl '%s' to '%s'", input_file, output_directory);
         SPMEditor::TPL tpl = SPMEditor::TPL::LoadFromFile(input_file);
 
-        for (size_t i = 0; i < tpl.images.size(); i++) {
-            auto& image = tpl.images[i];
+        if (!useStb)
+            fpng::fpng_init();
+
+        // Names are picked up front so images sharing a name get the image index added instead of writing the same file at once
+        std::vector<std::string> names(tpl.images.size());
+        std::unordered_set<std::string> usedNames;
+        for (u32 i = 0; i < tpl.images.size(); i++) {
             char finalName[0x200] = {};
-            if (image.name == "") {
-                snprintf(finalName, sizeof(finalName), "Image_%lu", i);
+            if (tpl.images[i].name == "") {
+                snprintf(finalName, sizeof(finalName), "Image_%u", i);
             } else {
-                strcpy(finalName, image.name.c_str());
+                snprintf(finalName, sizeof(finalName), "%s", tpl.images[i].name.c_str());
+            }
+
+            std::string name = finalName;
+            for (u32 suffix = i; !usedNames.insert(name).second; suffix++) {
+                name = std::string(finalName) + "_" + std::to_string(suffix);
             }
-            LogInfo("Writing image '%s/%s.png'", output_directory, finalName);
+            names[i] = name;
+        }
+
+        // Every image is encoded and written to its own file so they can all be done at once
+        parallel_for(tpl.images.size(), [&](u32 i) {
+            auto& image = tpl.images[i];
+            LogInfo("Writing image '%s/%s.png'", output_directory, names[i].c_str());
 
             char path[0x300] = {};
-            snprintf(path, sizeof(path), "%s/%s.png", output_directory, finalName);
-            stbi_write_png(path, (int)image.header.width, (int)image.header.height, 4, image.pixels.data(), image.header.width * 4);
+            snprintf(path, sizeof(path), "%s/%s.png", output_directory, names[i].c_str());
+
+            bool written;
+            if (useStb)
+                written = stbi_write_png(path, (int)image.header.width, (int)image.header.height, 4, image.pixels.data(), image.header.width * 4) != 0;
+            else
+                written = fpng::fpng_encode_image_to_file(path, image.pixels.data(), image.header.width, image.header.height, 4);
+
+            if (!written)
+                LogError("Failed to write image '%s'", path);
+        });
+    }
+
+    void List(u32 argc, const char** argv) {
+        const char* input_file = argv[0];
+
+        // Only the headers are needed, so none of the images get decoded
+        TPLView tpl = TPLView::LoadFromFile(input_file);
+        LogInfo("'%s' has %u images", input_file, tpl.GetImageCount());
+
+        u64 totalSize = 0;
+        for (u32 i = 0; i < tpl.GetImageCount(); i++) {
+            const TPL::ImageHeader& header = tpl.GetImageHeader(i);
+
+            // Mip levels are stored after the base level, each a quarter of the size of the one before
+            u32 levelCount = tpl.GetMipLevelCount(i);
+            u32 size = 0;
+            for (u32 level = 0, width = header.width, height = header.height; level < levelCount; level++) {
+                size += TPL::GetImageDataSize(header.format, width, height);
+                width = std::max(1u, width / 2);
+                height = std::max(1u, height / 2);
+            }
+            totalSize += size;
+
+            LogInfo("Image_%u: %ux%u %s, %u mip levels, %u bytes", i, header.width, header.height, TPL::GetFormatName(header.format), levelCount, size);
         }
+
+        LogInfo("Total image data: %llu bytes", totalSize);
     }
 }
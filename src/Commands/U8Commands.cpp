@@ -1,6 +1,6 @@
 #include "Commands/U8Commands.h"
 #include "FileTypes/U8Archive.h"
-#include "Compressors/LZSS.h"
+#include "Compressors/CompressionCache.h"
 #include "core/filesystem.h"
 #include <cstring>
 #include <filesystem>
@@ -27,7 +27,7 @@ namespace SPMEditor::U8Commands {
         // Decompress the archive if needed
         if (strcmp(compressed, "1") == 0 || strcmp(compressed, "true") == 0) {
             // NOTE: this copies the archive_size to lzss_decompress_10 then overwrites it for the decompressed size
-            data = LZSS::CompressLzss10(data.data(), data.size());
+            data = CompressionCache::CompressLzss10(data.data(), data.size());
         }
 
         filesystem_write_file(output, data.data(), data.size());
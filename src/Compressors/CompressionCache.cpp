@@ -0,0 +1,175 @@
+#include "Compressors/CompressionCache.h"
+#include "Compressors/LZSS.h"
+#include "core/hash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace SPMEditor {
+    std::vector<u8> CompressionCache::CompressLzss10(const u8* data, u64 size) {
+        std::vector<u8> compressed;
+        if (TryGet(data, size, LZSS::Lzss10Level, compressed)) {
+            LogInfo("Using cached lzss data for 0x%x bytes of input", size);
+            return compressed;
+        }
+
+        compressed = LZSS::CompressLzss10((u8*)data, size);
+        Store(data, size, LZSS::Lzss10Level, compressed);
+        return compressed;
+    }
+
+    bool CompressionCache::TryGet(const u8* data, u64 size, u32 level, std::vector<u8>& outCompressed) {
+        if (!IsEnabled())
+            return false;
+
+        u64 hash = hash_bytes(data, size);
+        std::string path = GetEntryPath(hash, size, level);
+        if (!std::filesystem::exists(path))
+            return false;
+
+        std::ifstream file(path, std::ios::binary);
+        EntryHeader header = {};
+        file.read((char*)&header, sizeof(EntryHeader));
+
+        // Anything that doesn't match exactly is treated as a miss and will be overwritten
+        if (!file || header.magic != EntryHeader::Magic || header.level != level || header.uncompressedSize != size || header.hash != hash) {
+            LogWarn("Ignoring invalid compression cache entry '%s'", path.c_str());
+            return false;
+        }
+
+        outCompressed.resize(header.compressedSize);
+        file.read((char*)outCompressed.data(), header.compressedSize);
+        if ((u64)file.gcount() != header.compressedSize) {
+            LogWarn("Ignoring truncated compression cache entry '%s'", path.c_str());
+            outCompressed.clear();
+            return false;
+        }
+
+        // Mark the entry as recently used so Trim keeps it
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        return true;
+    }
+
+    void CompressionCache::Store(const u8* data, u64 size, u32 level, const std::vector<u8>& compressed) {
+        if (!IsEnabled())
+            return;
+
+        u64 hash = hash_bytes(data, size);
+        std::string path = GetEntryPath(hash, size, level);
+
+        std::error_code error;
+        std::filesystem::create_directories(GetCacheDirectory(), error);
+        if (error) {
+            LogWarn("Failed to create compression cache directory '%s': %s", GetCacheDirectory().c_str(), error.message().c_str());
+            return;
+        }
+
+        EntryHeader header = {
+            .magic = EntryHeader::Magic,
+            .level = level,
+            .uncompressedSize = size,
+            .hash = hash,
+            .compressedSize = compressed.size(),
+        };
+
+        // Write to a temporary file first so a concurrent build never reads a half written entry.
+        // The name is unique to this process and call, so writers of the same entry can't clobber each other's temporary file
+        static std::atomic<u64> s_TempCounter = 0;
+        std::string tempPath = path + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(s_TempCounter++);
+        {
+            std::ofstream file(tempPath, std::ios::binary);
+            file.write((const char*)&header, sizeof(EntryHeader));
+            file.write((const char*)compressed.data(), compressed.size());
+            if (!file) {
+                LogWarn("Failed to write compression cache entry '%s'", tempPath.c_str());
+                std::filesystem::remove(tempPath, error);
+                return;
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, error);
+        if (error) {
+            LogWarn("Failed to move compression cache entry to '%s': %s", path.c_str(), error.message().c_str());
+            std::filesystem::remove(tempPath, error);
+            return;
+        }
+
+        Trim();
+    }
+
+    void CompressionCache::Trim() {
+        u64 maxSize = DefaultMaxSize;
+        if (const char* maxSizeMB = getenv("SPME_CACHE_MAX_MB"))
+            maxSize = strtoull(maxSizeMB, nullptr, 10) * 1024 * 1024;
+
+        struct Entry {
+            std::filesystem::path path;
+            std::filesystem::file_time_type lastUse;
+            u64 size;
+        };
+
+        std::error_code error;
+        std::vector<Entry> entries;
+        u64 totalSize = 0;
+        for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(GetCacheDirectory(), error)) {
+            if (!file.is_regular_file(error) || file.path().extension() != ".lzss")
+                continue;
+
+            Entry entry = { file.path(), file.last_write_time(error), file.file_size(error) };
+            if (error)
+                continue;
+
+            totalSize += entry.size;
+            entries.push_back(entry);
+        }
+
+        if (totalSize <= maxSize)
+            return;
+
+        // Remove the least recently used entries until the cache fits
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+        for (const Entry& entry : entries) {
+            if (totalSize <= maxSize)
+                break;
+
+            if (std::filesystem::remove(entry.path, error)) {
+                totalSize -= entry.size;
+                LogInfo("Removed compression cache entry '%s' to stay under %llu bytes", entry.path.string().c_str(), (unsigned long long)maxSize);
+            }
+        }
+    }
+
+    bool CompressionCache::IsEnabled() {
+        return getenv("SPME_NO_CACHE") == nullptr;
+    }
+
+    std::string CompressionCache::GetCacheDirectory() {
+        if (const char* dir = getenv("SPME_CACHE_DIR"))
+            return dir;
+        if (const char* xdg = getenv("XDG_CACHE_HOME"))
+            return std::string(xdg) + "/spme";
+        if (const char* home = getenv("HOME"))
+            return std::string(home) + "/.cache/spme";
+        if (const char* localAppData = getenv("LOCALAPPDATA"))
+            return std::string(localAppData) + "/spme";
+
+        return ".spme_cache";
+    }
+
+    std::string CompressionCache::GetEntryPath(u64 hash, u64 size, u32 level) {
+        char name[0x80] = {};
+        snprintf(name, sizeof(name), "/%016llx_%llx_%u.lzss", (unsigned long long)hash, (unsigned long long)size, level);
+        return GetCacheDirectory() + name;
+    }
+}
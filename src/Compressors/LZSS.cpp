@@ -181,13 +181,13 @@ namespace SPMEditor {
         return length > 2;
     }
 
-    std::vector<u8> output;
     std::vector<u8> LZSS::CompressLzss10(const std::vector<u8>& data) {
         return CompressLzss10((u8*)data.data(), data.size());
     }
 
     std::vector<u8> LZSS::CompressLzss10(u8* data, u64 size) {
         LogInfo("Compressing 0x%x bytes of lzss11 data", size);
+        std::vector<u8> output;
         output.reserve(size + 4);
 
         output.push_back(0x10);
@@ -0,0 +1,87 @@
+#include "FileTypes/LevelGeometry/AnimationEvaluator.h"
+#include <cmath>
+
+namespace SPMEditor {
+    static Vector3 Lerp(const Vector3& a, const Vector3& b, float t) {
+        return Vector3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+    }
+
+    AnimationEvaluator::AnimationEvaluator(const Scene* scene) {
+        u32 channelCount = 0;
+        u32 keyCount = 0;
+        for (u32 a = 0; a < scene->mAnimationCount; a++) {
+            const SceneAnimation& animation = scene->mAnimations[a];
+            channelCount += animation.mChannelCount;
+            for (u32 c = 0; c < animation.mChannelCount; c++) {
+                keyCount += animation.mChannels[c].mKeyframeCount;
+            }
+        }
+
+        mChannels.reserve(channelCount);
+        mTimes.reserve(keyCount);
+        mPositions.reserve(keyCount);
+        mRotations.reserve(keyCount);
+        mScales.reserve(keyCount);
+
+        for (u32 a = 0; a < scene->mAnimationCount; a++) {
+            const SceneAnimation& animation = scene->mAnimations[a];
+            for (u32 c = 0; c < animation.mChannelCount; c++) {
+                const SceneAnimationChannel& channel = animation.mChannels[c];
+                Assert(channel.mKeyframeCount > 0, "Animation '%s' has a channel without keyframes", animation.mName);
+
+                mChannels.push_back({ channel.mNode, (u32)mTimes.size(), channel.mKeyframeCount, 0, animation.mDuration });
+                for (u32 k = 0; k < channel.mKeyframeCount; k++) {
+                    const SceneKeyframe& key = channel.mKeyframes[k];
+                    mTimes.push_back(key.mTime);
+                    mPositions.push_back(key.mPosition);
+                    mRotations.push_back(key.mRotation);
+                    mScales.push_back(key.mScale);
+                }
+            }
+        }
+    }
+
+    AnimationPose AnimationEvaluator::GetRestPose(u32 channel) const {
+        u32 key = mChannels[channel].mFirstKey;
+        return { mPositions[key], mRotations[key], mScales[key] };
+    }
+
+    AnimationPose AnimationEvaluator::Sample(u32 index, double time) {
+        // Wrap before going to float, after a few hours of frames a float can't hold the fraction anymore
+        Channel& channel = mChannels[index];
+        if (channel.mDuration > 0) {
+            time = std::fmod(time, (double)channel.mDuration);
+            if (time < 0)
+                time += channel.mDuration;
+        }
+        const float frame = (float)time;
+
+        // Playback moves forward, so the cursor usually stays put or steps ahead by a key.
+        // Only going back in time, which happens once per loop, starts the search over from the first key
+        const float* times = mTimes.data() + channel.mFirstKey;
+        u32 cursor = channel.mCursor;
+        if (frame < times[cursor])
+            cursor = 0;
+        while (cursor + 1 < channel.mKeyCount && times[cursor + 1] <= frame)
+            cursor++;
+        channel.mCursor = cursor;
+
+        u32 key = channel.mFirstKey + cursor;
+        if (cursor + 1 == channel.mKeyCount || frame <= times[cursor])
+            return { mPositions[key], mRotations[key], mScales[key] };
+
+        // The next key is after the frame and this one at or before it, so the keys can't share a time
+        float t = (frame - times[cursor]) / (times[cursor + 1] - times[cursor]);
+        return {
+            Lerp(mPositions[key], mPositions[key + 1], t),
+            Lerp(mRotations[key], mRotations[key + 1], t),
+            Lerp(mScales[key], mScales[key + 1], t),
+        };
+    }
+
+    void AnimationEvaluator::Evaluate(double time, AnimationPose* poses) {
+        for (u32 i = 0; i < mChannels.size(); i++) {
+            poses[i] = Sample(i, time);
+        }
+    }
+}
@@ -1,18 +1,26 @@
 #include "FileTypes/LevelGeometry/GeometryExporter.h"
 #include "FileTypes/LevelGeometry/MapStructures.h"
+#include "FileTypes/LevelGeometry/TriangleStripper.h"
+#include "FileTypes/LevelGeometry/VertexCache.h"
 #include "FileTypes/MapConfig.h"
 #include "FileTypes/TPL.h"
+#include "FileTypes/TPLEncoder.h"
 #include "Types/Types.h"
 #include "core/Logging.h"
+#include "core/hash.h"
+#include "core/jobs.h"
 #include "assimp/material.h"
 #include "assimp/types.h"
 #include "assimp/vector3.h"
 #include <algorithm>
+#include <bit>
+#include <cmath>
 #include <fstream>
 #include <ios>
 #include <numbers>
 #include <string>
-#include "stb_image.h"
+#include <tuple>
+#include <unordered_map>
 
 using namespace SPMEditor::MapStructures;
 namespace SPMEditor {
@@ -26,6 +34,9 @@ namespace SPMEditor {
     GeometryExporter::~GeometryExporter() {
         delete mData;
         delete mTextBuffer;
+        for (aiTexture* texture : mOwnedTextures) {
+            delete texture;
+        }
     };
 
     GeometryExporter::Section::Section(const char* name, int offset) : name(name), offset(offset) { }
@@ -50,6 +61,8 @@ namespace SPMEditor {
         }
 
 
+        BuildTextureList();
+
         // Write the scene images as a TPL
         LogWarn("Writing tpl to '%s'", outputTplPath);
         WriteTPL(outputTplPath);
@@ -150,31 +163,22 @@ namespace SPMEditor {
     }
 
     void GeometryExporter::WriteMapTextures() {
-        LogInfo("Writing %d textures", mScene->mNumTextures);
-        for (size_t i = 0; i < mScene->mNumTextures; i++) {
+        LogInfo("Writing %zu textures", mTextures.size());
+        for (size_t i = 0; i < mTextures.size(); i++) {
             // Create map texture
-            const aiTexture* texture = mScene->mTextures[i];
+            const aiTexture* texture = mTextures[i];
             MapTexture mapTexture;
             mapTexture.nameOffset = AppendStringPointer(texture->mFilename.C_Str());
 
             mapTexture.transparency = MapTexture::TransparencyType::Opaque;
-            if (texture->mHeight != 0) {
-                mapTexture.width = texture->mWidth;
-                mapTexture.height = texture->mHeight;
-            } else {
-                // Run stbi_load_from_memory to get real image dimensions
-                int channels = 0;
-                Color* colors = (Color*)stbi_load_from_memory((u8*)texture->pcData, texture->mWidth, (int*)&mapTexture.width, (int*)&mapTexture.height, &channels, 0);
-                stbi_image_free(colors);
-
-            }
+            mapTexture.width = texture->mWidth; // Textures are decoded by BuildTextureList
+            mapTexture.height = texture->mHeight;
             // TODO: Research other transparency modes
-            TextureConfig config = GetTextureConfig(i);
+            const TextureConfig& config = mTextureConfigs[i];
             mapTexture.transparency = (config.mUseTransparency ? MapTexture::TransparencyType::Clip : MapTexture::TransparencyType::Opaque);
 
             mTextureNameTable.emplace_back(mapTexture.nameOffset);
-            mTextureNameToIndex.emplace(texture->mFilename.C_Str(), mTextureNameToIndex.size());
-            LogInfo("Adding texture name '%s' at index %u", texture->mFilename.C_Str(), mTextureNameToIndex.size());
+            LogInfo("Adding texture name '%s' at index %zu", texture->mFilename.C_Str(), i);
 
             // Everything else is unkown
             AppendInt8((s8)mapTexture.transparency);
@@ -188,8 +192,8 @@ namespace SPMEditor {
         }
 
         // Write information
-        for (size_t i = 0; i < mScene->mNumTextures; i++) {
-            TextureConfig config = GetTextureConfig(i);
+        for (size_t i = 0; i < mTextures.size(); i++) {
+            const TextureConfig& config = mTextureConfigs[i];
             AppendPointer(0x14 + i * sizeof(MapTexture));
             AppendInt32(0); // padding
             AppendInt8((u8)config.mWrapModeU);
@@ -230,6 +234,21 @@ namespace SPMEditor {
         GetMeshDataRecursive(mScene->mRootNode);
         AddPadding(0x20);
 
+        // Atlased uvs address texels of a much larger page, so use as much precision as the uv range allows
+        bool hasAtlas = std::any_of(mAtlasRects.begin(), mAtlasRects.end(), [](const TextureAtlasRect& rect) { return rect.mPage >= 0; });
+        if (hasAtlas) {
+            float maxUV = 1.0f;
+            for (const auto& pair : mUvTable) {
+                maxUV = std::max({ maxUV, std::abs(pair.first.x), std::abs(1.0f - pair.first.y) });
+            }
+
+            while (uvScale < 14 && maxUV * (1 << (uvScale + 1)) <= 0x7fff) {
+                uvScale++;
+            }
+            mVCDTable.uvScale = uvScale;
+            LogInfo("Using uv scale %u for texture atlases", uvScale);
+        }
+
         LogInfo("Writing 0x%x vertices", mVertexTable.size());
         mVCDTable.vertices = AppendInt32(mVertexTable.size()) + 4;
         mFileSize += mVertexTable.size() * 6;
@@ -306,8 +325,8 @@ namespace SPMEditor {
                 }
 
                 if (mesh->HasTextureCoords(0)) {
-                    if (!mUvTable.contains(mesh->mTextureCoords[0][v])) {
-                        aiVector3D uv = mesh->mTextureCoords[0][v];
+                    aiVector3D uv = GetMeshUV(mesh, v);
+                    if (!mUvTable.contains(uv)) {
                         size_t index = mUvTable.size();
                         mUvTable.emplace(uv, index);
                     }
@@ -347,30 +366,17 @@ namespace SPMEditor {
             u8 useVertexColors = config.mUseVertexColor;
             u8 unk_1 = 1;
             u8 useTransparency = config.mUseTransparency;
-            u8 useTexture = material->GetTextureCount(aiTextureType_DIFFUSE) > 0;
+            u8 useTexture = mMaterialTextures[i] >= 0;
             AppendUInt8(useVertexColors);
             AppendUInt8(unk_1);
             AppendUInt8(useTransparency);
             AppendUInt8(useTexture);
 
             if (useTexture) {
-                Assert(mScene->mNumTextures > 0, "Material uses textures but scene does not model does not contain any embedded textures");
-                aiString* path = new aiString();
-                Assert(aiReturn_SUCCESS == material->GetTexture(aiTextureType_DIFFUSE, 0, path), "Failed to get texture for material '%s'", material->GetName().C_Str());
-                u32 textureInfoPtr = 0x14 + mScene->mNumTextures * sizeof(MapTexture);
-                if (mTextureNameToIndex.contains(path->C_Str())) {
-                    textureInfoPtr += mTextureNameToIndex[path->C_Str()] * sizeof(MapTexture::Info);
-                } else if (path->C_Str()[0] == '*') {
-                    // Check if texture name is assimp using an image index
-                    int imageIndex = std::stoi(path->C_Str() + 1);
-                    textureInfoPtr += imageIndex * sizeof(MapTexture::Info);
-
-                }
-                else {
-                    LogWarn("Texture Name To Index table does not have texture '%s'. Using first texture.", path->C_Str());
-                    textureInfoPtr += sizeof(MapTexture) * (i % mScene->mNumTextures);
-                }
-                LogDebug("Material texture path '%s' has index of %d and offset of %p", path->C_Str(), mTextureNameToIndex[path->C_Str()], textureInfoPtr);
+                // Materials of atlased textures point at the atlas page
+                int textureIndex = mTextureRemap[mMaterialTextures[i]];
+                u32 textureInfoPtr = 0x14 + mTextures.size() * sizeof(MapTexture) + textureIndex * sizeof(MapTexture::Info);
+                LogDebug("Material '%s' uses texture %d at offset 0x%x", material->GetName().C_Str(), textureIndex, textureInfoPtr);
                 AppendPointer(textureInfoPtr);
             } else {
                 AppendInt32(0);
@@ -424,19 +430,54 @@ namespace SPMEditor {
         if (!mesh->HasTextureCoords(0)) {
             LogWarn("Mesh %s does not have UVs", mesh->mName.C_Str());
         }
-        // HACK: For the sake of making an easy implementation, each strip is just going to be one triangle
-        // TODO: Add triangle stripping algorithm
+        // Vertices with the same attribute indices are written the same way, so strips are built over those rather than the mesh's vertices
+        std::vector<u32> stripVertices; // A mesh vertex for each strip vertex
+        std::vector<u32> vertexRemap(mesh->mNumVertices);
+        std::unordered_map<u64, u32> attributeLookup;
+        for (u32 v = 0; v < mesh->mNumVertices; v++) {
+            u64 key = (u16)mVertexTable[mesh->mVertices[v]];
+            if (mesh->mNormals) {
+                key |= (u64)(u16)mNormalTable[mesh->mNormals[v]] << 16;
+            }
+            if (mesh->HasVertexColors(0)) {
+                key |= (u64)(u16)mColorTable[mesh->mColors[0][v]] << 32;
+            }
+            if (mesh->HasTextureCoords(0)) {
+                aiVector3D uv = GetMeshUV(mesh, v);
+                Assert(mUvTable.contains(uv), "Mesh cannot use UV since it is not in uv table.");
+                key |= (u64)(u16)mUvTable[uv] << 48;
+            }
+
+            auto [entry, inserted] = attributeLookup.try_emplace(key, stripVertices.size());
+            if (inserted)
+                stripVertices.push_back(v);
+            vertexRemap[v] = entry->second;
+        }
 
+        // NOTE: Faces are reversed for face winding reasons
+        std::vector<u32> triangles;
+        triangles.reserve(mesh->mNumFaces * 3);
         for (size_t f = 0; f < mesh->mNumFaces; f++) {
+            const aiFace& face = mesh->mFaces[f];
+            Assert(face.mNumIndices == 3, "Invalid num indices per face. Got %u, expected 3", face.mNumIndices);
+            triangles.push_back(vertexRemap[face.mIndices[2]]);
+            triangles.push_back(vertexRemap[face.mIndices[1]]);
+            triangles.push_back(vertexRemap[face.mIndices[0]]);
+        }
+
+        // Sort the triangles for the vertex cache first, strips are made in roughly the order of their triangles
+        u32 meshMisses = VertexCache::CountMisses(triangles.data(), triangles.size());
+        triangles = VertexCache::Optimize(triangles, stripVertices.size());
+
+        std::vector<std::vector<u32>> strips = TriangleStripper::Build(triangles, mMapConfig.mStitchStrips);
+        std::vector<u32> stripStream; // Every strip vertex in the order the GX fetches them
+        for (const std::vector<u32>& strip : strips) {
             int headerOffset = mFileSize;
-            const aiFace face = mesh->mFaces[f];
             AppendUInt8(0x98); // some constant
-            AppendInt16(3); // Vertex count, 3 since one triangle at a time
+            AppendInt16((s16)strip.size());
 
-            // NOTE: this loop decrements i for face winding reasons
-            for (uint i = face.mNumIndices - 1; i >= 0 && i != 0xffffffff; i--) {
-                Assert(face.mNumIndices == 3, "Invalid num indices per face. Got %u, expected 3", face.mNumIndices);
-                u32 index = face.mIndices[i];
+            for (u32 stripVertex : strip) {
+                u32 index = stripVertices[stripVertex];
                 const aiVector3D vertex = mesh->mVertices[index];
 
                 // Write the vertex index as a u16
@@ -448,15 +489,13 @@ namespace SPMEditor {
                     AppendInt16(mColorTable[mesh->mColors[0][index]]);
                 }
                 if (mesh->HasTextureCoords(0)) {
-                    aiVector3D uv = mesh->mTextureCoords[0][index];
-                    Assert(mUvTable.contains(uv), "Mesh cannot use UV since it is not in uv table.");
-                    AppendInt16(mUvTable[uv]);
+                    AppendInt16(mUvTable[GetMeshUV(mesh, index)]);
                 }
             }
-
+            stripStream.insert(stripStream.end(), strip.begin(), strip.end());
 
             // Write strip header
-            int size = 3 + vertexSize * 3;
+            int size = 3 + vertexSize * strip.size();
             int padding = 0x20 - (size % 0x20);
             if (padding != 0x20) { // Round to nearest 0x20 bytes
                 size += padding;
@@ -469,6 +508,12 @@ namespace SPMEditor {
             stripHeaders.emplace_back(header);
             AddPadding(0x20);
         }
+        LogInfo("Mesh '%s' has %u triangles in %zu strips of %zu vertices in total", mesh->mName.C_Str(), mesh->mNumFaces, strips.size(), stripStream.size());
+
+        // Average cache misses per triangle, drawing the triangles in the mesh's own order against drawing the strips
+        float triangleCount = std::max(mesh->mNumFaces, 1u);
+        u32 stripMisses = VertexCache::CountMisses(stripStream.data(), stripStream.size());
+        LogInfo("Mesh '%s' vertex cache ACMR: %.3f before, %.3f after", mesh->mName.C_Str(), meshMisses / triangleCount, stripMisses / triangleCount);
 
         // Write mesh header
         int address = AppendInt32(0x1000001);
@@ -664,8 +709,8 @@ namespace SPMEditor {
         // Unsupported because its not in fbx files
         int address = AppendInt32(mTextureNameTable.size());
 
-        for (size_t i = 0; i < mScene->mNumTextures; i++) {
-            AppendStringPointer(mScene->mTextures[i]->mFilename.C_Str());
+        for (size_t i = 0; i < mTextures.size(); i++) {
+            AppendStringPointer(mTextures[i]->mFilename.C_Str());
         }
 
         mSections.emplace_back(Section("texture_table", address));
@@ -678,17 +723,522 @@ namespace SPMEditor {
         mSections.emplace_back(Section("animation_table", address));
     }
 
+    // The bytes a texture takes in the tpl, including its palette and mipmaps. maxMipmapCount limits the levels like TPLImageCreateInfo::mMaxMipmapCount
+    static u64 GetTextureMemorySize(TPLImageFormat format, int width, int height, bool mipmaps, int maxMipmapCount = 0) {
+        u64 size = TPL::GetImageDataSize(format, width, height);
+        if (format == TPLImageFormat::C4)
+            size += 16 * 2;
+        else if (format == TPLImageFormat::C8)
+            size += 256 * 2;
+        else if (mipmaps) {
+            int mipmapCount = TPLEncoder::GetMipmapCount(width, height);
+            if (maxMipmapCount > 0)
+                mipmapCount = std::min(mipmapCount, maxMipmapCount);
+            for (int i = 1; i < mipmapCount; i++) {
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+                size += TPL::GetImageDataSize(format, width, height);
+            }
+        }
+
+        return size;
+    }
+
+    void GeometryExporter::BuildTextureList() {
+        const u32 textureCount = mScene->mNumTextures;
+        mTextureConfigs.clear();
+        mAtlasPageCount = 0;
+        mTextureRemap.assign(textureCount, -1);
+        for (u32 i = 0; i < textureCount; i++) {
+            mTextureNameToIndex.emplace(mScene->mTextures[i]->mFilename.C_Str(), i);
+        }
+
+        mMaterialTextures.clear();
+        for (u32 i = 0; i < mScene->mNumMaterials; i++) {
+            mMaterialTextures.emplace_back(FindMaterialTexture(i));
+        }
+
+        // Decode every texture once, the exporter only works with raw pixels from here on
+        std::vector<TPL::Image> images(textureCount);
+        parallel_for(textureCount, [&](u32 i) {
+            int width = 0;
+            int height = 0;
+            images[i].pixels = TPL::ReadTexturePixels(mScene->mTextures[i], width, height);
+            images[i].header.width = width;
+            images[i].header.height = height;
+            images[i].name = mScene->mTextures[i]->mFilename.C_Str();
+        });
+
+        // Models often embed the same image once per material. Only the first copy is kept,
+        // but only if the copies would also be written with the same settings
+        std::unordered_map<u64, std::vector<u32>> uniqueTextures;
+        std::vector<u32> uniqueImages;
+        for (u32 i = 0; i < textureCount; i++) {
+            const TPL::Image& image = images[i];
+            TextureConfig config = GetTextureConfig(i);
+
+            u64 hash = hash_bytes(image.pixels.data(), image.pixels.size() * sizeof(Color));
+            hash = hash_combine(hash, ((u64)image.header.width << 32) | image.header.height);
+            hash = hash_combine(hash, ((u64)config.mWrapModeU << 8) | (u64)config.mWrapModeV);
+            hash = hash_combine(hash, ((u64)config.mFormat << 32) | (u64)config.mCompressionQuality);
+            hash = hash_combine(hash, (u64)config.mUseTransparency | (u64)config.mDither << 1 | (u64)config.mGenerateMipmaps << 2);
+
+            for (u32 other : uniqueTextures[hash]) {
+                const TPL::Image& otherImage = images[other];
+                if (otherImage.header.width == image.header.width && otherImage.header.height == image.header.height
+                        && memcmp(otherImage.pixels.data(), image.pixels.data(), image.pixels.size() * sizeof(Color)) == 0) {
+                    mTextureRemap[i] = mTextureRemap[other];
+                    LogInfo("Texture '%s' is a duplicate of '%s'", image.name.c_str(), otherImage.name.c_str());
+                    break;
+                }
+            }
+
+            if (mTextureRemap[i] != -1)
+                continue;
+
+            uniqueTextures[hash].emplace_back(i);
+            mTextureRemap[i] = mTextures.size();
+            mTextures.emplace_back(TPL::CreateTexture(image));
+            mTextureConfigs.emplace_back(config);
+            uniqueImages.emplace_back(i);
+        }
+        mOwnedTextures = mTextures;
+
+        // Every budget attempt resizes from the decoded images, so retries don't resample an already resampled texture
+        std::vector<TPL::Image> sources(uniqueImages.size());
+        for (size_t i = 0; i < uniqueImages.size(); i++) {
+            sources[i] = std::move(images[uniqueImages[i]]);
+        }
+
+        if (mTextures.size() < textureCount)
+            LogInfo("Removed %zu duplicate textures", textureCount - mTextures.size());
+
+        // Choosing a format encodes the texture in every candidate format, so the budget estimates are only chosen once
+        const u64 maxMapSize = mMapConfig.mTextureBudget.mMaxMapSize;
+        std::vector<TPLImageFormat> formats;
+        if (maxMapSize > 0)
+            formats = ChooseTextureFormats(sources);
+
+        // Atlas pages round up to a power of two and add guard bands, so the map budget is checked again once they are built.
+        // If the pages go over it, the atlas is undone and the textures are shrunk to a budget lowered by the same ratio the pages went over
+        constexpr int MaxAtlasBudgetAttempts = 4;
+        u64 budget = maxMapSize;
+        for (int attempt = 1; ; attempt++) {
+            bool fits = EnforceTextureBudget(sources, formats, budget);
+
+            mAtlasRects.assign(textureCount, TextureAtlasRect());
+            if (!mMapConfig.mAtlasConfig.mEnabled)
+                break;
+
+            std::vector<aiTexture*> unpackedTextures = mTextures;
+            std::vector<TextureConfig> unpackedConfigs = mTextureConfigs;
+            std::vector<int> unpackedRemap = mTextureRemap;
+            BuildTextureAtlas();
+            if (maxMapSize == 0 || mAtlasPageCount == 0)
+                break;
+
+            // Formats are stored in the texture configs by the budget, pages take the format of their group
+            u64 total = 0;
+            for (u32 i = 0; i < mTextures.size(); i++) {
+                bool page = i >= mTextures.size() - mAtlasPageCount;
+                total += GetTextureMemorySize(mTextureConfigs[i].mFormat, mTextures[i]->mWidth, mTextures[i]->mHeight, mTextureConfigs[i].mGenerateMipmaps, page ? TextureAtlas::MaxMipmapCount : 0);
+            }
+
+            if (total <= maxMapSize)
+                break;
+
+            if (!fits || attempt == MaxAtlasBudgetAttempts) {
+                LogWarn("Texture atlas pages take the textures to %llu bytes, over the map texture budget of %llu bytes", (unsigned long long)total, (unsigned long long)maxMapSize);
+                break;
+            }
+
+            LogInfo("Texture atlas pages take the textures to %llu bytes, over the map texture budget of %llu bytes. Shrinking them further", (unsigned long long)total, (unsigned long long)maxMapSize);
+            for (size_t i = mOwnedTextures.size() - mAtlasPageCount; i < mOwnedTextures.size(); i++) {
+                delete mOwnedTextures[i];
+            }
+            mOwnedTextures.resize(mOwnedTextures.size() - mAtlasPageCount);
+            mTextures = std::move(unpackedTextures);
+            mTextureConfigs = std::move(unpackedConfigs);
+            mTextureRemap = std::move(unpackedRemap);
+            mAtlasPageCount = 0;
+            budget = std::max<u64>(budget * maxMapSize / total, 1);
+        }
+    }
+
+    // Power of two textures stay power of two so they can keep their mipmaps, other sizes are kept a multiple of the block size
+    static void ShrinkTextureSize(int& width, int& height, int maxSize) {
+        int largest = std::max(width, height);
+        if (std::has_single_bit((u32)width) && std::has_single_bit((u32)height)) {
+            while (largest > maxSize) {
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+                largest /= 2;
+            }
+            return;
+        }
+
+        float scale = (float)maxSize / largest;
+        width = std::max((int)(width * scale) / 4 * 4, 4);
+        height = std::max((int)(height * scale) / 4 * 4, 4);
+    }
+
+    std::vector<TPLImageFormat> GeometryExporter::ChooseTextureFormats(const std::vector<TPL::Image>& sources) {
+        std::vector<TPLImageFormat> formats(mTextures.size());
+        parallel_for(mTextures.size(), [&](u32 i) {
+            const TextureConfig& config = mTextureConfigs[i];
+            if (config.mFormat != TPLImageFormat::Auto) {
+                formats[i] = config.mFormat;
+                return;
+            }
+
+            const TPL::Image& source = sources[i];
+            formats[i] = TPLEncoder::ChooseFormat(source.pixels.data(), source.header.width, source.header.height, config.mCompressionQuality, config.mDither).mFormat;
+        });
+
+        return formats;
+    }
+
+    bool GeometryExporter::EnforceTextureBudget(const std::vector<TPL::Image>& sources, const std::vector<TPLImageFormat>& sourceFormats, u64 maxMapSize) {
+        const TextureBudgetConfig& budget = mMapConfig.mTextureBudget;
+        const u32 textureCount = mTextures.size();
+
+        struct TextureSize {
+            int width;
+            int height;
+        };
+
+        std::vector<TextureSize> sizes(textureCount);
+        std::vector<TextureSize> originalSizes(textureCount);
+        for (u32 i = 0; i < textureCount; i++) {
+            originalSizes[i] = { (int)sources[i].header.width, (int)sources[i].header.height };
+            sizes[i] = originalSizes[i];
+            if ((u32)std::max(sizes[i].width, sizes[i].height) > budget.mMaxTextureSize)
+                ShrinkTextureSize(sizes[i].width, sizes[i].height, budget.mMaxTextureSize);
+        }
+
+        // Until the final sizes are known, automatic formats are estimated with the format chosen for the source image.
+        // Without a map budget they are only chosen when the tpl is written, so they are counted as RGBA32
+        std::vector<TPLImageFormat> formats(textureCount);
+        for (u32 i = 0; i < textureCount; i++) {
+            TPLImageFormat format = mTextureConfigs[i].mFormat;
+            if (format == TPLImageFormat::Auto)
+                format = maxMapSize > 0 ? sourceFormats[i] : TPLImageFormat::RGBA32;
+            formats[i] = format;
+        }
+        auto getSize = [&](u32 i, const TextureSize& size) {
+            return GetTextureMemorySize(formats[i], size.width, size.height, mTextureConfigs[i].mGenerateMipmaps);
+        };
+
+        // Halving the largest texture first costs the least detail for the memory it frees
+        auto shrinkToBudget = [&]() {
+            u64 total = 0;
+            for (u32 i = 0; i < textureCount; i++) {
+                total += getSize(i, sizes[i]);
+            }
+
+            while (total > maxMapSize) {
+                int largest = -1;
+                u64 largestSize = 0;
+                for (u32 i = 0; i < textureCount; i++) {
+                    u64 size = getSize(i, sizes[i]);
+                    if (std::max(sizes[i].width, sizes[i].height) > 8 && size > largestSize) {
+                        largest = i;
+                        largestSize = size;
+                    }
+                }
+
+                if (largest == -1) {
+                    LogWarn("Textures can't be shrunk to fit the map texture budget of %llu bytes, they use %llu bytes", (unsigned long long)maxMapSize, (unsigned long long)total);
+                    return false;
+                }
+
+                ShrinkTextureSize(sizes[largest].width, sizes[largest].height, std::max(sizes[largest].width, sizes[largest].height) / 2);
+                total = total - largestSize + getSize(largest, sizes[largest]);
+            }
+
+            return true;
+        };
+
+        // Resized pixels are kept so a texture whose format is chosen at its new size isn't resized twice
+        std::vector<std::vector<Color>> pixels(textureCount);
+        std::vector<TextureSize> pixelSizes(textureCount, TextureSize { 0, 0 });
+        auto resize = [&](u32 i) {
+            if (pixelSizes[i].width == sizes[i].width && pixelSizes[i].height == sizes[i].height)
+                return;
+
+            const TPL::Image& source = sources[i];
+            if (sizes[i].width == originalSizes[i].width && sizes[i].height == originalSizes[i].height)
+                pixels[i] = source.pixels;
+            else
+                pixels[i] = TPLEncoder::Resize(source.pixels.data(), source.header.width, source.header.height, sizes[i].width, sizes[i].height);
+            pixelSizes[i] = sizes[i];
+        };
+
+        bool fits = true;
+        if (maxMapSize > 0) {
+            fits = shrinkToBudget();
+
+            // A downscaled image has more detail per pixel, so its format is chosen again on the resized pixels. The choice is stored
+            // in the texture config, so the tpl is written with exactly the formats the budget is checked against
+            parallel_for(textureCount, [&](u32 i) {
+                TextureConfig& config = mTextureConfigs[i];
+                if (config.mFormat != TPLImageFormat::Auto)
+                    return;
+
+                if (sizes[i].width != originalSizes[i].width || sizes[i].height != originalSizes[i].height) {
+                    resize(i);
+                    formats[i] = TPLEncoder::ChooseFormat(pixels[i].data(), sizes[i].width, sizes[i].height, config.mCompressionQuality, config.mDither).mFormat;
+                }
+                config.mFormat = formats[i];
+            });
+
+            // Textures that need a larger format at their new size can take the map over the budget again, they are shrunk further keeping their format
+            if (fits)
+                fits = shrinkToBudget();
+        }
+
+        // A texture is rebuilt when its size changed since the last attempt, always from its source image
+        std::vector<bool> resized(textureCount, false);
+        std::vector<bool> replaced(textureCount, false);
+        for (u32 i = 0; i < textureCount; i++) {
+            resized[i] = sizes[i].width != originalSizes[i].width || sizes[i].height != originalSizes[i].height;
+            replaced[i] = sizes[i].width != (int)mTextures[i]->mWidth || sizes[i].height != (int)mTextures[i]->mHeight;
+        }
+
+        parallel_for(textureCount, [&](u32 i) {
+            if (!replaced[i])
+                return;
+
+            resize(i);
+            TPL::Image image;
+            image.pixels = std::move(pixels[i]);
+            image.header.width = sizes[i].width;
+            image.header.height = sizes[i].height;
+            image.name = sources[i].name;
+            mTextures[i] = TPL::CreateTexture(image);
+        });
+
+        for (u32 i = 0; i < textureCount; i++) {
+            if (!replaced[i])
+                continue;
+
+            delete mOwnedTextures[i];
+            mOwnedTextures[i] = mTextures[i];
+        }
+
+        // Report what was resized
+        u64 savedSize = 0;
+        u64 totalSize = 0;
+        u32 resizedCount = 0;
+        for (u32 i = 0; i < textureCount; i++) {
+            u64 size = getSize(i, sizes[i]);
+            totalSize += size;
+            if (!resized[i])
+                continue;
+
+            u64 originalSize = getSize(i, originalSizes[i]);
+            savedSize += originalSize - size;
+            resizedCount++;
+            LogInfo("Downscaled texture '%s' from %dx%d to %dx%d, saving %llu bytes", mTextures[i]->mFilename.C_Str(), originalSizes[i].width, originalSizes[i].height,
+                    sizes[i].width, sizes[i].height, (unsigned long long)(originalSize - size));
+        }
+
+        if (resizedCount > 0)
+            LogInfo("Texture budget downscaled %u textures, saving %llu bytes. Textures use %llu bytes", resizedCount, (unsigned long long)savedSize, (unsigned long long)totalSize);
+
+        return fits;
+    }
+
+    void GeometryExporter::BuildTextureAtlas() {
+        const AtlasConfig& atlasConfig = mMapConfig.mAtlasConfig;
+        const u32 textureCount = mTextures.size();
+
+        // Pages are textures too, so they have to stay within the texture budget
+        const u32 pageSize = std::min(atlasConfig.mPageSize, std::bit_floor(mMapConfig.mTextureBudget.mMaxTextureSize));
+
+        // An atlased texture can't tile, so textures on meshes with uvs outside of 0-1 are left on their own
+        constexpr float UVEpsilon = 0.001f;
+        std::vector<bool> used(textureCount, false);
+        std::vector<bool> tiles(textureCount, false);
+        for (u32 m = 0; m < mScene->mNumMeshes; m++) {
+            const aiMesh* mesh = mScene->mMeshes[m];
+            int sceneTexture = mMaterialTextures[mesh->mMaterialIndex];
+            if (sceneTexture < 0)
+                continue;
+
+            int texture = mTextureRemap[sceneTexture];
+            used[texture] = true;
+            if (!mesh->HasTextureCoords(0))
+                continue;
+
+            for (u32 v = 0; v < mesh->mNumVertices && !tiles[texture]; v++) {
+                const aiVector3D& uv = mesh->mTextureCoords[0][v];
+                tiles[texture] = uv.x < -UVEpsilon || uv.x > 1.0f + UVEpsilon || uv.y < -UVEpsilon || uv.y > 1.0f + UVEpsilon;
+            }
+        }
+
+        // Textures can only share a page if everything written to the tpl and map texture matches
+        typedef std::tuple<u8, u8, bool, TPLImageFormat, TPLCompressionQuality, bool, bool> AtlasKey;
+        std::map<AtlasKey, std::vector<u32>> groups;
+        std::vector<TextureAtlasRect> rects(textureCount);
+        for (u32 i = 0; i < textureCount; i++) {
+            if (!used[i] || tiles[i])
+                continue;
+
+            int width = mTextures[i]->mWidth;
+            int height = mTextures[i]->mHeight;
+            int cellSize = (std::max(width, height) + 3) / 4 * 4 + TextureAtlas::GuardBand * 2;
+            if ((u32)std::max(width, height) > atlasConfig.mMaxTextureSize || (u32)cellSize > pageSize)
+                continue;
+
+            const TextureConfig& config = mTextureConfigs[i];
+            groups[{ (u8)config.mWrapModeU, (u8)config.mWrapModeV, config.mUseTransparency, config.mFormat, config.mCompressionQuality, config.mDither, config.mGenerateMipmaps }].emplace_back(i);
+            rects[i].mWidth = width;
+            rects[i].mHeight = height;
+        }
+
+        std::vector<bool> packed(textureCount, false);
+        std::vector<aiTexture*> pageTextures;
+        std::vector<TextureConfig> pageConfigs;
+        u32 packedCount = 0;
+        for (const auto& [key, members] : groups) {
+            if (members.size() < 2)
+                continue;
+
+            std::vector<TextureAtlasRect> groupRects;
+            for (u32 texture : members) {
+                groupRects.emplace_back(rects[texture]);
+            }
+            std::vector<TextureAtlasPage> pages = TextureAtlas::Pack(groupRects, pageSize);
+
+            const TextureConfig& config = mTextureConfigs[members[0]];
+            std::vector<TPL::Image> images(pages.size());
+            for (size_t p = 0; p < pages.size(); p++) {
+                images[p].header.width = pages[p].mWidth;
+                images[p].header.height = pages[p].mHeight;
+                images[p].name = "atlas_" + std::to_string(pageTextures.size() + p);
+                images[p].pixels.resize(pages[p].mWidth * pages[p].mHeight);
+            }
+
+            for (size_t j = 0; j < members.size(); j++) {
+                int width = 0;
+                int height = 0;
+                std::vector<Color> pixels = TPL::ReadTexturePixels(mTextures[members[j]], width, height);
+                TextureAtlas::Blit(pixels.data(), groupRects[j], config.mWrapModeU, config.mWrapModeV, images[groupRects[j].mPage].pixels.data(), pages[groupRects[j].mPage].mWidth);
+
+                // Page indices are made relative to mTextures once every group is packed
+                groupRects[j].mPage += pageTextures.size();
+                rects[members[j]] = groupRects[j];
+                packed[members[j]] = true;
+            }
+
+            for (const TPL::Image& image : images) {
+                pageTextures.emplace_back(TPL::CreateTexture(image));
+                pageConfigs.emplace_back(config);
+                pageConfigs.back().mName = image.name;
+            }
+
+            packedCount += members.size();
+            LogInfo("Packed %zu textures into %zu atlas pages", members.size(), pages.size());
+        }
+
+        if (pageTextures.empty())
+            return;
+
+        // Rebuild the texture list, textures that weren't packed keep their order and the pages go last
+        std::vector<aiTexture*> textures = std::move(mTextures);
+        std::vector<TextureConfig> configs = std::move(mTextureConfigs);
+        std::vector<int> remap(textureCount);
+        mTextures.clear();
+        mTextureConfigs.clear();
+        for (u32 i = 0; i < textureCount; i++) {
+            if (packed[i])
+                continue;
+
+            remap[i] = mTextures.size();
+            mTextures.emplace_back(textures[i]);
+            mTextureConfigs.emplace_back(configs[i]);
+        }
+
+        int firstPage = mTextures.size();
+        for (u32 i = 0; i < textureCount; i++) {
+            if (!packed[i])
+                continue;
+
+            rects[i].mPage += firstPage;
+            remap[i] = rects[i].mPage;
+        }
+
+        // Point the scene textures at their new place
+        for (size_t i = 0; i < mTextureRemap.size(); i++) {
+            int texture = mTextureRemap[i];
+            mTextureRemap[i] = remap[texture];
+            if (packed[texture])
+                mAtlasRects[i] = rects[texture];
+        }
+
+        mTextures.insert(mTextures.end(), pageTextures.begin(), pageTextures.end());
+        mTextureConfigs.insert(mTextureConfigs.end(), pageConfigs.begin(), pageConfigs.end());
+        mOwnedTextures.insert(mOwnedTextures.end(), pageTextures.begin(), pageTextures.end());
+        mAtlasPageCount = pageTextures.size();
+        LogInfo("Texture atlases replaced %u textures with %zu pages", packedCount, pageTextures.size());
+    }
+
+    int GeometryExporter::FindMaterialTexture(u32 materialIndex) {
+        const aiMaterial* material = mScene->mMaterials[materialIndex];
+        if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0)
+            return -1;
+
+        Assert(mScene->mNumTextures > 0, "Material uses textures but scene does not model does not contain any embedded textures");
+        aiString path;
+        Assert(aiReturn_SUCCESS == material->GetTexture(aiTextureType_DIFFUSE, 0, &path), "Failed to get texture for material '%s'", material->GetName().C_Str());
+        if (mTextureNameToIndex.contains(path.C_Str()))
+            return mTextureNameToIndex[path.C_Str()];
+
+        // Check if texture name is assimp using an image index
+        if (path.C_Str()[0] == '*') {
+            u32 imageIndex = std::stoi(path.C_Str() + 1);
+            if (imageIndex < mScene->mNumTextures)
+                return imageIndex;
+        }
+
+        LogWarn("Texture Name To Index table does not have texture '%s'. Using first texture.", path.C_Str());
+        return 0;
+    }
+
+    aiVector3D GeometryExporter::GetMeshUV(const aiMesh* mesh, u32 vertex) {
+        aiVector3D uv = mesh->mTextureCoords[0][vertex];
+        int texture = mMaterialTextures[mesh->mMaterialIndex];
+        if (texture < 0 || mAtlasRects[texture].mPage < 0)
+            return uv;
+
+        // Pages are stored top row first while v points up, so v is flipped into texels and back
+        const TextureAtlasRect& rect = mAtlasRects[texture];
+        const aiTexture* page = mTextures[rect.mPage];
+        float u = std::clamp(uv.x, 0.0f, 1.0f);
+        float v = std::clamp(uv.y, 0.0f, 1.0f);
+        uv.x = (rect.mX + u * rect.mWidth) / page->mWidth;
+        uv.y = 1.0f - (rect.mY + (1.0f - v) * rect.mHeight) / page->mHeight;
+        return uv;
+    }
+
     void GeometryExporter::WriteTPL(const char* outputPath) {
         constexpr u32 MAX_TEXTURE_COUNT = 1024;
         TPLImageCreateInfo imageCreateInfos[MAX_TEXTURE_COUNT];
-        for (size_t i = 0; i < mScene->mNumTextures; i++) {
-            imageCreateInfos[i].mFormat = TPLImageFormat::RGBA32;
-            imageCreateInfos[i].mTexture = mScene->mTextures[i];
+        Assert(mTextures.size() <= MAX_TEXTURE_COUNT, "Cannot write more than %u textures, got %zu", MAX_TEXTURE_COUNT, mTextures.size());
+        for (size_t i = 0; i < mTextures.size(); i++) {
+            const TextureConfig& config = mTextureConfigs[i];
+            imageCreateInfos[i].mFormat = config.mFormat;
+            imageCreateInfos[i].mQuality = config.mCompressionQuality;
+            imageCreateInfos[i].mDither = config.mDither;
+            imageCreateInfos[i].mGenerateMipmaps = config.mGenerateMipmaps;
+            imageCreateInfos[i].mMaxMipmapCount = i >= mTextures.size() - mAtlasPageCount ? TextureAtlas::MaxMipmapCount : 0;
+            imageCreateInfos[i].mTexture = mTextures[i];
         }
 
         TPLCreateInfo createInfo = {
             .mImageCreateInfos = imageCreateInfos,
-            .mImageCreateInfoCount = mScene->mNumTextures,
+            .mImageCreateInfoCount = (uint)mTextures.size(),
         };
 
         TPL tpl = TPL::CreateTPL(createInfo);
@@ -2,179 +2,397 @@
 #include "FileTypes/LevelGeometry/MapStructures.h"
 #include "Types/Types.h"
 #include "core/Logging.h"
-#include "assimp/anim.h"
-#include "assimp/matrix4x4.h"
+#include "core/arena.h"
 #include "core/filesystem.h"
-#include "glm/ext/scalar_constants.hpp"
+#include "core/cpu.h"
+#include "core/hash.h"
+#include "core/jobs.h"
 
-#define FPNG_NO_SSE 1
-#include "assimp/material.h"
-#include "assimp/quaternion.h"
-#include "assimp/types.h"
-#include "assimp/vector3.h"
-#include "fpng.cpp" // stbi cant write to mempry
+#include "fpng.h" // stbi cant write to mempry
 
+#include <cmath>
+#include <cstring>
 #include <numbers>
 #include <string>
+#include <unordered_map>
+
+#ifdef SPME_X86
+#include <immintrin.h>
+#endif
 
 namespace SPMEditor {
 
-    const u8* LevelGeometry::sData;
-    aiScene* LevelGeometry::sCurrentScene;
-    int LevelGeometry::s_FirstMaterialAddress; // Required to calculate the material index for each mesh
-    LevelData* LevelGeometry::s_CurrentLevel;
-    VCDTable LevelGeometry::s_VCDTable; 
-    int objectCount = 0;
+    // ---------------- /
+    // VCD dequantization
+    // ---------------- /
 
-    aiScene* LevelGeometry::LoadFromBytes(const std::vector<u8>& fileData, TPL tpl, LevelData* level) {
-        return LoadFromBytes(fileData.data(), fileData.size(), tpl, level);
+    // Each converts count big endian values to floats multiplied by scale
+    typedef void (*Dequantizer)(const u8* data, u32 count, float scale, float* output);
+
+    static void DequantizeS16_Scalar(const u8* data, u32 count, float scale, float* output) {
+        for (u32 i = 0; i < count; i++) {
+            output[i] = (s16)(data[i * 2] << 8 | data[i * 2 + 1]) * scale;
+        }
     }
 
-    aiScene* LevelGeometry::LoadFromBytes(const u8* data, u64 size, TPL tpl, LevelData* level) {
-        sCurrentScene = new aiScene();
-        s_CurrentLevel = level;
+    static void DequantizeS8_Scalar(const u8* data, u32 count, float scale, float* output) {
+        for (u32 i = 0; i < count; i++) {
+            output[i] = (s8)data[i] * scale;
+        }
+    }
 
-        // Start by loading textures since we have that right here
-        sCurrentScene->mNumTextures = tpl.images.size();
-        sCurrentScene->mTextures = new aiTexture*[tpl.images.size()];
-        for (size_t i = 0; i < tpl.images.size(); i++) {
-            TPL::Image image = tpl.images[i];
-            aiTexture* texture = new aiTexture();
+#ifdef SPME_X86
+    SPME_TARGET("sse4.1")
+    static void DequantizeS16_SSE41(const u8* data, u32 count, float scale, float* output) {
+        const __m128i byteSwap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        const __m128 scaleVector = _mm_set1_ps(scale);
+        u32 i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i raw = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 2)), byteSwap);
+            __m128 low = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(raw));
+            __m128 high = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(raw, 8)));
+            _mm_storeu_ps(output + i, _mm_mul_ps(low, scaleVector));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(high, scaleVector));
+        }
 
-            std::vector<u8> pngPixels;
-            fpng::fpng_encode_image_to_memory(image.pixels.data(), image.header.width, image.header.height, 4, pngPixels);
-            texture->mWidth = pngPixels.size();
-            texture->mHeight = 0;
-            texture->pcData = new aiTexel[pngPixels.size()];
-            memcpy(texture->achFormatHint, "png\x0", 4);
+        DequantizeS16_Scalar(data + i * 2, count - i, scale, output + i);
+    }
 
-            u8* texturePixels = (u8*)texture->pcData;
-            for (size_t p = 0; p < pngPixels.size(); p++)
-            {
-                texturePixels[p] = pngPixels[p];
+    SPME_TARGET("sse4.1")
+    static void DequantizeS8_SSE41(const u8* data, u32 count, float scale, float* output) {
+        const __m128 scaleVector = _mm_set1_ps(scale);
+        u32 i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(data + i));
+            for (int part = 0; part < 4; part++, raw = _mm_srli_si128(raw, 4)) {
+                _mm_storeu_ps(output + i + part * 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(raw)), scaleVector));
             }
+        }
 
-            sCurrentScene->mTextures[i] = texture;
+        DequantizeS8_Scalar(data + i, count - i, scale, output + i);
+    }
+
+    SPME_TARGET("avx2")
+    static void DequantizeS16_AVX2(const u8* data, u32 count, float scale, float* output) {
+        const __m256i byteSwap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        const __m256 scaleVector = _mm256_set1_ps(scale);
+        u32 i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m256i raw = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(data + i * 2)), byteSwap);
+            __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(raw)));
+            __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(raw, 1)));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(low, scaleVector));
+            _mm256_storeu_ps(output + i + 8, _mm256_mul_ps(high, scaleVector));
         }
 
+        DequantizeS16_Scalar(data + i * 2, count - i, scale, output + i);
+    }
+
+    SPME_TARGET("avx2")
+    static void DequantizeS8_AVX2(const u8* data, u32 count, float scale, float* output) {
+        const __m256 scaleVector = _mm256_set1_ps(scale);
+        u32 i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i raw = _mm_loadu_si128((const __m128i*)(data + i));
+            __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(raw));
+            __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(raw, 8)));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(low, scaleVector));
+            _mm256_storeu_ps(output + i + 8, _mm256_mul_ps(high, scaleVector));
+        }
+
+        DequantizeS8_Scalar(data + i, count - i, scale, output + i);
+    }
+#endif
+
+    static Dequantizer GetS16Dequantizer() {
+#ifdef SPME_X86
+        if (cpu_has_avx2())
+            return DequantizeS16_AVX2;
+        if (cpu_has_sse41())
+            return DequantizeS16_SSE41;
+#endif
+        return DequantizeS16_Scalar;
+    }
+
+    static Dequantizer GetS8Dequantizer() {
+#ifdef SPME_X86
+        if (cpu_has_avx2())
+            return DequantizeS8_AVX2;
+        if (cpu_has_sse41())
+            return DequantizeS8_SSE41;
+#endif
+        return DequantizeS8_Scalar;
+    }
+
+    LevelGeometry::LevelGeometry(const u8* data, u64 size, const TPL* textures) : mData(data + 0x20), mSize(size), mTPL(textures), mScene(new Scene()), mReadSections(0), mFirstMaterialAddress(0), mVCDTable(), mObjectCount(0) {
         // Load header
+        Assert(size >= sizeof(FileHeader), "map.dat is too small to hold its header (0x%llx bytes)", (unsigned long long)size);
         FileHeader header = *(FileHeader*)data;
         ByteSwap4(&header, 4);
 
-        // Grab the actual data from the file
-        sData = data + 0x20; // skip the file header
-
-        // Read the sectoins
+        // Everything after the header is addressed from the end of it
         int sectionTableOffset = header.pointerEntryCount * 4 + header.pointerListStart;
+        ReadSectionDirectory(sectionTableOffset, header.sectionCount);
+    }
+
+    LevelGeometry::~LevelGeometry() {
+        delete mScene;
+    }
+
+    Scene* LevelGeometry::ReleaseScene() {
+        Scene* scene = mScene;
+        mScene = nullptr;
+        return scene;
+    }
+
+    Scene* LevelGeometry::LoadFromBytes(const std::vector<u8>& fileData, TPL tpl, LevelData* level) {
+        return LoadFromBytes(fileData.data(), fileData.size(), tpl, level);
+    }
+
+    Scene* LevelGeometry::LoadFromBytes(const u8* data, u64 size, TPL tpl, LevelData* level) {
+        // Every load gets its own parse state, so maps can be loaded on several threads at once
+        LevelGeometry geometry(data, size, &tpl);
+
+        u32 count;
+        geometry.GetMaterials(count); // Reads the textures first
+        geometry.GetMeshes(count); // Reads the object tree first
+        geometry.GetAnimations(count);
+        geometry.GetLightCount();
+        if (level)
+            level->fogSettings = geometry.GetFog();
+        if (geometry.HasSection(MapSection::CurveTable))
+            geometry.ReadCurveTable(geometry.mSectionOffsets[(u32)MapSection::CurveTable]);
+
+        Scene* scene = geometry.ReleaseScene();
+        LogInfo("Scene has %u materials and %u textures", scene->mMaterialCount, scene->mTextureCount);
+        LogInfo("Scene uses %llu bytes", (unsigned long long)arena_used(scene->mArena));
+        return scene;
+    }
 
-        // Ok so some sections need to be read in a specific order because of assimp
-        // Namely the material table because assimp references the material via an index
-        // instead of a file pointer like the map data. who could have guessed that
-        Section vcdSection = FindSection("vcd_table", sectionTableOffset, header.sectionCount);
-        s_VCDTable = ReadVCDTable(vcdSection.fileOffset);
-
-        Section materialSection = FindSection("material_name_table", sectionTableOffset, header.sectionCount);
-        ReadMaterialNameTable(materialSection.fileOffset, tpl.images.size());
-
-        Section infoSection = FindSection("information", sectionTableOffset, header.sectionCount);
-        std::vector<aiMesh*> meshes;
-        sCurrentScene->mRootNode = ReadInfoSection(infoSection.fileOffset, meshes);
-        sCurrentScene->mNumMeshes = meshes.size();
-        sCurrentScene->mMeshes = new aiMesh*[meshes.size()];
-        for (uint i = 0; i < sCurrentScene->mNumMeshes; i++) {
-            sCurrentScene->mMeshes[i] = meshes[i];
+    void LevelGeometry::ReadSectionDirectory(int sectionTableOffset, int sectionCount) {
+        for (u32 i = 0; i < (u32)MapSection::Count; i++) {
+            mSectionOffsets[i] = -1;
         }
 
-        LogInfo("Scene has %d materials", sCurrentScene->mNumMaterials);
+        // Each entry is the offset of the section and the offset of its name, the names follow the entries
+        const int* entries = (const int*)(mData + sectionTableOffset);
+        const char* names = (const char*)(mData + sectionTableOffset + 8 * sectionCount);
+        for (int i = 0; i < sectionCount; i++) {
+            int fileOffset = ByteSwap(entries[i * 2]);
+            const char* name = names + ByteSwap(entries[i * 2 + 1]);
+            Assert(fileOffset >= 0 && fileOffset + sizeof(FileHeader) < mSize, "Section '%s' at 0x%x is outside of the file", name, fileOffset);
+            LogInfo("Section 0x%x (%s) is at 0x%x", i, name, fileOffset);
+
+            MapSection section;
+            switch (str2int(name)) {
+                case str2int("information"):            section = MapSection::Information; break;
+                case str2int("texture_table"):          section = MapSection::TextureTable; break;
+                case str2int("material_name_table"):    section = MapSection::MaterialNameTable; break;
+                case str2int("vcd_table"):              section = MapSection::VCDTable; break;
+                case str2int("light_table"):            section = MapSection::LightTable; break;
+                case str2int("fog_table"):              section = MapSection::FogTable; break;
+                case str2int("animation_table"):        section = MapSection::AnimationTable; break;
+                case str2int("curve_table"):            section = MapSection::CurveTable; break;
+                default:
+                    LogWarn("----------- Section %s at offset 0x%x not implemented -----------", name, fileOffset);
+                    continue;
+            }
 
-        for (int i = 0; i < header.sectionCount; i++) {
-            Section section;
-            section.fileOffset = ByteSwap(*(int*)(sData + sectionTableOffset + i * 8));
-            int nameOffset = ByteSwap(*(int*)(sData + sectionTableOffset + i * 8 + 4));
+            mSectionOffsets[(u32)section] = fileOffset;
+        }
+    }
 
-            section.name = (char*)(sData + sectionTableOffset + nameOffset + 8 * header.sectionCount);
+    const SceneTexture* LevelGeometry::GetTextures(u32& count) {
+        if (!IsRead(MapSection::TextureTable)) {
+            MarkRead(MapSection::TextureTable);
+
+            std::vector<std::string> textureNames;
+            if (HasSection(MapSection::TextureTable))
+                textureNames = ReadTextureNames(mSectionOffsets[(u32)MapSection::TextureTable]);
+
+            // Without the TPL only the names are known
+            u32 textureCount = mTPL ? mTPL->images.size() : textureNames.size();
+            // I swear to god if this ever happens
+            Assert(textureCount >= textureNames.size(), "Trying to read more texture names than there are textures! \n\tTexture Name Count: 0x%x\n\tScene Texture Count: %u", textureNames.size(), textureCount);
+
+            mScene->mTextureCount = textureCount;
+            mScene->mTextures = arena_alloc_array<SceneTexture>(mScene->mArena, textureCount);
+            for (u32 i = 0; i < textureCount; i++) {
+                SceneTexture& texture = mScene->mTextures[i];
+                if (mTPL) {
+                    const TPL::Image& image = mTPL->images[i];
+                    texture.mName = arena_copy_string(mScene->mArena, image.name.c_str());
+                    texture.mWidth = image.header.width;
+                    texture.mHeight = image.header.height;
+                    texture.mPixels = arena_alloc_array<Color>(mScene->mArena, image.pixels.size());
+                    memcpy(texture.mPixels, image.pixels.data(), image.pixels.size() * sizeof(Color));
+                }
 
-            LogInfo("Section 0x%x (%s) is at 0x%x", i, section.name.c_str(), section.fileOffset);
-            ReadSection(section);
+                if (i < textureNames.size())
+                    texture.mName = arena_copy_string(mScene->mArena, textureNames[i].c_str());
+            }
         }
 
-        LogInfo("Total texture count: %u", sCurrentScene->mNumTextures);
+        count = mScene->mTextureCount;
+        return mScene->mTextures;
+    }
+
+    const SceneMaterial* LevelGeometry::GetMaterials(u32& count) {
+        if (!IsRead(MapSection::MaterialNameTable)) {
+            MarkRead(MapSection::MaterialNameTable);
+            if (HasSection(MapSection::MaterialNameTable))
+                ReadMaterialNameTable(mSectionOffsets[(u32)MapSection::MaterialNameTable]);
+
+            // Materials only store the name of their texture
+            u32 textureCount;
+            const SceneTexture* textures = GetTextures(textureCount);
+            for (u32 i = 0; i < mScene->mMaterialCount; i++) {
+                SceneMaterial& material = mScene->mMaterials[i];
+                material.mTextureIndex = -1;
+                if (material.mTextureName == nullptr)
+                    continue;
+
+                for (u32 t = 0; t < textureCount && material.mTextureIndex == -1; t++) {
+                    if (textures[t].mName && strcmp(textures[t].mName, material.mTextureName) == 0)
+                        material.mTextureIndex = t;
+                }
+
+                if (material.mTextureIndex == -1)
+                    LogWarn("Material '%s' references texture '%s' which is not in the texture table", material.mName, material.mTextureName);
+            }
+        }
 
-        return sCurrentScene;
+        count = mScene->mMaterialCount;
+        return mScene->mMaterials;
     }
 
-    Section LevelGeometry::FindSection(const std::string& name, int sectionTableOffset, int sectionCount) {
-        for (int i = 0; i < sectionCount; i++) {
-            Section section;
-            section.fileOffset = ByteSwap(*(int*)(sData + sectionTableOffset + i * 8));
-            int nameOffset = ByteSwap(*(int*)(sData + sectionTableOffset + i * 8 + 4));
+    const SceneNode* LevelGeometry::GetObjects(u32& count) {
+        if (!IsRead(MapSection::Information)) {
+            MarkRead(MapSection::Information);
 
-            section.name = (char*)(sData + sectionTableOffset + nameOffset + 8 * sectionCount);
+            // Objects turn the address of a material into its index, which only takes the first entry of the material table
+            if (HasSection(MapSection::MaterialNameTable)) {
+                const u8* materialTable = mData + mSectionOffsets[(u32)MapSection::MaterialNameTable];
+                if (ByteSwap(*(u32*)materialTable) > 0)
+                    mFirstMaterialAddress = ByteSwap(((const MaterialNameEntry*)(materialTable + 4))->materialOffset);
+            }
 
-            if (section.name == name)
-                return section;
+            if (HasSection(MapSection::Information))
+                ReadInfoSection(mSectionOffsets[(u32)MapSection::Information]);
         }
 
-        return Section();
-    };
+        count = mScene->mNodeCount;
+        return mScene->mNodes;
+    }
 
-    void LevelGeometry::ReadSection(Section section) {
-        // Skip over already read sections (in the readfrombytes function)
-        switch (str2int(section.name.c_str())) {
-            case str2int("material_name_table"): return;
-            case str2int("vcd_table"): return;
+    const SceneMesh* LevelGeometry::GetMeshes(u32& count) {
+        // Meshes don't have a section of their own, the strips are found through the object tree and index into the VCD table
+        if (!IsRead(MapSection::VCDTable)) {
+            MarkRead(MapSection::VCDTable);
+
+            u32 nodeCount;
+            GetObjects(nodeCount);
+            Assert(HasSection(MapSection::VCDTable) || mMeshReferences.empty(), "Map has %zu meshes but no vcd_table", mMeshReferences.size());
+            if (HasSection(MapSection::VCDTable))
+                ReadVCDTable(mSectionOffsets[(u32)MapSection::VCDTable]);
+
+            // The object tree only records where its meshes are, they are decoded here in parallel.
+            // Each mesh goes into the slot its object already points at, so the order doesn't depend on the threads
+            mScene->mMeshCount = mMeshReferences.size();
+            mScene->mMeshes = arena_alloc_array<SceneMesh>(mScene->mArena, mMeshReferences.size());
+            parallel_for(mMeshReferences.size(), [&](u32 i) {
+                SceneMesh& mesh = mScene->mMeshes[i];
+                ReadMesh(mMeshReferences[i].offset, mesh);
+                mesh.mName = mMeshReferences[i].name;
+                mesh.mMaterialIndex = mMeshReferences[i].materialIndex;
+            });
+
+            // The dequantized arrays are only needed while decoding
+            std::vector<float>().swap(mPositions);
+            std::vector<float>().swap(mNormals);
+            std::vector<float>().swap(mUVs);
         }
 
-        LogInfo("---------- Reading Section %s (0x%x) ----------", section.name.c_str(), section.fileOffset);
-        switch (str2int(section.name.c_str()))
-        {
-            default:
-                LogWarn("----------- Section %s at offset 0x%x not implemented -----------", section.name.c_str(), section.fileOffset);
-                return;
-            case str2int("information"):
-                    break;
-            case str2int("texture_table"): {
-                    std::vector<std::string> textureNames = ReadTextureNames(section.fileOffset);
-                    // I swear to god if this ever happens
-                    Assert(sCurrentScene->mNumTextures >= textureNames.size(), "Trying to read more texture names than there are textures! \n\tTexture Name Count: 0x%x\n\tScene Texture Count: %u", textureNames.size(), sCurrentScene->mNumTextures);
-                    for (size_t i = 0; i < textureNames.size(); i++) {
-                        const auto texture = sCurrentScene->mTextures[i];
-                        sCurrentScene->mTextures[i]->mFilename = aiString(textureNames[i].c_str());
-                        std::string path = "Images/" + textureNames[i];
-                        filesystem_write_file(path.c_str(), (u8*)texture->pcData, (int)texture->mWidth);
-                    }
-                    break;
-                }
-            case str2int("light_table"):
-                LogInfo("Map has 0x%d lights", *(int*)(sData + section.fileOffset));
-                break;
-            case str2int("fog_table"):
-                ReadFogTable(section.fileOffset);
-                break;
-            case str2int("animation_table"):
-                ReadAnimationTable(section.fileOffset);
-                break;
-            case str2int("curve_table"):
-                ReadCurveTable(section.fileOffset);
-                break;
+        count = mScene->mMeshCount;
+        return mScene->mMeshes;
+    }
+
+    const SceneAnimation* LevelGeometry::GetAnimations(u32& count) {
+        if (!IsRead(MapSection::AnimationTable)) {
+            MarkRead(MapSection::AnimationTable);
+
+            // Channels are bound to their nodes while reading
+            u32 nodeCount;
+            GetObjects(nodeCount);
+            if (HasSection(MapSection::AnimationTable))
+                ReadAnimationTable(mSectionOffsets[(u32)MapSection::AnimationTable]);
         }
+
+        count = mScene->mAnimationCount;
+        return mScene->mAnimations;
+    }
+
+    const std::vector<FogEntry>& LevelGeometry::GetFog() {
+        if (!IsRead(MapSection::FogTable)) {
+            MarkRead(MapSection::FogTable);
+            if (HasSection(MapSection::FogTable))
+                ReadFogTable(mSectionOffsets[(u32)MapSection::FogTable]);
+        }
+
+        return mFog;
+    }
+
+    u32 LevelGeometry::GetLightCount() {
+        if (!HasSection(MapSection::LightTable))
+            return 0;
+
+        u32 lightCount = ByteSwap(*(u32*)(mData + mSectionOffsets[(u32)MapSection::LightTable]));
+        LogInfo("Map has %u lights", lightCount);
+        return lightCount;
+    }
+
+    void LevelGeometry::EncodeTexturesAsPNG(aiScene* scene) {
+        fpng::fpng_init();
+        parallel_for(scene->mNumTextures, [&](u32 i) {
+            aiTexture* texture = scene->mTextures[i];
+            if (texture->mHeight == 0)
+                return; // Already compressed
+
+            // aiTexels are BGRA, png wants RGBA
+            const u32 pixelCount = texture->mWidth * texture->mHeight;
+            std::vector<Color> pixels(pixelCount);
+            for (u32 p = 0; p < pixelCount; p++) {
+                const aiTexel& texel = texture->pcData[p];
+                pixels[p] = Color(texel.r, texel.g, texel.b, texel.a);
+            }
+
+            std::vector<u8> pngData;
+            fpng::fpng_encode_image_to_memory(pixels.data(), texture->mWidth, texture->mHeight, 4, pngData);
+
+            delete[] texture->pcData;
+            texture->pcData = new aiTexel[(pngData.size() + sizeof(aiTexel) - 1) / sizeof(aiTexel)];
+            memcpy(texture->pcData, pngData.data(), pngData.size());
+            texture->mWidth = pngData.size();
+            texture->mHeight = 0;
+            memcpy(texture->achFormatHint, "png\x0", 4);
+        });
     }
 
     std::vector<std::string> LevelGeometry::ReadTextureNames(int offset) {
-        int* textureTable = (int*)(sData + offset);
+        int* textureTable = (int*)(mData + offset);
         int imageCount = ByteSwap(textureTable[0]);
 
         std::vector<std::string> names(imageCount);
         for (int i = 0; i < imageCount; i++) {
-            names[i] = (char*)sData + ByteSwap(textureTable[i + 1]);
+            names[i] = (char*)mData + ByteSwap(textureTable[i + 1]);
         }
 
         return names;
     }
 
-    aiNode* LevelGeometry::ReadInfoSection(int offset, std::vector<aiMesh*>& meshes) {
+    void LevelGeometry::ReadInfoSection(int offset) {
         // Read the header
-        int* headerPtr = (int*)(sData + offset);
+        int* headerPtr = (int*)(mData + offset);
 
         // Doing it this way instead of just casting the pointer to an info header
         // because char* is 8 bytes long while the offsets in the header are only 4 bytes long
@@ -187,235 +405,241 @@ namespace SPMEditor {
         };
 
         LogInfo("----- Info Header -----");
-        LogInfo("File version:  %s", info.version.Get(sData));
-        LogInfo("Root Obj:      %s", info.rootObjName.Get(sData));
-        LogInfo("Root Trigger:  %s", info.rootColliderName.Get(sData));
-        LogInfo("Timestamp:     %s", info.timestamp.Get(sData));
+        LogInfo("File version:  %s", info.version.Get(mData));
+        LogInfo("Root Obj:      %s", info.rootObjName.Get(mData));
+        LogInfo("Root Trigger:  %s", info.rootColliderName.Get(mData));
+        LogInfo("Timestamp:     %s", info.timestamp.Get(mData));
 
         LogInfo("----- Reading Objects -----");
         int siblingOffset;
-        aiNode* rootObject = ReadObject(info.objHeirarchyOffset, siblingOffset, meshes);
+        ReadObject(info.objHeirarchyOffset, -1, siblingOffset);
+
+        // The tree is complete, so it can move into the arena in one piece
+        mScene->mNodeCount = mNodes.size();
+        mScene->mNodes = arena_alloc_array<SceneNode>(mScene->mArena, mNodes.size());
+        memcpy(mScene->mNodes, mNodes.data(), mNodes.size() * sizeof(SceneNode));
 
-        LogInfo("----- Object Count %d -----", objectCount);
-        return rootObject;
+        mScene->mNodeMeshCount = mNodeMeshes.size();
+        mScene->mNodeMeshes = arena_alloc_array<u32>(mScene->mArena, mNodeMeshes.size());
+        memcpy(mScene->mNodeMeshes, mNodeMeshes.data(), mNodeMeshes.size() * sizeof(u32));
+
+        mScene->BuildNodeIndex();
+
+        LogInfo("----- Object Count %d -----", mObjectCount);
     }
 
-    aiNode* LevelGeometry::ReadObject(int objectOffset, int& nextSibling, std::vector<aiMesh*>& meshes, std::string indent) {
-        objectCount++;
+    s32 LevelGeometry::ReadObject(int objectOffset, s32 parent, int& nextSibling, std::string indent) {
+        mObjectCount++;
         // Read raw object data
-        Object objectData = *(Object*)(sData + objectOffset);
+        Object objectData = *(Object*)(mData + objectOffset);
         ByteSwap((int*)&objectData, sizeof(Object) / sizeof(int));
         Assert(objectData.padding == 0, "Object data is not padding. Expected 0, got 0x%x", objectData.padding);
 
         // Create new object
-        aiNode* object = new aiNode();
-        object->mName = aiString((char*)sData + objectData.name);
-
-        // Copy the name
-        std::string name = (char*)(sData + objectData.name);
-        object->mName = new char[name.size()];
-        object->mName.Set(name.c_str());
-
-        std::string type = (char*)(sData + objectData.type);
+        const char* name = arena_copy_string(mScene->mArena, (char*)(mData + objectData.name));
+        std::string type = (char*)(mData + objectData.type);
 
-        // Unfortunately the position is wonky so I need to do this
-        Vector3 position = objectData.position;
+        SceneNode node = {};
+        node.mName = name;
+        node.mNameHash = hash_bytes(name, strlen(name));
+        node.mParent = parent;
+        node.mFirstChild = -1;
+        node.mNextSibling = -1;
 
-        // Set the object transform
-        object->mTransformation = aiMatrix4x4(objectData.scale, aiQuaternion(objectData.rotation.y / 180 * std::numbers::pi, objectData.rotation.z / 180 * std::numbers::pi, objectData.rotation.x / 180 * std::numbers::pi), position);
+        // Set the object transform, the file stores the rotation in degrees
+        node.mPosition = objectData.position;
+        node.mRotation = Vector3(objectData.rotation.x / 180 * std::numbers::pi, objectData.rotation.y / 180 * std::numbers::pi, objectData.rotation.z / 180 * std::numbers::pi);
+        node.mScale = objectData.scale;
 
         // Try reading the meshes
-        object->mMeshes = new u32[objectData.meshCount];
-        object->mNumMeshes = objectData.meshCount;
+        node.mFirstMesh = mNodeMeshes.size();
+        node.mMeshCount = objectData.meshCount;
 
-        LogInfo("%sObject '%s'", indent.c_str(), name.c_str());
+        LogInfo("%sObject '%s'", indent.c_str(), name);
         LogInfo("\t%sType: %s, Offset: 0x%x, Mesh Count: %d", indent.c_str(), type.c_str(), objectOffset, objectData.meshCount);
         for (int i = 0; i < objectData.meshCount; i++) {
             // Read the material offset
             // Fun story, these two lines killed a days worth of bug fixing (~10 hours)
             // I forgot to add the i * 8 (read each mesh / material pair) so it was just reading 2 of the same meshes
             // and this made it so a lot of the objects were just missing. Man I hate programming sometimes
-            int materialOffset = ByteSwap(*(int*)(sData + objectOffset + i * 8+ sizeof(Object)));
-            int meshOffset = ByteSwap(*(int*)(sData + objectOffset + i * 8 + sizeof(Object) + 4));
+            int materialOffset = ByteSwap(*(int*)(mData + objectOffset + i * 8+ sizeof(Object)));
+            int meshOffset = ByteSwap(*(int*)(mData + objectOffset + i * 8 + sizeof(Object) + 4));
 
 
-            // Actually do the reading
-            aiMesh* mesh = ReadMesh(meshOffset);
-            mesh->mName = object->mName;
-            u32 materialIndex = (materialOffset - s_FirstMaterialAddress) / sizeof(Material);
-
-            mesh->mMaterialIndex = materialIndex;
-            object->mMeshes[i] = meshes.size();
+            u32 materialIndex = (materialOffset - mFirstMaterialAddress) / sizeof(Material);
 
             // Add the mesh to the list
-            // because the object only references the index of the mesh
-            meshes.push_back(mesh);
+            // because the object only references the index of the mesh.
+            // Objects that place the same mesh with the same material share one scene mesh
+            u64 key = (u64)(u32)meshOffset << 32 | materialIndex;
+            auto [entry, inserted] = mMeshIndices.try_emplace(key, (u32)mMeshReferences.size());
+            if (inserted)
+                mMeshReferences.push_back({ meshOffset, materialIndex, name });
+            mNodeMeshes.push_back(entry->second);
         }
 
-
-        // Read all the children
+        s32 index = mNodes.size();
+        mNodes.push_back(node);
 
         // Read all the children
         // This works a bit weird because the sibling of the child object is another child object
         // so when there are no siblings remaining (nullptr) the loop stops since nextChild == 0
         int nextChild = objectData.child;
-        std::vector<aiNode*> children;
+        s32 previousChild = -1;
         while (nextChild)
         {
-            aiNode* childObject = ReadObject(nextChild, nextChild, meshes, indent + '\t');
-            childObject->mParent = object;
-            children.push_back(childObject);
-        }
-
-        object->mChildren = nullptr;
-        if (children.size() > 0)
-        {
-            object->addChildren(children.size(), children.data());
+            // Children are read after their parent, so parents always come first in the node array
+            s32 child = ReadObject(nextChild, index, nextChild, indent + '\t');
+            if (previousChild == -1)
+                mNodes[index].mFirstChild = child;
+            else
+                mNodes[previousChild].mNextSibling = child;
+            previousChild = child;
         }
 
         nextSibling = objectData.nextSibling;
 
-        return object;
+        return index;
     }
 
-    aiMesh* LevelGeometry::ReadMesh(int offset) {
-        MeshHeader header = *(MeshHeader*)(sData + offset);
+    void LevelGeometry::ReadMesh(int offset, SceneMesh& mesh) {
+        MeshHeader header = *(MeshHeader*)(mData + offset);
         ByteSwap4(&header, 4);
 
         Assert(header.constant == 0x1000001, "Mesh header constant is not constant. Expected 0x1000001, got 0x%x", header.constant);
 
-        aiMesh* mesh = new aiMesh();
-
         // Read each triangle entry
-        VertexStrip::Header * stripHeaders = (VertexStrip::Header*)(sData + offset + sizeof(MeshHeader));
+        VertexStrip::Header * stripHeaders = (VertexStrip::Header*)(mData + offset + sizeof(MeshHeader));
         std::vector<Vertex> vertices;
         std::vector<int> indices;
+        std::unordered_map<u64, int> vertexLookup;
+        LogInfo("Reading %d vertex strips with attributes 0x%x", header.entryCount, (u32)header.vertexAttributes);
         for (int i = 0; i < header.entryCount; i++) {
             VertexStrip::Header vertexStrip = stripHeaders[i];
             ByteSwap((int*)&vertexStrip, 2);
-            LogInfo("Reading vertex strip with attributes 0x%x", (u32)header.vertexAttributes);
-            ReadVertices(s_VCDTable, vertexStrip.entryOffset, header.vertexAttributes, vertices, indices);
+            ReadVertices(vertexStrip.entryOffset, header.vertexAttributes, vertices, indices, vertexLookup);
         }
 
-
-        // Write to vertex buffer
+        // Split the vertices into one array per attribute
         // Technically ignores vertex attributes but thats a future me problem
-        mesh->mNumVertices = vertices.size();
-        mesh->mVertices = new aiVector3t<float>[vertices.size()];
-
-        mesh->mNumUVComponents[0] = 2;
-        mesh->mTextureCoords[0] = new aiVector3D[ vertices.size() ];
-
-        mesh->mNormals = new aiVector3t<float>[vertices.size()];
-
-        if ((header.vertexAttributes & VERTEX_ATTRIBUTE_COLOR) != 0)  {
-            mesh->mColors[0] = new aiColor4D[vertices.size()];
-        }
+        Arena* arena = mScene->mArena;
+        mesh.mVertexCount = vertices.size();
+        mesh.mPositions = arena_alloc_array<Vector3>(arena, vertices.size());
+        mesh.mNormals = arena_alloc_array<Vector3>(arena, vertices.size());
+        mesh.mUVs = arena_alloc_array<Vector2>(arena, vertices.size());
+        if ((header.vertexAttributes & VERTEX_ATTRIBUTE_COLOR) != 0)
+            mesh.mColors = arena_alloc_array<Color>(arena, vertices.size());
 
         for (size_t i = 0; i < vertices.size(); i++) {
-            mesh->mVertices[i] = vertices[i].position;
-            mesh->mNormals[i] = vertices[i].normal;
-            mesh->mNormals[i] = -mesh->mNormals[i].Normalize();
-            mesh->mTextureCoords[0][i] = aiVector3D(vertices[i].uv.x, vertices[i].uv.y, 0);
+            mesh.mPositions[i] = vertices[i].position;
+            mesh.mUVs[i] = vertices[i].uv;
 
-            if ((header.vertexAttributes & VERTEX_ATTRIBUTE_COLOR) != 0) {
-                mesh->mColors[0][i] = aiColor4D((float)vertices[i].color.r / 255, (float)vertices[i].color.g / 255, (float)vertices[i].color.b / 255, (float)vertices[i].color.a / 255);
-            }
-        }
-
-        mesh->mNumFaces = indices.size() / 3;
-        mesh->mFaces = new aiFace[ mesh->mNumFaces ];
-
-        for (uint i = 0; i < mesh->mNumFaces; i++) {
-            aiFace& face = mesh->mFaces[i];
+            // Normals point inwards in the file
+            const Vector3& normal = vertices[i].normal;
+            float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+            if (length > 0)
+                mesh.mNormals[i] = Vector3(-normal.x / length, -normal.y / length, -normal.z / length);
 
-            face.mNumIndices = 3;
-            face.mIndices = new unsigned int[3];
-
-            face.mIndices[0] = indices[i * 3 + 0];
-            face.mIndices[1] = indices[i * 3 + 1];
-            face.mIndices[2] = indices[i * 3 + 2];
+            if (mesh.mColors)
+                mesh.mColors[i] = vertices[i].color;
         }
 
-        return mesh;
+        mesh.mIndexCount = indices.size();
+        mesh.mIndices = arena_alloc_array<u32>(arena, indices.size());
+        memcpy(mesh.mIndices, indices.data(), indices.size() * sizeof(u32));
     }
 
-    void LevelGeometry::ReadVertices(VCDTable vcd, int offset, VertexAttributes attributes, std::vector<Vertex>& vertices, std::vector<int>& indices) {
+    void LevelGeometry::ReadVertices(int offset, VertexAttributes attributes, std::vector<Vertex>& vertices, std::vector<int>& indices, std::unordered_map<u64, int>& vertexLookup) {
         // Vertex UV and position scale factor has to do with float dequantization (pqx_lx instruction)
         // This happens at 0x8006d74c in the binary
-        VertexStrip header = *(VertexStrip*)(sData + offset);
+        VertexStrip header = *(VertexStrip*)(mData + offset);
         header.vertexCount = ByteSwap(header.vertexCount);
 
-        u16* vertexData = (u16*)(sData + offset + 3);
+        u16* vertexData = (u16*)(mData + offset + 3);
+        int previous[2] = {};
         for (uint i = 0; i < header.vertexCount; i++) {
-            Vertex vertex;
+            u16 positionIndex = 0;
+            u16 normalIndex = 0;
+            u16 colorIndex = 0;
+            u16 uvIndex = 0;
             if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_POSITION) != 0)
-            {
-                u16 vertexIndex = ByteSwap(*vertexData++);
-                vec3<short> rawVertex = vcd.vertices.Get(sData)[vertexIndex];
-                ByteSwap2(&rawVertex, 3);
-
-                int scaleFactor = vcd.vertexScale;
-                vertex.position = Vector3((float)rawVertex.x / scaleFactor, (float)rawVertex.y / scaleFactor, (float)rawVertex.z / scaleFactor);
-            }
+                positionIndex = ByteSwap(*vertexData++);
             if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_NORMAL) != 0)
-            {
-                int index = ByteSwap(*vertexData++);
-                vec3<s8> normal = vcd.normals.Get(sData)[index];
-                vertex.normal.x = (float)(normal.x) / 0x40;
-                vertex.normal.y = (float)(normal.y) / 0x40;
-                vertex.normal.z = (float)(normal.z) / 0x40;
-            }
+                normalIndex = ByteSwap(*vertexData++);
             if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_COLOR) != 0)
-            {
-                u16 colorIndex = ByteSwap(*vertexData);
-
-                vertex.color = vcd.colors.Get(sData)[colorIndex];
-                vertexData++;
-            }
-            if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UNK_1) != 0) {
+                colorIndex = ByteSwap(*vertexData++);
+            if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UNK_1) != 0)
                 vertexData++;
-            }
-            if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UV) != 0) {
-                int uvIndex = ByteSwap(*vertexData++);
-                vec2<s16> rawUv = vcd.uvs.Get(sData)[uvIndex];
-                ByteSwap2(&rawUv, 2);
-
-                int uvScale = vcd.uvScale;
-                Vector2 uv = Vector2((float)(short)rawUv.x / uvScale, 1.0f - (float)(short)rawUv.y / uvScale);
-                vertex.uv = uv;
-            }
-            if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UNK_2) != 0) {
+            if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UV) != 0)
+                uvIndex = ByteSwap(*vertexData++);
+            if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UNK_2) != 0)
                 vertexData++;
-            }
 
-            if (i >= 2) {
-                int indexOffset = vertices.size() - 2;
-                int a = indexOffset + 0;
-                int b = indexOffset + 1;
-                int c = indexOffset + 2;
-                if (i % 2 != 0) {
-                    // Front
-                    indices.emplace_back(c);
-                    indices.emplace_back(b);
-                    indices.emplace_back(a);
-                } else {
-                    // Back
-                    indices.emplace_back(a);
-                    indices.emplace_back(b);
-                    indices.emplace_back(c);
+            // Strips share most of their vertices with each other, so every unique set of indices becomes one vertex.
+            // The attributes are the same for the whole mesh, so unused indices being 0 can't make two sets collide
+            u64 key = (u64)positionIndex | (u64)normalIndex << 16 | (u64)colorIndex << 32 | (u64)uvIndex << 48;
+            auto [entry, inserted] = vertexLookup.try_emplace(key, (int)vertices.size());
+            if (inserted) {
+                Vertex vertex = {};
+                if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_POSITION) != 0)
+                {
+                    Assert(positionIndex < mPositions.size() / 3, "Vertex position index %u is outside of the VCD table (%zu positions)", positionIndex, mPositions.size() / 3);
+                    const float* position = &mPositions[positionIndex * 3];
+                    vertex.position = Vector3(position[0], position[1], position[2]);
+                }
+                if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_NORMAL) != 0)
+                {
+                    Assert(normalIndex < mNormals.size() / 3, "Vertex normal index %u is outside of the VCD table (%zu normals)", normalIndex, mNormals.size() / 3);
+                    const float* normal = &mNormals[normalIndex * 3];
+                    vertex.normal = Vector3(normal[0], normal[1], normal[2]);
+                }
+                if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_COLOR) != 0)
+                {
+                    vertex.color = mVCDTable.colors.Get(mData)[colorIndex];
                 }
+                if (((u32)attributes & (u32)VertexAttributes::VERTEX_ATTRIBUTE_UV) != 0) {
+                    Assert(uvIndex < mUVs.size() / 2, "Vertex uv index %u is outside of the VCD table (%zu uvs)", uvIndex, mUVs.size() / 2);
+                    vertex.uv = Vector2(mUVs[uvIndex * 2], mUVs[uvIndex * 2 + 1]);
+                }
+
+                vertices.push_back(vertex);
             }
 
-            vertices.push_back(vertex);
+            int a = previous[0];
+            int b = previous[1];
+            int c = entry->second;
+            previous[0] = b;
+            previous[1] = c;
+
+            // Triangles that reuse a vertex have no area
+            if (i < 2 || a == b || b == c || a == c)
+                continue;
+
+            if (i % 2 != 0) {
+                // Front
+                indices.emplace_back(c);
+                indices.emplace_back(b);
+                indices.emplace_back(a);
+            } else {
+                // Back
+                indices.emplace_back(a);
+                indices.emplace_back(b);
+                indices.emplace_back(c);
+            }
         }
     }
 
-    VCDTable LevelGeometry::ReadVCDTable(int offset) {
+    void LevelGeometry::ReadVCDTable(int offset) {
         LogInfo("----- Reading VCD Table -----");
-        VCDTable table = *(VCDTable*)(sData + offset);
+        VCDTable table = *(VCDTable*)(mData + offset);
         ByteSwap4(&table, sizeof(VCDTable) / 4);
 
+        // Each array starts with its element count, missing arrays have a null address
+        auto readCount = [&](u32 address) { return address != 0 ? ByteSwap(*(u32*)(mData + address)) : 0u; };
+        u32 positionCount = readCount(table.vertices.address);
+        u32 normalCount = readCount(table.normals.address);
+        u32 uvCount = readCount(table.uvs.address);
+
         // NOTE:: Adding 4 to the addresses to skip count
         table.normals.address += 4;
         table.vertices.address += 4;
@@ -425,19 +649,35 @@ namespace SPMEditor {
         // NOTE:: Converting scales to their real value
         table.vertexScale = 1 << table.vertexScale;
         table.uvScale = 1 << table.uvScale;
+        mVCDTable = table;
 
-        return table;
+        // Strips index the arrays many times over, so every entry is converted to floats once here.
+        // The scales are powers of two, so multiplying by their inverse gives exactly the same values as dividing
+        mPositions.resize(positionCount * 3);
+        GetS16Dequantizer()(mData + table.vertices.address, positionCount * 3, 1.0f / table.vertexScale, mPositions.data());
+
+        mNormals.resize(normalCount * 3);
+        GetS8Dequantizer()(mData + table.normals.address, normalCount * 3, 1.0f / 0x40, mNormals.data());
+
+        // V is stored flipped
+        mUVs.resize(uvCount * 2);
+        GetS16Dequantizer()(mData + table.uvs.address, uvCount * 2, 1.0f / table.uvScale, mUVs.data());
+        for (u32 i = 0; i < uvCount; i++) {
+            mUVs[i * 2 + 1] = 1.0f - mUVs[i * 2 + 1];
+        }
+
+        LogInfo("VCD table has %u positions, %u normals and %u uvs", positionCount, normalCount, uvCount);
     }
 
     void LevelGeometry::ReadFogTable(int tableOffset) {
-        u32 fogCount = ByteSwap(*(u32*)(sData + tableOffset));
+        u32 fogCount = ByteSwap(*(u32*)(mData + tableOffset));
         Assert(fogCount <= 1, "Unable to read fog table. Too many / few entries: %u", fogCount);
         if (fogCount <= 0)
             return;
 
-        FogEntry fog = *(FogEntry*)(sData + tableOffset + 8);
+        FogEntry fog = *(FogEntry*)(mData + tableOffset + 8);
         ByteSwap4(&fog, 2);
-        s_CurrentLevel->fogSettings.emplace_back(fog);
+        mFog.emplace_back(fog);
 
         LogInfo("Fog near plane:        %f", fog.start); 
         LogInfo("Fog far plane:         %f", fog.end); 
@@ -445,23 +685,22 @@ namespace SPMEditor {
     }
 
     void LevelGeometry::ReadAnimationTable(int tableOffset) {
-        uint animationCount = ByteSwap(*(uint*)(sData + tableOffset));
-        uint* headers = (uint*)(sData + tableOffset + 4);
+        uint animationCount = ByteSwap(*(uint*)(mData + tableOffset));
+        uint* headers = (uint*)(mData + tableOffset + 4);
 
-        sCurrentScene->mNumAnimations = animationCount;
-        sCurrentScene->mAnimations = new aiAnimation*[animationCount];
+        mScene->mAnimationCount = animationCount;
+        mScene->mAnimations = arena_alloc_array<SceneAnimation>(mScene->mArena, animationCount);
 
         for (uint i = 0; i < animationCount; i++) {
-            const AnimationHeader* header = (AnimationHeader*)(sData + ByteSwap(headers[i]));
+            const AnimationHeader* header = (AnimationHeader*)(mData + ByteSwap(headers[i]));
 
-            sCurrentScene->mAnimations[i] = new aiAnimation();
-            aiAnimation* animation = sCurrentScene->mAnimations[i];
-            animation->mName = (char*)sData + ByteSwap((int)header->nameOffset);
-            animation->mDuration = ByteSwap(header->frameCount);
-            animation->mTicksPerSecond = 25;
+            SceneAnimation& animation = mScene->mAnimations[i];
+            animation.mName = arena_copy_string(mScene->mArena, (char*)mData + ByteSwap((int)header->nameOffset));
+            animation.mDuration = ByteSwap(header->frameCount);
+            animation.mFramesPerSecond = 25;
 
-            LogTrace("Reading animation '%s' (0x%x) with %d frames.", animation->mName.C_Str(), ByteSwap(headers[i]), animation->mDuration);
-            Assert(header->constant == 0, "Animation '%s' (Index: %d) header constant is not constant. Expected 0, got 0x%x", animation->mName.C_Str(), i, header->constant);
+            LogTrace("Reading animation '%s' (0x%x) with %f frames.", animation.mName, ByteSwap(headers[i]), animation.mDuration);
+            Assert(header->constant == 0, "Animation '%s' (Index: %d) header constant is not constant. Expected 0, got 0x%x", animation.mName, i, header->constant);
 
             if (header->transformAnimationOffset)
                 ReadTransformAnimation(ByteSwap(header->transformAnimationOffset), animation);
@@ -474,42 +713,27 @@ namespace SPMEditor {
         }
     }
 
-    aiMatrix4x4 GetGlobalMatrix(aiNode* node) {
-        aiVector3D nodeScale, nodePosition, nodeRotation;
-        node->mTransformation.Decompose(nodeScale, nodeRotation, nodePosition);
-        if (node->mParent) {
-            return GetGlobalMatrix(node->mParent) * node->mTransformation;
-        }
-
-        return node->mTransformation;
-    }
-
-    void LevelGeometry::ReadTransformAnimation(int offset, aiAnimation* animation) {
-        uint channelCount = ByteSwap(*(u32*)(sData + offset));
-        animation->mNumChannels = channelCount;
-        animation->mChannels = new aiNodeAnim*[channelCount];
+    void LevelGeometry::ReadTransformAnimation(int offset, SceneAnimation& animation) {
+        uint channelCount = ByteSwap(*(u32*)(mData + offset));
+        animation.mChannelCount = channelCount;
+        animation.mChannels = arena_alloc_array<SceneAnimationChannel>(mScene->mArena, channelCount);
 
         LogTrace("Reading transform animation (0x%x)", offset);
         for (uint i = 0; i < channelCount; i++) {
-            int animPointer = ByteSwap(*(int*)(sData + offset + 4 + i * 4));
-            TransformAnimation internalAnimation = *(TransformAnimation*)(sData + animPointer);
+            int animPointer = ByteSwap(*(int*)(mData + offset + 4 + i * 4));
+            TransformAnimation internalAnimation = *(TransformAnimation*)(mData + animPointer);
             ByteSwap4(&internalAnimation, sizeof(TransformAnimation) / 4);
 
-            Assert(internalAnimation.keyframeCount > 0, "Animation '%s' has no keyframes", (char*)sData + internalAnimation.nameOffset);
+            const char* nodeName = (char*)mData + internalAnimation.nameOffset;
+            Assert(internalAnimation.keyframeCount > 0, "Animation '%s' has no keyframes", nodeName);
 
-            aiNodeAnim* channel = new aiNodeAnim();
-            animation->mChannels[i] = channel;
+            SceneAnimationChannel& channel = animation.mChannels[i];
+            channel.mNode = mScene->FindNode(nodeName);
+            Assert(channel.mNode != -1, "Failed to find node '%s'", nodeName);
+            channel.mKeyframeCount = internalAnimation.keyframeCount;
+            channel.mKeyframes = arena_alloc_array<SceneKeyframe>(mScene->mArena, internalAnimation.keyframeCount);
 
-            channel->mNodeName = (char*)sData + internalAnimation.nameOffset;
-            channel->mNumPositionKeys   = internalAnimation.keyframeCount;
-            channel->mNumScalingKeys    = internalAnimation.keyframeCount;
-            channel->mNumRotationKeys   = internalAnimation.keyframeCount;
-
-            channel->mPositionKeys = new aiVectorKey[internalAnimation.keyframeCount];
-            channel->mScalingKeys  = new aiVectorKey[internalAnimation.keyframeCount];
-            channel->mRotationKeys = new aiQuatKey[internalAnimation.keyframeCount];
-
-            LogDebug("\tObject '%s' has %d frames (0x%x). Base Position: (%f, %f, %f), Base Rotation: (%f, %f, %f), Base Scale: (%f, %f, %f)", channel->mNodeName.C_Str(), internalAnimation.keyframeCount, animPointer,
+            LogDebug("\tObject '%s' has %d frames (0x%x). Base Position: (%f, %f, %f), Base Rotation: (%f, %f, %f), Base Scale: (%f, %f, %f)", nodeName, internalAnimation.keyframeCount, animPointer,
                     internalAnimation.basePosition.x,
                     internalAnimation.basePosition.y,
                     internalAnimation.basePosition.z,
@@ -520,57 +744,51 @@ namespace SPMEditor {
                     internalAnimation.baseScale.y,
                     internalAnimation.baseScale.z
                     );
-            TransformAnimation::Keyframe* keyframes = (TransformAnimation::Keyframe*)(sData + animPointer + sizeof(TransformAnimation));
-            aiNode* node = sCurrentScene->mRootNode->FindNode(channel->mNodeName);
-            Assert(node != nullptr, "Failed to find node '%s'", channel->mNodeName.C_Str());
-            aiVector3D nodeScale, nodePosition, nodeRotation;
-            node->mTransformation.Decompose(nodeScale, nodeRotation, nodePosition);
-            LogDebug("\tPosition: (%f, %f, %f), Rotation: (%f, %f, %f), Scale: (%f, %f, %f)", nodePosition.x, nodePosition.y, nodePosition.z, nodeRotation.x, nodeRotation.y, nodeRotation.z, nodeScale.x, nodeScale.y, nodeScale.z);
+            TransformAnimation::Keyframe* keyframes = (TransformAnimation::Keyframe*)(mData + animPointer + sizeof(TransformAnimation));
+            const SceneNode& node = mScene->mNodes[channel.mNode];
+            Vector3 nodePosition = node.mPosition;
+            LogDebug("\tPosition: (%f, %f, %f), Rotation: (%f, %f, %f), Scale: (%f, %f, %f)", nodePosition.x, nodePosition.y, nodePosition.z, node.mRotation.x, node.mRotation.y, node.mRotation.z, node.mScale.x, node.mScale.y, node.mScale.z);
 
             TransformAnimation::Keyframe startingKey = keyframes[0];
             ByteSwap4(&startingKey, sizeof(TransformAnimation::Keyframe) / 4);
-            aiVector3D startingPosition(startingKey.position.x.start, startingKey.position.y.start, startingKey.position.z.start);
+            Vector3 startingPosition(startingKey.position.x.start, startingKey.position.y.start, startingKey.position.z.start);
 
             for (u32 key = 0; key < internalAnimation.keyframeCount; key++) {
                 TransformAnimation::Keyframe keyframe = keyframes[key];
                 ByteSwap4(&keyframe, sizeof(TransformAnimation::Keyframe) / 4);
 
-                constexpr double PI = glm::pi<double>();
-                aiVector3D pos = aiVector3D(keyframe.position.x.start, keyframe.position.y.start, keyframe.position.z.start);// - aiVector3D(internalAnimation->basePosition.x, internalAnimation->basePosition.y, internalAnimation->basePosition.z);
-                aiVector3D scale = aiVector3D(keyframe.scale.x.start, keyframe.scale.y.start, keyframe.scale.z.start);
-                aiVector3D euler = aiVector3D(keyframe.rotation.x.start, keyframe.rotation.y.start, keyframe.rotation.z.start); 
+                constexpr float PI = std::numbers::pi_v<float>;
+                Vector3 pos = Vector3(keyframe.position.x.start, keyframe.position.y.start, keyframe.position.z.start);
+                Vector3 scale = Vector3(keyframe.scale.x.start, keyframe.scale.y.start, keyframe.scale.z.start);
+                Vector3 euler = Vector3(keyframe.rotation.x.start, keyframe.rotation.y.start, keyframe.rotation.z.start);
 
                 LogDebug("\t\tKeyframe %d. Time: %f, Local Position: (%f, %f, %f) Local Rotation: (%f, %f, %f), Local Scale: (%f, %f, %f)", key, keyframe.startFrame, 
                         pos.x, pos.y, pos.z,
                         euler.x, euler.y, euler.z,
                         scale.x, scale.y, scale.z);
 
-                pos = pos - startingPosition + nodePosition;
-                euler /= 180.0f;
-                euler *= PI;
+                // Keys are relative to the first one, placed on top of the node's own position
+                pos = Vector3(pos.x - startingPosition.x + nodePosition.x, pos.y - startingPosition.y + nodePosition.y, pos.z - startingPosition.z + nodePosition.z);
+                euler = Vector3(euler.x / 180.0f * PI, euler.y / 180.0f * PI, euler.z / 180.0f * PI);
 
                 LogDebug("\t\t\t\t\t\tPosition: (%f, %f, %f) Rotation: (%f, %f, %f), Scale: (%f, %f, %f)", 
                         pos.x, pos.y, pos.z,
                         euler.x, euler.y, euler.z,
                         scale.x, scale.y, scale.z);
 
-                channel->mPositionKeys[key] = aiVectorKey(keyframe.startFrame, pos);
-                channel->mScalingKeys[key]  = aiVectorKey(keyframe.startFrame, scale);
-                channel->mRotationKeys[key] = aiQuatKey(keyframe.startFrame, aiQuaternion(euler.y, euler.z, euler.x));
+                channel.mKeyframes[key] = { keyframe.startFrame, pos, euler, scale };
             }
-
-            Assert(animation->mChannels[i]->mNumPositionKeys == internalAnimation.keyframeCount, "Animatoin keyframe count does not match number of keyframes");
         }
     }
 
     void LevelGeometry::ReadTextureAnimation(int offset) { 
-        uint objectCount = ByteSwap(*(u32*)(sData + offset));
+        uint objectCount = ByteSwap(*(u32*)(mData + offset));
 
         std::vector<MaterialAnimation> animations;
         for (uint i = 0; i < objectCount; i++) {
-            int animationOffset = ByteSwap(*(u32*)(sData + offset + 4 + 4 * i));
-            InternalMaterialAnimation* textureAnimation = (InternalMaterialAnimation*)(sData + animationOffset);
-            InternalMaterialAnimation::Keyframe* keyframes = (InternalMaterialAnimation::Keyframe*)(sData + animationOffset + sizeof(InternalMaterialAnimation));
+            int animationOffset = ByteSwap(*(u32*)(mData + offset + 4 + 4 * i));
+            InternalMaterialAnimation* textureAnimation = (InternalMaterialAnimation*)(mData + animationOffset);
+            InternalMaterialAnimation::Keyframe* keyframes = (InternalMaterialAnimation::Keyframe*)(mData + animationOffset + sizeof(InternalMaterialAnimation));
 
             MaterialAnimation animation;
             animation.animationName = ByteSwap(textureAnimation->materialNameOffset);
@@ -592,7 +810,7 @@ namespace SPMEditor {
                 ByteSwap4(animation.keyframes.data(), sizeof(InternalMaterialAnimation::Keyframe) / 4);
             animations.emplace_back(animation);
 
-            LogInfo("Found Material Animation %s (0x%x)", animation.animationName.Get(sData), animationOffset);
+            LogInfo("Found Material Animation %s (0x%x)", animation.animationName.Get(mData), animationOffset);
             LogInfo("\tUnknown 0: %f", animation.unknown[0]);
             LogInfo("\tUnknown 1: %f", animation.unknown[1]);
             LogInfo("\tUnknown 2: %f", animation.unknown[2]);
@@ -600,31 +818,29 @@ namespace SPMEditor {
         }
     }
 
-    void LevelGeometry::ReadMaterialNameTable(int tableOffset, int textureCount) {
-        u32 materialCount = ByteSwap(*(u32*)(sData + tableOffset));
+    void LevelGeometry::ReadMaterialNameTable(int tableOffset) {
+        u32 materialCount = ByteSwap(*(u32*)(mData + tableOffset));
         LogInfo("----- Reading Material Name Table -----");
         LogInfo("Material Count: 0x%x", materialCount);
-        MaterialNameEntry* entries = (MaterialNameEntry*)(sData + tableOffset + 4);
-
-        if (materialCount > 0)
-            s_FirstMaterialAddress = ByteSwap(entries[0].materialOffset);
+        const MaterialNameEntry* entries = (const MaterialNameEntry*)(mData + tableOffset + 4);
 
-        sCurrentScene->mNumMaterials = materialCount;
-        sCurrentScene->mMaterials = new aiMaterial*[materialCount];
+        mScene->mMaterialCount = materialCount;
+        mScene->mMaterials = arena_alloc_array<SceneMaterial>(mScene->mArena, materialCount);
 
         for (u32 i = 0; i < materialCount; i++) {
-            // Read entry and material
-            ByteSwap4(&entries[i], 2);
-            Material material = *(Material*)(sData + entries[i].materialOffset);
+            // Read entry and material, swapped as copies so the file data is left untouched
+            MaterialNameEntry entry = entries[i];
+            ByteSwap4(&entry, 2);
+            Material material = *(Material*)(mData + entry.materialOffset);
             ByteSwap4(&material, 1); // Yay for funky data type
             ByteSwap4(((char*)&material + 0xc), 0x42); // Yay for funky data type
 
             // get the name
-            aiString* name = new aiString((char*)(sData + entries[i].nameOffset));
-            aiMaterial* mat = new aiMaterial();
-            mat->AddProperty(name, AI_MATKEY_NAME);
+            SceneMaterial& sceneMaterial = mScene->mMaterials[i];
+            sceneMaterial.mName = arena_copy_string(mScene->mArena, (char*)(mData + entry.nameOffset));
+            sceneMaterial.mColor = material.color;
 
-            LogInfo("Material: '%s'", name->C_Str());
+            LogInfo("Material: '%s'", sceneMaterial.mName);
             LogInfo("\tUse Color: (%x, %x, %x, %x), Use Vertex Color: %x, Unk 1: %x, Use Transparency: %x, Use Texture: %x, Texture Info Ptr: 0x%x",
                     material.color.r, material.color.g, material.color.b, material.color.a, material.useVertexColor, material.unk_1, material.useTransparency, material.useTexture, material.textureInfoPtr);
 
@@ -635,29 +851,21 @@ namespace SPMEditor {
             // then the pointer that the material rerences
             if (material.textureInfoPtr != 0)
             {
-                MapTexture::Info textureInfo = *(MapTexture::Info*)(sData + material.textureInfoPtr);
+                MapTexture::Info textureInfo = *(MapTexture::Info*)(mData + material.textureInfoPtr);
                 ByteSwap4(&textureInfo, 2); // Just the first 2 ints
-                MapTexture mapTexture = *(MapTexture*)(sData + textureInfo.dataOffset);
+                MapTexture mapTexture = *(MapTexture*)(mData + textureInfo.dataOffset);
                 mapTexture.nameOffset = ByteSwap(mapTexture.nameOffset);
                 mapTexture.width = ByteSwap(mapTexture.width);
                 mapTexture.height = ByteSwap(mapTexture.height);
 
-                aiString* textureName = new aiString((char*)(sData + mapTexture.nameOffset));
-
-                mat->AddProperty(textureName, AI_MATKEY_TEXTURE_DIFFUSE(0));
-                LogInfo("\tReferences texture '%s'", textureName->C_Str());
+                sceneMaterial.mTextureName = arena_copy_string(mScene->mArena, (char*)(mData + mapTexture.nameOffset));
+                LogInfo("\tReferences texture '%s'", sceneMaterial.mTextureName);
             }
-
-            aiColor4D color = aiColor4D((float)material.color.r / 255, (float)material.color.g / 255, (float)material.color.b / 255, (float)material.color.a / 255);
-            mat->AddProperty(&color, 4, AI_MATKEY_BASE_COLOR);
-            mat->AddProperty(&color, 4, AI_MATKEY_COLOR_DIFFUSE);
-
-            sCurrentScene->mMaterials[i] = mat;
         }
     }
 
     void LevelGeometry::ReadCurveTable(int offset) {
-        int curveCount = *(int*)(sData + offset);
+        int curveCount = *(int*)(mData + offset);
         LogDebug("----------------------------------------------------- Curve table has 0x%x entries -----------------------------------------------------", curveCount);
         Assert(curveCount == 0, "Curve count is not zero: 0x%x", curveCount);
     }
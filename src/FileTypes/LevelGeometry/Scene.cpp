@@ -0,0 +1,194 @@
+#include "FileTypes/LevelGeometry/Scene.h"
+#include "core/hash.h"
+#include "assimp/anim.h"
+#include "assimp/material.h"
+#include "assimp/matrix4x4.h"
+#include "assimp/quaternion.h"
+#include <algorithm>
+#include <cstring>
+
+namespace SPMEditor {
+    Scene::Scene() : mArena(arena_create()), mNodes(nullptr), mNodeCount(0), mNodeMeshes(nullptr), mNodeMeshCount(0), mMeshes(nullptr), mMeshCount(0),
+        mMaterials(nullptr), mMaterialCount(0), mTextures(nullptr), mTextureCount(0), mAnimations(nullptr), mAnimationCount(0), mNodeIndex(nullptr) {}
+
+    Scene::~Scene() {
+        arena_destroy(mArena);
+    }
+
+    void Scene::BuildNodeIndex() {
+        mNodeIndex = arena_alloc_array<NodeIndexEntry>(mArena, mNodeCount);
+        for (u32 i = 0; i < mNodeCount; i++) {
+            mNodeIndex[i] = { mNodes[i].mNameHash, (s32)i };
+        }
+
+        // Stable so that of several nodes with the same name the first one is found
+        std::stable_sort(mNodeIndex, mNodeIndex + mNodeCount, [](const NodeIndexEntry& a, const NodeIndexEntry& b) { return a.mNameHash < b.mNameHash; });
+    }
+
+    s32 Scene::FindNode(const char* name) const {
+        u64 hash = hash_bytes(name, strlen(name));
+        const NodeIndexEntry* entry = std::lower_bound(mNodeIndex, mNodeIndex + mNodeCount, hash, [](const NodeIndexEntry& a, u64 hash) { return a.mNameHash < hash; });
+        for (; entry != mNodeIndex + mNodeCount && entry->mNameHash == hash; entry++) {
+            if (strcmp(mNodes[entry->mNode].mName, name) == 0)
+                return entry->mNode;
+        }
+
+        return -1;
+    }
+
+    static aiVector3D ToAssimpVector(const Vector3& vector) {
+        return aiVector3D(vector.x, vector.y, vector.z);
+    }
+
+    static aiNode* CreateAssimpNode(const Scene* scene, s32 index, aiNode* parent) {
+        const SceneNode& node = scene->mNodes[index];
+        aiNode* assimpNode = new aiNode();
+        assimpNode->mName = aiString(node.mName);
+        assimpNode->mParent = parent;
+        assimpNode->mTransformation = aiMatrix4x4(ToAssimpVector(node.mScale), aiQuaternion(node.mRotation.y, node.mRotation.z, node.mRotation.x), ToAssimpVector(node.mPosition));
+
+        assimpNode->mNumMeshes = node.mMeshCount;
+        assimpNode->mMeshes = new u32[node.mMeshCount];
+        memcpy(assimpNode->mMeshes, scene->mNodeMeshes + node.mFirstMesh, node.mMeshCount * sizeof(u32));
+
+        u32 childCount = 0;
+        for (s32 child = node.mFirstChild; child != -1; child = scene->mNodes[child].mNextSibling) {
+            childCount++;
+        }
+
+        if (childCount > 0) {
+            assimpNode->mNumChildren = childCount;
+            assimpNode->mChildren = new aiNode*[childCount];
+            u32 i = 0;
+            for (s32 child = node.mFirstChild; child != -1; child = scene->mNodes[child].mNextSibling) {
+                assimpNode->mChildren[i++] = CreateAssimpNode(scene, child, assimpNode);
+            }
+        }
+
+        return assimpNode;
+    }
+
+    aiScene* Scene::ToAssimp() const {
+        aiScene* scene = new aiScene();
+
+        scene->mNumTextures = mTextureCount;
+        scene->mTextures = new aiTexture*[mTextureCount];
+        for (u32 i = 0; i < mTextureCount; i++) {
+            const SceneTexture& texture = mTextures[i];
+            aiTexture* assimpTexture = new aiTexture();
+            assimpTexture->mWidth = texture.mWidth;
+            assimpTexture->mHeight = texture.mHeight;
+            assimpTexture->mFilename = aiString(texture.mName);
+            memcpy(assimpTexture->achFormatHint, "bgra8888", 9);
+
+            u32 pixelCount = texture.mWidth * texture.mHeight;
+            assimpTexture->pcData = new aiTexel[pixelCount];
+            for (u32 p = 0; p < pixelCount; p++) {
+                const Color& color = texture.mPixels[p];
+                assimpTexture->pcData[p] = { color.b, color.g, color.r, color.a };
+            }
+
+            scene->mTextures[i] = assimpTexture;
+        }
+
+        scene->mNumMaterials = mMaterialCount;
+        scene->mMaterials = new aiMaterial*[mMaterialCount];
+        for (u32 i = 0; i < mMaterialCount; i++) {
+            const SceneMaterial& material = mMaterials[i];
+            aiMaterial* assimpMaterial = new aiMaterial();
+
+            aiString name(material.mName);
+            assimpMaterial->AddProperty(&name, AI_MATKEY_NAME);
+            if (material.mTextureName) {
+                aiString textureName(material.mTextureName);
+                assimpMaterial->AddProperty(&textureName, AI_MATKEY_TEXTURE_DIFFUSE(0));
+            }
+
+            aiColor4D color((float)material.mColor.r / 255, (float)material.mColor.g / 255, (float)material.mColor.b / 255, (float)material.mColor.a / 255);
+            assimpMaterial->AddProperty(&color, 4, AI_MATKEY_BASE_COLOR);
+            assimpMaterial->AddProperty(&color, 4, AI_MATKEY_COLOR_DIFFUSE);
+
+            scene->mMaterials[i] = assimpMaterial;
+        }
+
+        scene->mNumMeshes = mMeshCount;
+        scene->mMeshes = new aiMesh*[mMeshCount];
+        for (u32 i = 0; i < mMeshCount; i++) {
+            const SceneMesh& mesh = mMeshes[i];
+            aiMesh* assimpMesh = new aiMesh();
+            assimpMesh->mName = aiString(mesh.mName);
+            assimpMesh->mMaterialIndex = mesh.mMaterialIndex;
+
+            assimpMesh->mNumVertices = mesh.mVertexCount;
+            assimpMesh->mVertices = new aiVector3D[mesh.mVertexCount];
+            assimpMesh->mNormals = new aiVector3D[mesh.mVertexCount];
+            assimpMesh->mNumUVComponents[0] = 2;
+            assimpMesh->mTextureCoords[0] = new aiVector3D[mesh.mVertexCount];
+            if (mesh.mColors)
+                assimpMesh->mColors[0] = new aiColor4D[mesh.mVertexCount];
+
+            for (u32 v = 0; v < mesh.mVertexCount; v++) {
+                assimpMesh->mVertices[v] = ToAssimpVector(mesh.mPositions[v]);
+                assimpMesh->mNormals[v] = ToAssimpVector(mesh.mNormals[v]);
+                assimpMesh->mTextureCoords[0][v] = aiVector3D(mesh.mUVs[v].x, mesh.mUVs[v].y, 0);
+                if (mesh.mColors) {
+                    const Color& color = mesh.mColors[v];
+                    assimpMesh->mColors[0][v] = aiColor4D((float)color.r / 255, (float)color.g / 255, (float)color.b / 255, (float)color.a / 255);
+                }
+            }
+
+            assimpMesh->mNumFaces = mesh.mIndexCount / 3;
+            assimpMesh->mFaces = new aiFace[assimpMesh->mNumFaces];
+            for (u32 f = 0; f < assimpMesh->mNumFaces; f++) {
+                aiFace& face = assimpMesh->mFaces[f];
+                face.mNumIndices = 3;
+                face.mIndices = new unsigned int[3];
+                face.mIndices[0] = mesh.mIndices[f * 3 + 0];
+                face.mIndices[1] = mesh.mIndices[f * 3 + 1];
+                face.mIndices[2] = mesh.mIndices[f * 3 + 2];
+            }
+
+            scene->mMeshes[i] = assimpMesh;
+        }
+
+        if (mNodeCount > 0)
+            scene->mRootNode = CreateAssimpNode(this, 0, nullptr);
+
+        scene->mNumAnimations = mAnimationCount;
+        scene->mAnimations = new aiAnimation*[mAnimationCount];
+        for (u32 i = 0; i < mAnimationCount; i++) {
+            const SceneAnimation& animation = mAnimations[i];
+            aiAnimation* assimpAnimation = new aiAnimation();
+            assimpAnimation->mName = aiString(animation.mName);
+            assimpAnimation->mDuration = animation.mDuration;
+            assimpAnimation->mTicksPerSecond = animation.mFramesPerSecond;
+
+            assimpAnimation->mNumChannels = animation.mChannelCount;
+            assimpAnimation->mChannels = new aiNodeAnim*[animation.mChannelCount];
+            for (u32 c = 0; c < animation.mChannelCount; c++) {
+                const SceneAnimationChannel& channel = animation.mChannels[c];
+                aiNodeAnim* assimpChannel = new aiNodeAnim();
+                assimpChannel->mNodeName = aiString(mNodes[channel.mNode].mName);
+
+                assimpChannel->mNumPositionKeys = channel.mKeyframeCount;
+                assimpChannel->mNumRotationKeys = channel.mKeyframeCount;
+                assimpChannel->mNumScalingKeys = channel.mKeyframeCount;
+                assimpChannel->mPositionKeys = new aiVectorKey[channel.mKeyframeCount];
+                assimpChannel->mRotationKeys = new aiQuatKey[channel.mKeyframeCount];
+                assimpChannel->mScalingKeys = new aiVectorKey[channel.mKeyframeCount];
+                for (u32 k = 0; k < channel.mKeyframeCount; k++) {
+                    const SceneKeyframe& key = channel.mKeyframes[k];
+                    assimpChannel->mPositionKeys[k] = aiVectorKey(key.mTime, ToAssimpVector(key.mPosition));
+                    assimpChannel->mRotationKeys[k] = aiQuatKey(key.mTime, aiQuaternion(key.mRotation.y, key.mRotation.z, key.mRotation.x));
+                    assimpChannel->mScalingKeys[k] = aiVectorKey(key.mTime, ToAssimpVector(key.mScale));
+                }
+
+                assimpAnimation->mChannels[c] = assimpChannel;
+            }
+
+            scene->mAnimations[i] = assimpAnimation;
+        }
+
+        return scene;
+    }
+}
@@ -0,0 +1,150 @@
+#include "FileTypes/LevelGeometry/TextureAtlas.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+namespace SPMEditor {
+    struct FreeRect {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    static bool Contains(const FreeRect& outer, const FreeRect& inner) {
+        return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+    }
+
+    // Replaces every free rect overlapping the used rect with the up to four maximal rects around it
+    static void SplitFreeRects(std::vector<FreeRect>& freeRects, const FreeRect& used) {
+        std::vector<FreeRect> split;
+        for (const FreeRect& free : freeRects) {
+            if (used.x >= free.x + free.width || used.x + used.width <= free.x || used.y >= free.y + free.height || used.y + used.height <= free.y) {
+                split.push_back(free);
+                continue;
+            }
+
+            if (used.x > free.x)
+                split.push_back({ free.x, free.y, used.x - free.x, free.height });
+            if (used.x + used.width < free.x + free.width)
+                split.push_back({ used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height });
+            if (used.y > free.y)
+                split.push_back({ free.x, free.y, free.width, used.y - free.y });
+            if (used.y + used.height < free.y + free.height)
+                split.push_back({ free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height });
+        }
+
+        // Drop rects inside other rects, of two identical rects only the first is kept
+        freeRects.clear();
+        for (size_t i = 0; i < split.size(); i++) {
+            bool redundant = false;
+            for (size_t j = 0; j < split.size() && !redundant; j++) {
+                redundant = i != j && Contains(split[j], split[i]) && (!Contains(split[i], split[j]) || j < i);
+            }
+
+            if (!redundant)
+                freeRects.push_back(split[i]);
+        }
+    }
+
+    std::vector<TextureAtlasPage> TextureAtlas::Pack(std::vector<TextureAtlasRect>& rects, int pageSize) {
+        struct PageState {
+            std::vector<FreeRect> freeRects;
+            int usedWidth;
+            int usedHeight;
+        };
+
+        // Placing the largest rects first leaves the small ones to fill the gaps
+        std::vector<size_t> order(rects.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            int sideA = std::max(rects[a].mWidth, rects[a].mHeight);
+            int sideB = std::max(rects[b].mWidth, rects[b].mHeight);
+            if (sideA != sideB)
+                return sideA > sideB;
+            return rects[a].mWidth * rects[a].mHeight > rects[b].mWidth * rects[b].mHeight;
+        });
+
+        std::vector<PageState> pages;
+        for (size_t index : order) {
+            TextureAtlasRect& rect = rects[index];
+
+            // Cells are kept a multiple of the block size so every texture starts on a block boundary
+            int width = (rect.mWidth + 3) / 4 * 4 + GuardBand * 2;
+            int height = (rect.mHeight + 3) / 4 * 4 + GuardBand * 2;
+            Assert(width <= pageSize && height <= pageSize, "Texture of size %dx%d does not fit in an atlas page of size %d", rect.mWidth, rect.mHeight, pageSize);
+
+            // Best short side fit, the free rect whose smaller leftover side is the smallest
+            int bestPage = -1;
+            FreeRect bestRect = {};
+            int bestShortSide = pageSize + 1;
+            int bestLongSide = pageSize + 1;
+            for (size_t p = 0; p < pages.size(); p++) {
+                for (const FreeRect& free : pages[p].freeRects) {
+                    if (free.width < width || free.height < height)
+                        continue;
+
+                    int shortSide = std::min(free.width - width, free.height - height);
+                    int longSide = std::max(free.width - width, free.height - height);
+                    if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide)) {
+                        bestPage = p;
+                        bestRect = { free.x, free.y, width, height };
+                        bestShortSide = shortSide;
+                        bestLongSide = longSide;
+                    }
+                }
+            }
+
+            if (bestPage == -1) {
+                pages.push_back({ { { 0, 0, pageSize, pageSize } }, 0, 0 });
+                bestPage = pages.size() - 1;
+                bestRect = { 0, 0, width, height };
+            }
+
+            PageState& page = pages[bestPage];
+            SplitFreeRects(page.freeRects, bestRect);
+            page.usedWidth = std::max(page.usedWidth, bestRect.x + bestRect.width);
+            page.usedHeight = std::max(page.usedHeight, bestRect.y + bestRect.height);
+
+            rect.mPage = bestPage;
+            rect.mX = bestRect.x + GuardBand;
+            rect.mY = bestRect.y + GuardBand;
+        }
+
+        std::vector<TextureAtlasPage> result(pages.size());
+        for (size_t i = 0; i < pages.size(); i++) {
+            result[i].mWidth = std::bit_ceil((u32)pages[i].usedWidth);
+            result[i].mHeight = std::bit_ceil((u32)pages[i].usedHeight);
+        }
+
+        return result;
+    }
+
+    static int WrapCoordinate(int coordinate, int size, MapStructures::MapTexture::WrapMode mode) {
+        switch (mode) {
+            case MapStructures::MapTexture::WrapMode::Repeat:
+                return (coordinate % size + size) % size;
+            case MapStructures::MapTexture::WrapMode::Mirror: {
+                int period = size * 2;
+                int position = (coordinate % period + period) % period;
+                return position < size ? position : period - 1 - position;
+            }
+            case MapStructures::MapTexture::WrapMode::Clamp:
+            default:
+                return std::clamp(coordinate, 0, size - 1);
+        }
+    }
+
+    void TextureAtlas::Blit(const Color* pixels, const TextureAtlasRect& rect, MapStructures::MapTexture::WrapMode wrapU, MapStructures::MapTexture::WrapMode wrapV, Color* page, int pageWidth) {
+        // Fill the whole cell, including the padding up to the block size, so no block of the page mixes in empty pixels
+        const int cellWidth = (rect.mWidth + 3) / 4 * 4;
+        const int cellHeight = (rect.mHeight + 3) / 4 * 4;
+        for (int y = -GuardBand; y < cellHeight + GuardBand; y++) {
+            const Color* source = pixels + WrapCoordinate(y, rect.mHeight, wrapV) * rect.mWidth;
+            Color* destination = page + (rect.mY + y) * pageWidth + rect.mX;
+            for (int x = -GuardBand; x < cellWidth + GuardBand; x++) {
+                destination[x] = source[WrapCoordinate(x, rect.mWidth, wrapU)];
+            }
+        }
+    }
+}
@@ -0,0 +1,188 @@
+#include "FileTypes/LevelGeometry/TriangleStripper.h"
+#include <algorithm>
+
+namespace SPMEditor {
+    // A directed edge of a triangle, following its winding
+    struct StripEdge {
+        u64 mKey;
+        u32 mTriangle;
+    };
+
+    // The mark of triangles taken by a finished strip, other marks are the trial that last took the triangle
+    constexpr u32 Committed = 0xffffffff;
+
+    // How many triangles in the input order are looked at for the start of each strip
+    constexpr u32 StartWindow = 16;
+
+    struct StripContext {
+        const std::vector<u32>& mTriangles;
+        std::vector<StripEdge> mEdges; // Sorted by key
+        std::vector<u32> mMarks;
+        u32 mTrial;
+
+        bool IsFree(u32 triangle) const { return mMarks[triangle] != Committed && mMarks[triangle] != mTrial; }
+    };
+
+    static u64 EdgeKey(u32 from, u32 to) {
+        return ((u64)from << 32) | to;
+    }
+
+    template<typename F>
+    static void ForEachTriangleWithEdge(const StripContext& context, u32 from, u32 to, F function) {
+        u64 key = EdgeKey(from, to);
+        auto edge = std::lower_bound(context.mEdges.begin(), context.mEdges.end(), key, [](const StripEdge& edge, u64 key) { return edge.mKey < key; });
+        for (; edge != context.mEdges.end() && edge->mKey == key; edge++) {
+            function(edge->mTriangle);
+        }
+    }
+
+    // The free triangles a strip could continue into from this one, which are those sharing an edge with the opposite direction
+    static u32 GetFreeNeighbourCount(const StripContext& context, u32 triangle) {
+        const u32* vertices = &context.mTriangles[triangle * 3];
+        u32 count = 0;
+        for (u32 i = 0; i < 3; i++) {
+            ForEachTriangleWithEdge(context, vertices[(i + 1) % 3], vertices[i], [&](u32 neighbour) {
+                if (context.IsFree(neighbour))
+                    count++;
+            });
+        }
+
+        return count;
+    }
+
+    // Finds the free triangle with the edge that has the fewest free neighbours, writing the vertex opposite of the edge to third
+    static u32 FindNextTriangle(const StripContext& context, u32 from, u32 to, u32& third) {
+        u32 best = Committed;
+        u32 bestNeighbours = 0;
+        ForEachTriangleWithEdge(context, from, to, [&](u32 triangle) {
+            if (!context.IsFree(triangle))
+                return;
+
+            u32 neighbours = GetFreeNeighbourCount(context, triangle);
+            if (best == Committed || neighbours < bestNeighbours) {
+                best = triangle;
+                bestNeighbours = neighbours;
+            }
+        });
+
+        if (best != Committed) {
+            const u32* vertices = &context.mTriangles[best * 3];
+            for (u32 i = 0; i < 3; i++) {
+                if (vertices[i] == from)
+                    third = vertices[(i + 2) % 3];
+            }
+        }
+
+        return best;
+    }
+
+    // Grows a strip from a triangle rotated so it starts at the given vertex, marking the triangles it uses with the current trial
+    static void GrowStrip(StripContext& context, u32 start, u32 rotation, u32 maxLength, std::vector<u32>& strip, std::vector<u32>& stripTriangles) {
+        const u32* vertices = &context.mTriangles[start * 3];
+        strip = { vertices[rotation], vertices[(rotation + 1) % 3], vertices[(rotation + 2) % 3] };
+        stripTriangles = { start };
+        context.mMarks[start] = context.mTrial;
+
+        while (strip.size() < maxLength) {
+            // The next triangle shares the strip's last two vertices, in the order its position in the strip flips them to
+            u32 a = strip[strip.size() - 2];
+            u32 b = strip[strip.size() - 1];
+            bool even = strip.size() % 2 == 0;
+            u32 third;
+            u32 next = even ? FindNextTriangle(context, a, b, third) : FindNextTriangle(context, b, a, third);
+            if (next == Committed)
+                break;
+
+            strip.push_back(third);
+            stripTriangles.push_back(next);
+            context.mMarks[next] = context.mTrial;
+        }
+    }
+
+    std::vector<std::vector<u32>> TriangleStripper::Build(const std::vector<u32>& triangles, bool stitch, u32 maxLength) {
+        Assert(maxLength >= 3, "Triangle strips need room for at least one triangle, got a max length of %u", maxLength);
+        u32 triangleCount = triangles.size() / 3;
+        StripContext context { triangles, {}, std::vector<u32>(triangleCount, 0), 1 };
+
+        // Triangles that use a vertex twice have no area and would only break up strips
+        context.mEdges.reserve(triangles.size());
+        for (u32 t = 0; t < triangleCount; t++) {
+            const u32* vertices = &triangles[t * 3];
+            if (vertices[0] == vertices[1] || vertices[1] == vertices[2] || vertices[0] == vertices[2]) {
+                context.mMarks[t] = Committed;
+                continue;
+            }
+
+            for (u32 i = 0; i < 3; i++) {
+                context.mEdges.push_back({ EdgeKey(vertices[i], vertices[(i + 1) % 3]), t });
+            }
+        }
+        std::sort(context.mEdges.begin(), context.mEdges.end(), [](const StripEdge& a, const StripEdge& b) { return a.mKey < b.mKey || (a.mKey == b.mKey && a.mTriangle < b.mTriangle); });
+
+        std::vector<std::vector<u32>> strips;
+        std::vector<u32> strip, stripTriangles, bestStrip, bestTriangles;
+        u32 firstFree = 0;
+        while (true) {
+            while (firstFree < triangleCount && context.mMarks[firstFree] == Committed)
+                firstFree++;
+            if (firstFree == triangleCount)
+                break;
+
+            // Start at the triangle with the fewest free neighbours of the next few in the input order.
+            // Triangles that are hard to reach go first, while strips still follow the order VertexCache::Optimize gives
+            u32 start = firstFree;
+            u32 startNeighbours = GetFreeNeighbourCount(context, start);
+            for (u32 t = firstFree + 1; t < std::min(firstFree + StartWindow, triangleCount) && startNeighbours > 0; t++) {
+                if (context.mMarks[t] == Committed)
+                    continue;
+
+                u32 neighbours = GetFreeNeighbourCount(context, t);
+                if (neighbours < startNeighbours) {
+                    start = t;
+                    startNeighbours = neighbours;
+                }
+            }
+
+            // Try starting from each edge of the triangle and keep the longest strip
+            bestStrip.clear();
+            for (u32 rotation = 0; rotation < 3; rotation++) {
+                context.mTrial++;
+                GrowStrip(context, start, rotation, maxLength, strip, stripTriangles);
+                if (strip.size() > bestStrip.size()) {
+                    std::swap(strip, bestStrip);
+                    std::swap(stripTriangles, bestTriangles);
+                }
+            }
+
+            for (u32 triangle : bestTriangles) {
+                context.mMarks[triangle] = Committed;
+            }
+            strips.push_back(bestStrip);
+            context.mTrial++; // Frees the triangles of the strips that weren't kept
+        }
+
+        if (!stitch || strips.empty())
+            return strips;
+
+        // Repeating the last vertex of a strip and the first of the next gives triangles without area between them.
+        // The next strip has to start on an even triangle to keep its winding, so odd length strips need one more repeat
+        std::vector<std::vector<u32>> stitched;
+        stitched.push_back(std::move(strips[0]));
+        for (size_t i = 1; i < strips.size(); i++) {
+            std::vector<u32>& last = stitched.back();
+            u32 bridgeLength = last.size() % 2 == 0 ? 2 : 3;
+            if (last.size() + bridgeLength + strips[i].size() > maxLength) {
+                stitched.push_back(std::move(strips[i]));
+                continue;
+            }
+
+            last.push_back(last.back());
+            last.push_back(strips[i][0]);
+            if (bridgeLength == 3)
+                last.push_back(strips[i][0]);
+            last.insert(last.end(), strips[i].begin(), strips[i].end());
+        }
+
+        return stitched;
+    }
+}
@@ -0,0 +1,152 @@
+#include "FileTypes/LevelGeometry/VertexCache.h"
+#include <algorithm>
+#include <cmath>
+
+namespace SPMEditor {
+    // The scoring constants from Forsyth's article
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriangleScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+
+    constexpr u32 NoTriangle = 0xffffffff;
+
+    static float GetVertexScore(s32 cachePosition, u32 remainingTriangles, u32 cacheSize) {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0;
+        if (cachePosition >= 0) {
+            // The last triangle's vertices score lower than the rest of the cache, so the next triangle doesn't only reuse its edge
+            if (cachePosition < 3)
+                score = LastTriangleScore;
+            else
+                score = std::pow(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), CacheDecayPower);
+        }
+
+        // Vertices with few triangles left are finished first, so they don't need to be fetched again later
+        return score + ValenceBoostScale * std::pow((float)remainingTriangles, -ValenceBoostPower);
+    }
+
+    std::vector<u32> VertexCache::Optimize(const std::vector<u32>& triangles, u32 vertexCount, u32 cacheSize) {
+        Assert(cacheSize > 3, "The vertex cache has to hold more than one triangle, got a size of %u", cacheSize);
+        u32 triangleCount = triangles.size() / 3;
+
+        // The triangles of each vertex, back to back. The first remaining[v] triangles of a vertex are the ones not added yet
+        std::vector<u32> triangleOffsets(vertexCount + 1, 0);
+        for (u32 index : triangles) {
+            Assert(index < vertexCount, "Triangle uses vertex %u, but there are only %u vertices", index, vertexCount);
+            triangleOffsets[index + 1]++;
+        }
+        std::vector<u32> remaining(vertexCount);
+        for (u32 v = 0; v < vertexCount; v++) {
+            remaining[v] = triangleOffsets[v + 1];
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        }
+
+        std::vector<u32> vertexTriangles(triangles.size());
+        std::vector<u32> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (u32 t = 0; t < triangleCount; t++) {
+            for (u32 i = 0; i < 3; i++) {
+                u32 vertex = triangles[t * 3 + i];
+                vertexTriangles[fill[vertex]++] = t;
+            }
+        }
+
+        std::vector<float> vertexScores(vertexCount);
+        for (u32 v = 0; v < vertexCount; v++) {
+            vertexScores[v] = GetVertexScore(-1, remaining[v], cacheSize);
+        }
+
+        auto getTriangleScore = [&](u32 t) { return vertexScores[triangles[t * 3]] + vertexScores[triangles[t * 3 + 1]] + vertexScores[triangles[t * 3 + 2]]; };
+        std::vector<bool> added(triangleCount, false);
+        u32 best = NoTriangle;
+        float bestScore = 0;
+        for (u32 t = 0; t < triangleCount; t++) {
+            float score = getTriangleScore(t);
+            if (best == NoTriangle || score > bestScore) {
+                best = t;
+                bestScore = score;
+            }
+        }
+
+        std::vector<u32> result;
+        result.reserve(triangles.size());
+        std::vector<u32> cache, nextCache;
+        cache.reserve(cacheSize + 3);
+        nextCache.reserve(cacheSize + 3);
+        u32 firstUnadded = 0;
+        while (result.size() < triangles.size()) {
+            if (best == NoTriangle) {
+                // None of the cached vertices have triangles left, continue with the first triangle that wasn't added
+                while (added[firstUnadded])
+                    firstUnadded++;
+                best = firstUnadded;
+            }
+
+            added[best] = true;
+            const u32* vertices = &triangles[best * 3];
+            result.insert(result.end(), vertices, vertices + 3);
+
+            // Take the triangle out of its vertices' lists and move the vertices to the front of the cache
+            nextCache.clear();
+            for (u32 i = 0; i < 3; i++) {
+                u32 vertex = vertices[i];
+                u32* list = &vertexTriangles[triangleOffsets[vertex]];
+                for (u32 j = 0; j < remaining[vertex]; j++) {
+                    if (list[j] == best) {
+                        list[j] = list[--remaining[vertex]];
+                        break;
+                    }
+                }
+
+                if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+                    nextCache.push_back(vertex);
+            }
+            for (u32 vertex : cache) {
+                if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+                    nextCache.push_back(vertex);
+            }
+
+            // Vertices past the cache size were just pushed out, but their triangles still need new scores
+            for (u32 i = 0; i < nextCache.size(); i++) {
+                u32 vertex = nextCache[i];
+                vertexScores[vertex] = GetVertexScore(i < cacheSize ? i : -1, remaining[vertex], cacheSize);
+            }
+
+            best = NoTriangle;
+            for (u32 vertex : nextCache) {
+                const u32* list = &vertexTriangles[triangleOffsets[vertex]];
+                for (u32 j = 0; j < remaining[vertex]; j++) {
+                    float score = getTriangleScore(list[j]);
+                    if (best == NoTriangle || score > bestScore) {
+                        best = list[j];
+                        bestScore = score;
+                    }
+                }
+            }
+
+            if (nextCache.size() > cacheSize)
+                nextCache.resize(cacheSize);
+            std::swap(cache, nextCache);
+        }
+
+        return result;
+    }
+
+    u32 VertexCache::CountMisses(const u32* vertices, size_t count, u32 cacheSize) {
+        std::vector<u32> cache(cacheSize, 0xffffffff);
+        u32 next = 0;
+        u32 misses = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (std::find(cache.begin(), cache.end(), vertices[i]) != cache.end())
+                continue;
+
+            cache[next] = vertices[i];
+            next = (next + 1) % cacheSize;
+            misses++;
+        }
+
+        return misses;
+    }
+}
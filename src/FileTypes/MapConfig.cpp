@@ -1,9 +1,11 @@
 #include "FileTypes/MapConfig.h"
+#include "FileTypes/TPLEncoder.h"
 #include "assimp/Importer.hpp"
 #include "assimp/material.h"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 #include <yaml-cpp/yaml.h>
+#include <bit>
 #include <fstream>
 #include <ostream>
 
@@ -34,6 +36,10 @@ namespace YAML {
                 node["UseTransparency"] = rhs.mUseTransparency;
                 node["WrapModeU"] = (u32)rhs.mWrapModeU;
                 node["WrapModeV"] = (u32)rhs.mWrapModeV;
+                node["Format"] = SPMEditor::TPL::GetFormatName(rhs.mFormat);
+                node["CompressionQuality"] = rhs.mCompressionQuality == SPMEditor::TPLCompressionQuality::High ? "High" : "Fast";
+                node["Dither"] = rhs.mDither;
+                node["Mipmaps"] = rhs.mGenerateMipmaps;
                 return node;
             }
 
@@ -42,6 +48,73 @@ namespace YAML {
                 rhs.mUseTransparency = node["UseTransparency"].as<bool>();
                 rhs.mWrapModeU = (SPMEditor::MapTexture::WrapMode)node["WrapModeU"].as<u32>();
                 rhs.mWrapModeV = (SPMEditor::MapTexture::WrapMode)node["WrapModeV"].as<u32>();
+
+                // Configs written before these options existed default to uncompressed textures
+                rhs.mFormat = SPMEditor::TPLImageFormat::RGBA32;
+                if (node["Format"]) {
+                    std::string formatName = node["Format"].as<std::string>();
+                    SPMEditor::TPLImageFormat format;
+                    if (SPMEditor::TPL::TryParseFormatName(formatName, format) && (format == SPMEditor::TPLImageFormat::Auto || SPMEditor::TPLEncoder::SupportsFormat(format)))
+                        rhs.mFormat = format;
+                    else
+                        LogWarn("Texture config '%s' has unsupported format '%s'. Defaulting to RGBA32", rhs.mName.c_str(), formatName.c_str());
+                }
+
+                rhs.mCompressionQuality = SPMEditor::TPLCompressionQuality::Fast;
+                if (node["CompressionQuality"] && node["CompressionQuality"].as<std::string>() == "High")
+                    rhs.mCompressionQuality = SPMEditor::TPLCompressionQuality::High;
+
+                rhs.mDither = node["Dither"] && node["Dither"].as<bool>();
+                rhs.mGenerateMipmaps = node["Mipmaps"] && node["Mipmaps"].as<bool>();
+                return true;
+            }
+        };
+
+    template<>
+        struct convert<SPMEditor::AtlasConfig> {
+            static Node encode(const SPMEditor::AtlasConfig& rhs) {
+                Node node;
+                node["Enabled"] = rhs.mEnabled;
+                node["MaxTextureSize"] = rhs.mMaxTextureSize;
+                node["PageSize"] = rhs.mPageSize;
+                return node;
+            }
+
+            static bool decode(const Node& node, SPMEditor::AtlasConfig& rhs) {
+                // Missing keys keep their defaults
+                if (node["Enabled"])
+                    rhs.mEnabled = node["Enabled"].as<bool>();
+                if (node["MaxTextureSize"])
+                    rhs.mMaxTextureSize = node["MaxTextureSize"].as<u32>();
+                if (node["PageSize"])
+                    rhs.mPageSize = node["PageSize"].as<u32>();
+                if (!std::has_single_bit(rhs.mPageSize)) {
+                    LogWarn("Texture atlas page size %u is not a power of two. Defaulting to 512", rhs.mPageSize);
+                    rhs.mPageSize = 512;
+                }
+                return true;
+            }
+        };
+
+    template<>
+        struct convert<SPMEditor::TextureBudgetConfig> {
+            static Node encode(const SPMEditor::TextureBudgetConfig& rhs) {
+                Node node;
+                node["MaxTextureSize"] = rhs.mMaxTextureSize;
+                node["MaxMapSize"] = rhs.mMaxMapSize;
+                return node;
+            }
+
+            static bool decode(const Node& node, SPMEditor::TextureBudgetConfig& rhs) {
+                // Missing keys keep their defaults
+                if (node["MaxTextureSize"])
+                    rhs.mMaxTextureSize = node["MaxTextureSize"].as<u32>();
+                if (node["MaxMapSize"])
+                    rhs.mMaxMapSize = node["MaxMapSize"].as<u32>();
+                if (rhs.mMaxTextureSize < 8) {
+                    LogWarn("Texture budget max texture size %u is too small. Defaulting to 512", rhs.mMaxTextureSize);
+                    rhs.mMaxTextureSize = 512;
+                }
                 return true;
             }
         };
@@ -66,6 +139,10 @@ namespace SPMEditor {
                     .mUseTransparency = false,
                     .mWrapModeU = MapTexture::WrapMode::Repeat,
                     .mWrapModeV = MapTexture::WrapMode::Repeat,
+                    .mFormat = TPLImageFormat::Auto,
+                    .mCompressionQuality = TPLCompressionQuality::Fast,
+                    .mDither = false,
+                    .mGenerateMipmaps = true,
                     });
         }
 
@@ -83,11 +160,11 @@ namespace SPMEditor {
         }
 
         // Create Map Config
-        MapConfig config = {
-            .mMapName = mapName,
-            .mTextureConfigs = textureConfigs,
-            .mMaterialConfigs = materialConfigs,
-        };
+        MapConfig config;
+        config.mMapName = mapName;
+        config.mTextureConfigs = textureConfigs;
+        config.mMaterialConfigs = materialConfigs;
+        config.mAtlasConfig.mEnabled = true;
 
         WriteMapConfigToFile(&config, outputPath);
     }
@@ -100,6 +177,14 @@ namespace SPMEditor {
         config.mMaterialConfigs = yaml["MaterialConfigs"].as<std::vector<MaterialConfig>>();
         config.mMapName = yaml["MapName"].as<std::string>();
 
+        // Configs written before atlases existed don't use them
+        if (yaml["TextureAtlas"])
+            config.mAtlasConfig = yaml["TextureAtlas"].as<AtlasConfig>();
+        if (yaml["TextureBudget"])
+            config.mTextureBudget = yaml["TextureBudget"].as<TextureBudgetConfig>();
+        if (yaml["StitchStrips"])
+            config.mStitchStrips = yaml["StitchStrips"].as<bool>();
+
         return config;
     }
 
@@ -108,6 +193,9 @@ namespace SPMEditor {
         node["TextureConfigs"] = config->mTextureConfigs;
         node["MaterialConfigs"] = config->mMaterialConfigs;
         node["MapName"] = config->mMapName;
+        node["TextureAtlas"] = config->mAtlasConfig;
+        node["TextureBudget"] = config->mTextureBudget;
+        node["StitchStrips"] = config->mStitchStrips;
 
         std::ofstream outputStream(outFile);
         outputStream << node;
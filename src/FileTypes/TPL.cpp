@@ -1,35 +1,44 @@
 #include "FileTypes/TPL.h"
+#include "FileTypes/TPLEncoder.h"
 #include "Types/Types.h"
+#include "core/cpu.h"
 #include "core/filesystem.h"
+#include "core/jobs.h"
 #include "stb_image.h"
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
+#ifdef SPME_X86
+#include <immintrin.h>
+#endif
+
 // Private structures
 
 namespace SPMEditor {
 
-    TPL::Header TPL::Header::SwapBytes() {
+    TPL::Header TPL::Header::SwapBytes() const {
         TPL::Header header = *this;
         ByteSwap4(&header, 3);
         return header;
     }
 
-    TPL::ImageOffset TPL::ImageOffset::SwapBytes() {
+    TPL::ImageOffset TPL::ImageOffset::SwapBytes() const {
         ImageOffset offset = *this;
         ByteSwap4(&offset, 2);
         return offset;
     }
 
-    TPL::PaletteHeader TPL::PaletteHeader::SwapBytes() {
+    TPL::PaletteHeader TPL::PaletteHeader::SwapBytes() const {
         PaletteHeader header = *this;
         header.entryCount = ByteSwap(header.entryCount);
         ByteSwap((int*)&header + 1, 2);
         return header;
     }
 
-    TPL::ImageHeader TPL::ImageHeader::SwapBytes() {
+    TPL::ImageHeader TPL::ImageHeader::SwapBytes() const {
         ImageHeader header = *this;
         ByteSwap((short*)&header, 2);
         ByteSwap((int*)&header+ 1, 7);
@@ -37,9 +46,9 @@ namespace SPMEditor {
     }
 
     TPL TPL::LoadFromFile(const std::string& path) {
-        FileHandle handle = filesystem_read_file(path.c_str());
-        TPL outTpl = LoadFromBytes((const u8*)handle.data, handle.size);
-        return outTpl;
+        // The view owns the file data, so it is freed once the images are decoded
+        TPLView view = TPLView::LoadFromFile(path);
+        return LoadFromBytes(view.m_Data, view.m_Size);
     }
 
     TPL TPL::LoadFromBytes(const std::vector<u8>& data) {
@@ -47,342 +56,901 @@ namespace SPMEditor {
     }
 
     TPL TPL::LoadFromBytes(const u8* data, u64 size) {
-        Assert(size >= sizeof(Header), "Cannot read TPL from data size of %l", size);
+        TPLView view = TPLView::LoadFromBytes(data, size);
+
+        TPL tpl;
+        tpl.images.resize(view.GetImageCount());
+        std::vector<std::vector<Color>> palettes(view.GetImageCount());
+        for (u32 i = 0; i < view.GetImageCount(); i++) {
+            Image& image = tpl.images[i];
+            image.header = view.GetImageHeader(i);
+            image.pixels.resize(image.header.width * image.header.height);
+            palettes[i] = view.ReadPalette(i);
+        }
+
+        // Split every image into bands of block rows so both small and large images spread across threads.
+        // Each band writes its own rows of one image, so the result doesn't depend on the thread count
+        struct DecodeTask {
+            int image;
+            int firstBlockRow;
+            int blockRowCount;
+        };
+
+        constexpr int MinPixelsPerTask = 64 * 1024;
+        std::vector<DecodeTask> tasks;
+        for (int i = 0; i < (int)tpl.images.size(); i++) {
+            const ImageHeader& imageHeader = tpl.images[i].header;
+            int blockWidth;
+            int blockHeight;
+            GetBlockSize(imageHeader.format, blockWidth, blockHeight);
+
+            int numBlocksY = (imageHeader.height + blockHeight - 1) / blockHeight;
+            int rowsPerTask = std::max(1, MinPixelsPerTask / std::max(1, imageHeader.width * blockHeight));
+            for (int row = 0; row < numBlocksY; row += rowsPerTask) {
+                tasks.push_back({ i, row, std::min(rowsPerTask, numBlocksY - row) });
+            }
+        }
+
+        parallel_for(tasks.size(), [&](u32 index) {
+            const DecodeTask& task = tasks[index];
+            Image& image = tpl.images[task.image];
+            const std::vector<Color>& palette = palettes[task.image];
+            ReadImageInto(data + image.header.imageDataAddress, image.header, image.pixels.data(), palette.empty() ? nullptr : palette.data(), task.firstBlockRow, task.blockRowCount);
+        });
+
+        return tpl;
+    }
+
+    TPLView TPLView::LoadFromFile(const std::string& path) {
+        FileHandle handle = filesystem_read_file(path.c_str());
+        TPLView view = LoadFromBytes((const u8*)handle.data, handle.size);
+        view.m_File = std::shared_ptr<u8[]>((u8*)handle.data);
+        return view;
+    }
+
+    // The non palette formats TPL::GetBlockDecoder can decode, any other format is filled with magenta
+    static bool HasBlockDecoder(TPLImageFormat format) {
+        switch (format)
+        {
+            case TPLImageFormat::I4:
+            case TPLImageFormat::I8:
+            case TPLImageFormat::IA4:
+            case TPLImageFormat::IA8:
+            case TPLImageFormat::RGB565:
+            case TPLImageFormat::RGB5A3:
+            case TPLImageFormat::RGBA32:
+            case TPLImageFormat::CMPR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    TPLView TPLView::LoadFromBytes(const u8* data, u64 size) {
+        Assert(size >= sizeof(TPL::Header), "Cannot read TPL from data size of %llu", size);
 
         // Grab header
-        Header header = ((Header*)data)->SwapBytes();
+        TPL::Header header = ((TPL::Header*)data)->SwapBytes();
+        Assert(header.numImages >= 0 && header.imageTableOffset >= 0 && header.imageTableOffset + header.numImages * sizeof(TPL::ImageOffset) <= size,
+                "TPL image table at 0x%x with %d images is out of bounds", header.imageTableOffset, header.numImages);
 
         // Get the image offset pointer
-        ImageOffset* imageOffsets = (ImageOffset*)(data + header.imageTableOffset);
-
+        const TPL::ImageOffset* imageOffsets = (const TPL::ImageOffset*)(data + header.imageTableOffset);
 
-        TPL tpl;
-        tpl.images.resize(header.numImages);
+        TPLView view;
+        view.m_Data = data;
+        view.m_Size = size;
+        view.m_ImageHeaders.resize(header.numImages);
+        view.m_PaletteOffsets.resize(header.numImages);
         for (int i = 0; i < header.numImages; i++) {
             // Swap current image offset endianness
-            ImageOffset imageOffset = imageOffsets[i].SwapBytes();
+            TPL::ImageOffset imageOffset = imageOffsets[i].SwapBytes();
+            Assert(imageOffset.headerOffset >= 0 && imageOffset.headerOffset + sizeof(TPL::ImageHeader) <= size, "TPL image %d header at 0x%x is out of bounds", i, imageOffset.headerOffset);
+
+            TPL::ImageHeader& imageHeader = view.m_ImageHeaders[i];
+            imageHeader = ((const TPL::ImageHeader*)(data + imageOffset.headerOffset))->SwapBytes();
+            Assert((u64)imageHeader.imageDataAddress + TPL::GetImageDataSize(imageHeader.format, imageHeader.width, imageHeader.height) <= size,
+                    "TPL image %d data at 0x%x is out of bounds", i, imageHeader.imageDataAddress);
 
-            // Get the palette
-            PaletteHeader palette;
             if (imageOffset.paletteOffset)
             {
-                palette = ((PaletteHeader*)(data + imageOffset.paletteOffset))->SwapBytes();
+                Assert(imageOffset.paletteOffset >= 0 && imageOffset.paletteOffset + sizeof(TPL::PaletteHeader) <= size, "TPL image %d palette at 0x%x is out of bounds", i, imageOffset.paletteOffset);
+                TPL::PaletteHeader paletteHeader = ((const TPL::PaletteHeader*)(data + imageOffset.paletteOffset))->SwapBytes();
+                Assert((u64)paletteHeader.dataOffset + paletteHeader.entryCount * 2 <= size,
+                        "TPL image %d palette data at 0x%x with %u entries is out of bounds", i, paletteHeader.dataOffset, paletteHeader.entryCount);
+                view.m_PaletteOffsets[i] = imageOffset.paletteOffset;
+            }
+            else if (TPL::IsPaletteFormat(imageHeader.format))
+            {
+                LogWarn("TPL image %d is format %s but has no palette. Image will be filled with magenta.", i, TPL::GetFormatName(imageHeader.format));
             }
 
-            // Create an image
-            Image image;
-            image.header = ((ImageHeader*)(data + imageOffset.headerOffset))->SwapBytes();
+            // Warned once here rather than by the decoder, which is looked up for every band of the image
+            if (!TPL::IsPaletteFormat(imageHeader.format) && !HasBlockDecoder(imageHeader.format))
+                LogWarn("TPL image %d format %s (%d) is not supported. Image will be filled with magenta.", i, TPL::GetFormatName(imageHeader.format), (int)imageHeader.format);
+        }
+
+        return view;
+    }
+
+    u32 TPLView::GetImageCount() const {
+        return m_ImageHeaders.size();
+    }
 
-            // Read all the blocks
-            image.pixels = ReadImage(data + image.header.imageDataAddress, image.header);
-            tpl.images[i] = image;
+    const TPL::ImageHeader& TPLView::GetImageHeader(u32 index) const {
+        Assert(index < m_ImageHeaders.size(), "TPL image index %u is out of range, the tpl has %u images", index, (u32)m_ImageHeaders.size());
+        return m_ImageHeaders[index];
+    }
+
+    TPL::Image TPLView::DecodeImage(u32 index) const {
+        TPL::Image image = {};
+        image.header = GetImageHeader(index);
+        image.pixels.resize(image.header.width * image.header.height);
+        DecodeImageInto(index, image.pixels);
+        return image;
+    }
+
+    void TPLView::DecodeImageInto(u32 index, std::span<Color> output) const {
+        const TPL::ImageHeader& imageHeader = GetImageHeader(index);
+        Assert(output.size() >= (size_t)imageHeader.width * imageHeader.height, "Output of %zu pixels is too small for a %ux%u image", output.size(), imageHeader.width, imageHeader.height);
+
+        std::vector<Color> palette = ReadPalette(index);
+        TPL::ReadImageInto(m_Data + imageHeader.imageDataAddress, imageHeader, output.data(), palette.empty() ? nullptr : palette.data());
+    }
+
+    u32 TPLView::GetMipLevelCount(u32 index) const {
+        const TPL::ImageHeader& imageHeader = GetImageHeader(index);
+        if (imageHeader.minFilter < (u32)TPL::ImageFilter::NearMipNear || imageHeader.maxLOD == 0)
+            return 1;
+
+        // Older tpls set maxLOD without storing the levels, so only count the levels that end before the next image or palette data
+        u64 dataEnd = m_Size;
+        for (u32 i = 0; i < m_ImageHeaders.size(); i++) {
+            if (m_ImageHeaders[i].imageDataAddress > imageHeader.imageDataAddress)
+                dataEnd = std::min<u64>(dataEnd, m_ImageHeaders[i].imageDataAddress);
+            if (m_PaletteOffsets[i]) {
+                u32 paletteDataOffset = ((const TPL::PaletteHeader*)(m_Data + m_PaletteOffsets[i]))->SwapBytes().dataOffset;
+                if (paletteDataOffset > imageHeader.imageDataAddress)
+                    dataEnd = std::min<u64>(dataEnd, paletteDataOffset);
+            }
         }
 
-        return tpl;
+        u32 levelCount = 0;
+        u64 levelEnd = imageHeader.imageDataAddress;
+        for (int width = imageHeader.width, height = imageHeader.height; levelCount <= imageHeader.maxLOD; levelCount++) {
+            levelEnd += TPL::GetImageDataSize(imageHeader.format, width, height);
+            if (levelEnd > dataEnd)
+                break;
+
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        return std::max(1u, levelCount);
+    }
+
+    std::vector<Color> TPLView::ReadPalette(u32 index) const {
+        // A palette with no entries is all magenta, which keeps palette images without one safe to decode
+        if (!m_PaletteOffsets[index])
+            return TPL::IsPaletteFormat(m_ImageHeaders[index].format) ? TPL::ReadPalette(m_Data, {}, m_ImageHeaders[index].format) : std::vector<Color>();
+
+        TPL::PaletteHeader paletteHeader = ((const TPL::PaletteHeader*)(m_Data + m_PaletteOffsets[index]))->SwapBytes();
+        return TPL::ReadPalette(m_Data, paletteHeader, m_ImageHeaders[index].format);
     }
 
     void TPL::GetBlockSize(TPLImageFormat format, int& width, int& height)
     {
-        // Get the block size
-        width = 4; // Setting values to 4 to save a few switch cases
-        height = 4;
-
         switch (format)
         {
             case TPLImageFormat::I4:
-                {
-                    width = 8;
-                    height = 8;
-                }
+            case TPLImageFormat::C4:
+            case TPLImageFormat::CMPR:
+                width = 8;
+                height = 8;
+                break;
             case TPLImageFormat::I8:
-                {
-                    width = 8;
-                }
             case TPLImageFormat::IA4:
-                {
-                    width = 8;
-                }
-            case TPLImageFormat::IA8:    break;
-            case TPLImageFormat::RGB565: break;
-            case TPLImageFormat::RGB5A3: break;
-            case TPLImageFormat::RGBA32: break;
-            case TPLImageFormat::C4:
-                                              {
-                                                  width = 8;
-                                                  height = 8;
-                                              }
             case TPLImageFormat::C8:
-                                              {
-                                                  width = 8;
-                                              }
-            case TPLImageFormat::C14X2: break;
-            case TPLImageFormat::CMPR:
-                                             {
-                                                 width = 8;
-                                                 height = 8;
-                                             }
+                width = 8;
+                height = 4;
+                break;
+            case TPLImageFormat::IA8:
+            case TPLImageFormat::RGB565:
+            case TPLImageFormat::RGB5A3:
+            case TPLImageFormat::RGBA32:
+            case TPLImageFormat::C14X2:
+            default:
+                width = 4;
+                height = 4;
+                break;
         }
     }
 
-    std::vector<Color> TPL::ReadImage(const u8* data, ImageHeader imageHeader)
+    u32 TPL::GetBlockByteSize(TPLImageFormat format)
+    {
+        // Every format packs a block into one 32 byte cache line except RGBA32 which uses two
+        return format == TPLImageFormat::RGBA32 ? 64 : 32;
+    }
+
+    u32 TPL::GetImageDataSize(TPLImageFormat format, int width, int height)
     {
         int blockWidth;
         int blockHeight;
-        GetBlockSize(imageHeader.format, blockWidth, blockHeight);
+        GetBlockSize(format, blockWidth, blockHeight);
+
+        int numBlocksX = (width + blockWidth - 1) / blockWidth;
+        int numBlocksY = (height + blockHeight - 1) / blockHeight;
+        return numBlocksX * numBlocksY * GetBlockByteSize(format);
+    }
+
+    const char* TPL::GetFormatName(TPLImageFormat format)
+    {
+        switch (format)
+        {
+            case TPLImageFormat::I4:     return "I4";
+            case TPLImageFormat::I8:     return "I8";
+            case TPLImageFormat::IA4:    return "IA4";
+            case TPLImageFormat::IA8:    return "IA8";
+            case TPLImageFormat::RGB565: return "RGB565";
+            case TPLImageFormat::RGB5A3: return "RGB5A3";
+            case TPLImageFormat::RGBA32: return "RGBA32";
+            case TPLImageFormat::C4:     return "C4";
+            case TPLImageFormat::C8:     return "C8";
+            case TPLImageFormat::C14X2:  return "C14X2";
+            case TPLImageFormat::CMPR:   return "CMPR";
+            case TPLImageFormat::Auto:   return "Auto";
+        }
 
-        // Debugging
-        const std::string formatNames[] = {
-            "I4",
-            "I8",
-            "IA4",
-            "IA8",
-            "RGB565",
-            "RGB5A3",
-            "RGBA32",
-            "Reserved",
-            "Reserved",
-            "C4",
-            "C8",
-            "C14X2",
-            "Reserved",
-            "Reserved",
-            "CMPR",
+        return "Reserved";
+    }
+
+    bool TPL::IsPaletteFormat(TPLImageFormat format)
+    {
+        return format == TPLImageFormat::C4 || format == TPLImageFormat::C8 || format == TPLImageFormat::C14X2;
+    }
+
+    bool TPL::TryParseFormatName(const std::string& name, TPLImageFormat& format)
+    {
+        const TPLImageFormat formats[] = {
+            TPLImageFormat::I4, TPLImageFormat::I8, TPLImageFormat::IA4, TPLImageFormat::IA8,
+            TPLImageFormat::RGB565, TPLImageFormat::RGB5A3, TPLImageFormat::RGBA32,
+            TPLImageFormat::C4, TPLImageFormat::C8, TPLImageFormat::C14X2, TPLImageFormat::CMPR, TPLImageFormat::Auto,
         };
 
-        // Get the number of blocks on each axis
-        int numBlocksX = imageHeader.width / blockWidth + (imageHeader.width % blockWidth > 0 ? 1 : 0);
-        int numBlocksY = imageHeader.height / blockHeight + (imageHeader.height % blockHeight > 0 ? 1 : 0);
+        for (TPLImageFormat candidate : formats) {
+            if (name == GetFormatName(candidate)) {
+                format = candidate;
+                return true;
+            }
+        }
+
+        return false;
+    }
 
-        std::vector<Color> pixels(imageHeader.width * imageHeader.height);
-        for (int blockY = 0; blockY < numBlocksY; blockY++) {
-            for (int blockX = 0; blockX < numBlocksX; blockX++) {
-                const std::vector<Color>& blockColors = ReadBlock(data, imageHeader, blockX * blockWidth, blockY * blockHeight);
+    // ---------------- /
+    // Block decoders
+    // Each decoder reads exactly one block and writes it to output, where stride is the width in pixels of the output rows.
+    // ---------------- /
 
-                if (imageHeader.format == TPLImageFormat::RGBA32)
-                    data += 64;
-                else data += 32;
+    static inline u16 ReadU16(const u8* data) {
+        return (u16)((data[0] << 8) | data[1]);
+    }
 
-                for (int y = 0, i = 0; y < blockHeight; y++) {
-                    for (int x = 0; x < blockWidth; x++) {
-                        // Get the next pixel's global position
-                        int xPos = x + blockX * blockWidth;
-                        int yPos = y + blockY * blockHeight;
-                        int pixelIndex = xPos + yPos * imageHeader.width; // Calculate the pixel index from this
+    static inline Color ReadRGB565(u16 val)
+    {
+        u8 r = (val >> 11) & 0x1f;
+        u8 g = (val >> 5) & 0x3f;
+        u8 b = (val >> 0) & 0x1f;
+
+        return Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0xff);
+    }
 
-                        if (xPos >= imageHeader.width || yPos >= imageHeader.height)
-                            continue;
+    static inline Color ReadRGB5A3(u16 val)
+    {
+        if ((val >> 0xf) == 0) // has alpha encoding
+        {
+            u8 a = (val >> 12) & 0x7;
+            u8 r = (val >> 8) & 0xf;
+            u8 g = (val >> 4) & 0xf;
+            u8 b = (val >> 0) & 0xf;
 
-                        // Read the pixels into the array
-                        /*int blockIndex = x + y * blockWidth;*/
-                        pixels[pixelIndex] = blockColors[i++];
+            return Color(r * 0x11, g * 0x11, b * 0x11, (a << 5) | (a << 2) | (a >> 1));
+        }
 
-                    }
-                }
+        u8 r = (val >> 10) & 0x1f;
+        u8 g = (val >> 5) & 0x1f;
+        u8 b = (val >> 0) & 0x1f;
+
+        return Color((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), 0xff);
+    }
+
+    static void DecodeI4Block(const u8* data, Color* output, int stride)
+    {
+        for (int y = 0; y < 8; y++, output += stride) {
+            for (int x = 0; x < 8; x += 2) {
+                u8 val = *data++;
+                u8 a = (val >> 4) * 0x11;
+                u8 b = (val & 0xf) * 0x11;
+
+                output[x + 0] = Color(a, a, a, 0xff);
+                output[x + 1] = Color(b, b, b, 0xff);
             }
         }
+    }
 
-        return pixels;
+    static void DecodeI8Block(const u8* data, Color* output, int stride)
+    {
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 8; x++) {
+                u8 col = *data++;
+                output[x] = Color(col, col, col, 0xff);
+            }
+        }
+    }
+
+    static void DecodeIA4Block(const u8* data, Color* output, int stride)
+    {
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 8; x++) {
+                u8 val = *data++;
+                u8 col = (val & 0xf) * 0x11;
+                u8 alpha = (val >> 4) * 0x11;
+
+                output[x] = Color(col, col, col, alpha);
+            }
+        }
     }
 
-    std::vector<Color> TPL::ReadBlock(const u8* data, ImageHeader header, int xPos, int yPos)
+    static void DecodeIA8Block(const u8* data, Color* output, int stride)
     {
-        // Special cases for formats that hurt my soul
-        switch (header.format)
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 4; x++, data += 2) {
+                u8 alpha = data[0];
+                u8 col = data[1];
+
+                output[x] = Color(col, col, col, alpha);
+            }
+        }
+    }
+
+    static void DecodeRGB565Block(const u8* data, Color* output, int stride)
+    {
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 4; x++, data += 2) {
+                output[x] = ReadRGB565(ReadU16(data));
+            }
+        }
+    }
+
+    static void DecodeRGB5A3Block(const u8* data, Color* output, int stride)
+    {
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 4; x++, data += 2) {
+                output[x] = ReadRGB5A3(ReadU16(data));
+            }
+        }
+    }
+
+    static void DecodeRGBA32Block(const u8* data, Color* output, int stride)
+    {
+        // The block is split into two 32 byte planes, the first holds AR pairs and the second GB pairs
+        for (int y = 0, i = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 4; x++, i++) {
+                const u8* ptr = data + i * 2;
+                output[x] = Color(ptr[1], ptr[32], ptr[33], ptr[0]);
+            }
+        }
+    }
+
+    // Builds the 4 color palette of a CMPR (DXT1) sub block from its two RGB565 endpoints
+    static inline void BuildCMPRPalette(const u8* data, Color palette[4])
+    {
+        u16 aVal = ReadU16(data);
+        u16 bVal = ReadU16(data + 2);
+        Color a = ReadRGB565(aVal);
+        Color b = ReadRGB565(bVal);
+
+        palette[0] = a;
+        palette[1] = b;
+
+        if (aVal > bVal)
         {
-            default:
-                break;
-            case TPLImageFormat::RGBA32: 
-                {
-                    return ReadRGBA32Block(data);
-                }
-            case TPLImageFormat::CMPR:
-                {
-                    return ReadCMPRBlock(data);
+            palette[2] = Color(((a.r << 1) + b.r) / 3,
+                                ((a.g << 1) + b.g) / 3,
+                                ((a.b << 1) + b.b) / 3,
+                                0xff);
+            palette[3] = Color(((b.r << 1) + a.r) / 3,
+                               ((b.g << 1) + a.g) / 3,
+                               ((b.b << 1) + a.b) / 3,
+                                 0xff);
+        }
+        else
+        {
+            palette[2] = Color((a.r + b.r) / 2, (a.g + b.g) / 2, (a.b + b.b) / 2, 0xff);
+            palette[3] = Color(0,0,0,0);
+        }
+    }
+
+    static void DecodeCMPRBlock(const u8* data, Color* output, int stride)
+    {
+        // 8x8 blocks made of 4 DXT1 4x4 sub blocks ordered top left, top right, bottom left, bottom right
+        for (int subY = 0; subY < 2; subY++) {
+            for (int subX = 0; subX < 2; subX++, data += 8) {
+                Color palette[4];
+                BuildCMPRPalette(data, palette);
+
+                // Each row is one byte of 2 bit indices, leftmost pixel in the highest bits
+                Color* subBlock = output + subX * 4 + subY * 4 * stride;
+                for (int y = 0; y < 4; y++, subBlock += stride) {
+                    u8 row = data[4 + y];
+                    subBlock[0] = palette[(row >> 6) & 0x3];
+                    subBlock[1] = palette[(row >> 4) & 0x3];
+                    subBlock[2] = palette[(row >> 2) & 0x3];
+                    subBlock[3] = palette[(row >> 0) & 0x3];
                 }
+            }
         }
+    }
 
-        // Other generic cases
-        int blockWidth;
-        int blockHeight;
-        GetBlockSize(header.format, blockWidth, blockHeight);
+    // ---------------- /
+    // Palette block decoders
+    // Same as the block decoders but the block holds indices into palette, which must cover every index the format can store
+    // ---------------- /
 
-        // Go through each block on the x any y axis and read each pixel depending on the format
-        // I should probably move the switch to a seperate function, the indents hurt my eyes and soul
-        std::vector<Color> pixels;
-        // pixels.resize(blockWidth * blockHeight);
-        for (int y = 0, i = 0; y < blockHeight; y++) {
-            for (int x = 0; x < blockWidth; x++) {
-                if (x + xPos >= header.width || y + yPos >= header.height)
-                    continue;
+    typedef void (*PaletteBlockDecoder)(const u8* data, const Color* palette, Color* output, int stride);
 
-                switch (header.format)
-                {
-                    default:
-                        break;
-
-                    case TPLImageFormat::I4:
-                        {
-                            u8 val = data[i++];
-                            u8 a = (data[val] & 0xf) * 0x11;
-                            u8 b = (data[val] >> 4) * 0x11;
-
-                            pixels.push_back(Color(a,a,a,0xff));
-                            pixels.push_back(Color(b,b,b,0xff));
-                            break;
-                        }
-                    case TPLImageFormat::I8:
-                        {
-                            u8 col = data[i++];
-
-                            pixels.push_back(Color(col,col,col,0xff));
-                            break;
-                        }
-                    case TPLImageFormat::IA4:
-                        {
-                            u8 val = data[i++];
-                            u8 col = (val & 0xf) * 0x11;
-                            u8 alpha = ((val >> 4) & 0xf) * 0x11;
-
-                            pixels.push_back(Color(col,col,col, alpha));
-                            break;
-                        }
-                    case TPLImageFormat::IA8:
-                        {
-                            u8 alpha = data[i++];
-                            u8 col = data[i++];
-
-                            pixels.push_back(Color(col,col,col, alpha));
-                            break;
-                        }
-                    case TPLImageFormat::RGB565:
-                        {
-                            u16 val = ByteSwap(*(u16*)(data + i));
-                            u8 r = (val >> 11) * 0x8;
-                            u8 g = (val >> 5) * 0x4;
-                            u8 b = (val >> 0) * 0x8;
-
-                            pixels.push_back(Color(r,g,b,0xff));
-                            i += 2;
-                            break;
-                        }
-                    case TPLImageFormat::RGB5A3:
-                        {
-                            u16 val = ByteSwap(*(u16*)(data + i));
-                            if ((val >> 0xf) == 0) // has alpha encoding
-                            {
-                                u8 a = ((val >> 12) & 0x7) * 0x20;
-                                u8 r = ((val >> 8) & 0xf) * 0x11;
-                                u8 g = ((val >> 4) & 0xf) * 0x11;
-                                u8 b = ((val >> 0) & 0xf) * 0x11;
-
-                                pixels.push_back(Color(r,g,b,a));
-                            }
-                            else // No alpha
-                            {
-                                u8 r = ((val >> 10) & 0x1f) * 0x8;
-                                u8 g = ((val >> 5) & 0x1f) * 0x8;
-                                u8 b = ((val >> 0) & 0x1f) * 0x8;
-
-                                pixels.push_back(Color(r,g,b,0xff));
-                            }
-
-                            i += 2;
-                            break;
-                        }
-                    case TPLImageFormat::C4:
-                        {
-                        }
-                    case TPLImageFormat::C8:
-                        {
-                        }
-                    case TPLImageFormat::C14X2:
-                        {
-                        }
+    static void DecodeC4Block(const u8* data, const Color* palette, Color* output, int stride)
+    {
+        for (int y = 0; y < 8; y++, output += stride) {
+            for (int x = 0; x < 8; x += 2) {
+                u8 val = *data++;
+                output[x + 0] = palette[val >> 4];
+                output[x + 1] = palette[val & 0xf];
+            }
+        }
+    }
 
-                }
+    static void DecodeC8Block(const u8* data, const Color* palette, Color* output, int stride)
+    {
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 8; x++) {
+                output[x] = palette[*data++];
             }
         }
-        return pixels;
     }
 
-    Color ReadRGB565(u16 val)
+    static void DecodeC14X2Block(const u8* data, const Color* palette, Color* output, int stride)
+    {
+        for (int y = 0; y < 4; y++, output += stride) {
+            for (int x = 0; x < 4; x++, data += 2) {
+                output[x] = palette[ReadU16(data) & 0x3fff];
+            }
+        }
+    }
+
+    static PaletteBlockDecoder GetPaletteBlockDecoder(TPLImageFormat format)
+    {
+        switch (format)
+        {
+            case TPLImageFormat::C4:    return DecodeC4Block;
+            case TPLImageFormat::C8:    return DecodeC8Block;
+            case TPLImageFormat::C14X2: return DecodeC14X2Block;
+            default:                    return nullptr;
+        }
+    }
+
+#ifdef SPME_X86
+    // ---------------- /
+    // SIMD block decoders
+    // These must produce exactly the same output as the scalar decoders above, which act as the reference.
+    // Colors are built as little endian u32s, r | g << 8 | b << 16 | a << 24, which is the memory layout of Color.
+    // ---------------- /
+
+    // Swaps the bytes of every u16 in a 128 bit lane
+    static const u8 s_ByteSwap16Shuffle[16] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 };
+    // Turns ARGB byte order into RGBA
+    static const u8 s_ARGBToRGBAShuffle[16] = { 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12 };
+
+    // For every CMPR row byte, the pshufb control that gathers its 4 palette entries from a 16 byte palette
+    struct CMPRShuffleTable {
+        alignas(16) u8 controls[256][16];
+
+        CMPRShuffleTable() {
+            for (int row = 0; row < 256; row++) {
+                for (int x = 0; x < 4; x++) {
+                    int index = (row >> (6 - x * 2)) & 0x3;
+                    for (int channel = 0; channel < 4; channel++) {
+                        controls[row][x * 4 + channel] = index * 4 + channel;
+                    }
+                }
+            }
+        }
+    };
+
+    static const CMPRShuffleTable s_CMPRShuffleTable;
+
+    SPME_TARGET("sse4.1")
+    static inline __m128i ExpandRGB565_SSE41(__m128i v)
     {
-        u8 r = (val >> 11) * 0x8;
-        u8 g = (val >> 5) * 0x4;
-        u8 b = (val >> 0) * 0x8;
+        const __m128i mask5 = _mm_set1_epi32(0x1f);
+        const __m128i mask6 = _mm_set1_epi32(0x3f);
 
-        return Color(r,g,b,0xff);
+        __m128i r = _mm_and_si128(_mm_srli_epi32(v, 11), mask5);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), mask6);
+        __m128i b = _mm_and_si128(v, mask5);
+
+        r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+        g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+        b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+
+        __m128i color = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+        color = _mm_or_si128(color, _mm_slli_epi32(b, 16));
+        return _mm_or_si128(color, _mm_set1_epi32((int)0xff000000));
+    }
+
+    SPME_TARGET("sse4.1")
+    static inline __m128i ExpandRGB5A3_SSE41(__m128i v)
+    {
+        const __m128i mask3 = _mm_set1_epi32(0x7);
+        const __m128i mask4 = _mm_set1_epi32(0xf);
+        const __m128i mask5 = _mm_set1_epi32(0x1f);
+        const __m128i mul17 = _mm_set1_epi32(0x11);
+
+        // Opaque encoding, 5 bits per color
+        __m128i r5 = _mm_and_si128(_mm_srli_epi32(v, 10), mask5);
+        __m128i g5 = _mm_and_si128(_mm_srli_epi32(v, 5), mask5);
+        __m128i b5 = _mm_and_si128(v, mask5);
+        r5 = _mm_or_si128(_mm_slli_epi32(r5, 3), _mm_srli_epi32(r5, 2));
+        g5 = _mm_or_si128(_mm_slli_epi32(g5, 3), _mm_srli_epi32(g5, 2));
+        b5 = _mm_or_si128(_mm_slli_epi32(b5, 3), _mm_srli_epi32(b5, 2));
+        __m128i opaque = _mm_or_si128(r5, _mm_slli_epi32(g5, 8));
+        opaque = _mm_or_si128(opaque, _mm_slli_epi32(b5, 16));
+        opaque = _mm_or_si128(opaque, _mm_set1_epi32((int)0xff000000));
+
+        // Alpha encoding, 3 bits of alpha and 4 bits per color
+        __m128i a3 = _mm_and_si128(_mm_srli_epi32(v, 12), mask3);
+        __m128i r4 = _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(v, 8), mask4), mul17);
+        __m128i g4 = _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(v, 4), mask4), mul17);
+        __m128i b4 = _mm_mullo_epi32(_mm_and_si128(v, mask4), mul17);
+        a3 = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(a3, 5), _mm_slli_epi32(a3, 2)), _mm_srli_epi32(a3, 1));
+        __m128i translucent = _mm_or_si128(r4, _mm_slli_epi32(g4, 8));
+        translucent = _mm_or_si128(translucent, _mm_slli_epi32(b4, 16));
+        translucent = _mm_or_si128(translucent, _mm_slli_epi32(a3, 24));
+
+        // The top bit selects the encoding
+        __m128i isOpaque = _mm_srai_epi32(_mm_slli_epi32(v, 16), 31);
+        return _mm_blendv_epi8(translucent, opaque, isOpaque);
     }
 
-    std::vector<Color> TPL::ReadRGBA32Block(const u8* data)
+    SPME_TARGET("sse4.1")
+    static void DecodeRGB565Block_SSE41(const u8* data, Color* output, int stride)
     {
-        std::vector<Color> colors(16);
-        for (int i = 0; i < 16; i++) {
-            const u8* ptr = data + i * 2;
-            colors[i] = Color(ptr[1], ptr[33], ptr[34], ptr[0]);
+        const __m128i byteSwap = _mm_loadu_si128((const __m128i*)s_ByteSwap16Shuffle);
+        for (int y = 0; y < 4; y++, data += 8, output += stride) {
+            __m128i raw = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)data), byteSwap);
+            _mm_storeu_si128((__m128i*)output, ExpandRGB565_SSE41(_mm_cvtepu16_epi32(raw)));
         }
+    }
 
-        return colors;
+    SPME_TARGET("sse4.1")
+    static void DecodeRGB5A3Block_SSE41(const u8* data, Color* output, int stride)
+    {
+        const __m128i byteSwap = _mm_loadu_si128((const __m128i*)s_ByteSwap16Shuffle);
+        for (int y = 0; y < 4; y++, data += 8, output += stride) {
+            __m128i raw = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)data), byteSwap);
+            _mm_storeu_si128((__m128i*)output, ExpandRGB5A3_SSE41(_mm_cvtepu16_epi32(raw)));
+        }
     }
 
-    std::vector<Color> TPL::ReadCMPRBlock(const u8* data)
+    SPME_TARGET("sse4.1")
+    static void DecodeRGBA32Block_SSE41(const u8* data, Color* output, int stride)
     {
-        std::vector<Color> pixels(64);
-        for (size_t i = 0; i < pixels.size(); i++) {
-           pixels[i] = Color(255, 0, 255, 255); 
+        // Interleaving the AR and GB planes gives ARGB which is then reordered to RGBA
+        const __m128i toRGBA = _mm_loadu_si128((const __m128i*)s_ARGBToRGBAShuffle);
+        for (int y = 0; y < 4; y += 2, data += 16, output += stride * 2) {
+            __m128i ar = _mm_loadu_si128((const __m128i*)data);
+            __m128i gb = _mm_loadu_si128((const __m128i*)(data + 32));
+
+            _mm_storeu_si128((__m128i*)output, _mm_shuffle_epi8(_mm_unpacklo_epi16(ar, gb), toRGBA));
+            _mm_storeu_si128((__m128i*)(output + stride), _mm_shuffle_epi8(_mm_unpackhi_epi16(ar, gb), toRGBA));
         }
-        for (int subY = 0, dataOffset = 0; subY < 2; subY++) {
-            for (int subX = 0; subX < 2; subX++, dataOffset += 8) {
-                // Read the pixels
-                u16 aVal = ByteSwap(*(u16*)(data + dataOffset));
-                u16 bVal = ByteSwap(*(u16*)(data + dataOffset + 2));
-                Color a = ReadRGB565(aVal);
-                Color b = ReadRGB565(bVal);
+    }
 
-                // Calculate palette
+    SPME_TARGET("sse4.1")
+    static void DecodeCMPRBlock_SSE41(const u8* data, Color* output, int stride)
+    {
+        for (int subY = 0; subY < 2; subY++) {
+            for (int subX = 0; subX < 2; subX++, data += 8) {
                 Color palette[4];
-                palette[0] = a;
-                palette[1] = b;
-
-                if (aVal > bVal)
-                {
-                    palette[2] = Color(((a.r << 1) + b.r) / 3,
-                                        ((a.g << 1) + b.g) / 3,
-                                        ((a.b << 1) + b.b) / 3,
-                                        0xff);
-                    palette[3] = Color(((b.r << 1) + a.r) / 3,
-                                       ((b.g << 1) + a.g) / 3,
-                                       ((b.b << 1) + a.b) / 3,
-                                         0xff);
-                }
-                else
-                {
-                    palette[2] = Color((a.r + b.r) / 2, (a.g + b.g) / 2, (a.b + b.b) / 2, 0xff);
-                    palette[3] = Color(0,0,0,0);
+                BuildCMPRPalette(data, palette);
+                __m128i paletteVector = _mm_loadu_si128((const __m128i*)palette);
+
+                Color* subBlock = output + subX * 4 + subY * 4 * stride;
+                for (int y = 0; y < 4; y++, subBlock += stride) {
+                    __m128i control = _mm_load_si128((const __m128i*)s_CMPRShuffleTable.controls[data[4 + y]]);
+                    _mm_storeu_si128((__m128i*)subBlock, _mm_shuffle_epi8(paletteVector, control));
                 }
+            }
+        }
+    }
 
-                u32 pixelData = ByteSwap(*(u32*)(data + dataOffset + 4));
+    SPME_TARGET("avx2")
+    static inline __m256i ExpandRGB565_AVX2(__m256i v)
+    {
+        const __m256i mask5 = _mm256_set1_epi32(0x1f);
+        const __m256i mask6 = _mm256_set1_epi32(0x3f);
 
-                for (int i = 0; i < 16; i++) {
-                    int index = (pixelData >> (2 * (15 - i))) & 0x3;
-                    int x = i % 4;
-                    int y = i / 4;
-                    int pixelIndex = subX * 4 + x + (subY * 4 + y) * 8;
-                    pixels[pixelIndex] = palette[index];
-                }
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(v, 11), mask5);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 5), mask6);
+        __m256i b = _mm256_and_si256(v, mask5);
+
+        r = _mm256_or_si256(_mm256_slli_epi32(r, 3), _mm256_srli_epi32(r, 2));
+        g = _mm256_or_si256(_mm256_slli_epi32(g, 2), _mm256_srli_epi32(g, 4));
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 3), _mm256_srli_epi32(b, 2));
+
+        __m256i color = _mm256_or_si256(r, _mm256_slli_epi32(g, 8));
+        color = _mm256_or_si256(color, _mm256_slli_epi32(b, 16));
+        return _mm256_or_si256(color, _mm256_set1_epi32((int)0xff000000));
+    }
+
+    SPME_TARGET("avx2")
+    static inline __m256i ExpandRGB5A3_AVX2(__m256i v)
+    {
+        const __m256i mask3 = _mm256_set1_epi32(0x7);
+        const __m256i mask4 = _mm256_set1_epi32(0xf);
+        const __m256i mask5 = _mm256_set1_epi32(0x1f);
+        const __m256i mul17 = _mm256_set1_epi32(0x11);
+
+        __m256i r5 = _mm256_and_si256(_mm256_srli_epi32(v, 10), mask5);
+        __m256i g5 = _mm256_and_si256(_mm256_srli_epi32(v, 5), mask5);
+        __m256i b5 = _mm256_and_si256(v, mask5);
+        r5 = _mm256_or_si256(_mm256_slli_epi32(r5, 3), _mm256_srli_epi32(r5, 2));
+        g5 = _mm256_or_si256(_mm256_slli_epi32(g5, 3), _mm256_srli_epi32(g5, 2));
+        b5 = _mm256_or_si256(_mm256_slli_epi32(b5, 3), _mm256_srli_epi32(b5, 2));
+        __m256i opaque = _mm256_or_si256(r5, _mm256_slli_epi32(g5, 8));
+        opaque = _mm256_or_si256(opaque, _mm256_slli_epi32(b5, 16));
+        opaque = _mm256_or_si256(opaque, _mm256_set1_epi32((int)0xff000000));
+
+        __m256i a3 = _mm256_and_si256(_mm256_srli_epi32(v, 12), mask3);
+        __m256i r4 = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask4), mul17);
+        __m256i g4 = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 4), mask4), mul17);
+        __m256i b4 = _mm256_mullo_epi32(_mm256_and_si256(v, mask4), mul17);
+        a3 = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(a3, 5), _mm256_slli_epi32(a3, 2)), _mm256_srli_epi32(a3, 1));
+        __m256i translucent = _mm256_or_si256(r4, _mm256_slli_epi32(g4, 8));
+        translucent = _mm256_or_si256(translucent, _mm256_slli_epi32(b4, 16));
+        translucent = _mm256_or_si256(translucent, _mm256_slli_epi32(a3, 24));
+
+        __m256i isOpaque = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 31);
+        return _mm256_blendv_epi8(translucent, opaque, isOpaque);
+    }
+
+    SPME_TARGET("avx2")
+    static void DecodeRGB565Block_AVX2(const u8* data, Color* output, int stride)
+    {
+        // Two rows (8 pixels) per iteration
+        const __m128i byteSwap = _mm_loadu_si128((const __m128i*)s_ByteSwap16Shuffle);
+        for (int y = 0; y < 4; y += 2, data += 16, output += stride * 2) {
+            __m128i raw = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), byteSwap);
+            __m256i colors = ExpandRGB565_AVX2(_mm256_cvtepu16_epi32(raw));
+            _mm_storeu_si128((__m128i*)output, _mm256_castsi256_si128(colors));
+            _mm_storeu_si128((__m128i*)(output + stride), _mm256_extracti128_si256(colors, 1));
+        }
+    }
+
+    SPME_TARGET("avx2")
+    static void DecodeRGB5A3Block_AVX2(const u8* data, Color* output, int stride)
+    {
+        const __m128i byteSwap = _mm_loadu_si128((const __m128i*)s_ByteSwap16Shuffle);
+        for (int y = 0; y < 4; y += 2, data += 16, output += stride * 2) {
+            __m128i raw = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), byteSwap);
+            __m256i colors = ExpandRGB5A3_AVX2(_mm256_cvtepu16_epi32(raw));
+            _mm_storeu_si128((__m128i*)output, _mm256_castsi256_si128(colors));
+            _mm_storeu_si128((__m128i*)(output + stride), _mm256_extracti128_si256(colors, 1));
+        }
+    }
+
+    SPME_TARGET("avx2")
+    static void DecodeRGBA32Block_AVX2(const u8* data, Color* output, int stride)
+    {
+        // Each 128 bit lane holds two rows of a plane, so lane 0 produces rows 0/1 and lane 1 rows 2/3
+        const __m256i toRGBA = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)s_ARGBToRGBAShuffle));
+        __m256i ar = _mm256_loadu_si256((const __m256i*)data);
+        __m256i gb = _mm256_loadu_si256((const __m256i*)(data + 32));
+
+        __m256i evenRows = _mm256_shuffle_epi8(_mm256_unpacklo_epi16(ar, gb), toRGBA);
+        __m256i oddRows = _mm256_shuffle_epi8(_mm256_unpackhi_epi16(ar, gb), toRGBA);
+
+        _mm_storeu_si128((__m128i*)(output + stride * 0), _mm256_castsi256_si128(evenRows));
+        _mm_storeu_si128((__m128i*)(output + stride * 1), _mm256_castsi256_si128(oddRows));
+        _mm_storeu_si128((__m128i*)(output + stride * 2), _mm256_extracti128_si256(evenRows, 1));
+        _mm_storeu_si128((__m128i*)(output + stride * 3), _mm256_extracti128_si256(oddRows, 1));
+    }
+
+    SPME_TARGET("avx2")
+    static void DecodeCMPRBlock_AVX2(const u8* data, Color* output, int stride)
+    {
+        // The left and right sub blocks share rows, so each 8 pixel row is one shuffle with a palette per lane
+        for (int subY = 0; subY < 2; subY++, data += 16) {
+            Color leftPalette[4];
+            Color rightPalette[4];
+            BuildCMPRPalette(data, leftPalette);
+            BuildCMPRPalette(data + 8, rightPalette);
+            __m256i palettes = _mm256_loadu2_m128i((const __m128i*)rightPalette, (const __m128i*)leftPalette);
+
+            Color* row = output + subY * 4 * stride;
+            for (int y = 0; y < 4; y++, row += stride) {
+                __m256i control = _mm256_loadu2_m128i((const __m128i*)s_CMPRShuffleTable.controls[data[12 + y]],
+                                                      (const __m128i*)s_CMPRShuffleTable.controls[data[4 + y]]);
+                _mm256_storeu_si256((__m256i*)row, _mm256_shuffle_epi8(palettes, control));
             }
         }
+    }
+#endif
 
-        return pixels;
+    // Palette formats need the palette to decode, so fill with magenta to make them obvious.
+    // Sized to the format's block, the edge blocks ReadImageInto clips to the image are decoded to a buffer of that size
+    template<int BlockWidth, int BlockHeight>
+    static void DecodeUnsupportedBlock(const u8*, Color* output, int stride)
+    {
+        for (int y = 0; y < BlockHeight; y++, output += stride) {
+            for (int x = 0; x < BlockWidth; x++) {
+                output[x] = Color(255, 0, 255, 255);
+            }
+        }
+    }
+
+    TPL::BlockDecoder TPL::GetBlockDecoder(TPLImageFormat format, DecoderBackend backend)
+    {
+        if (backend == DecoderBackend::Best) {
+            backend = cpu_has_avx2() ? DecoderBackend::AVX2 : cpu_has_sse41() ? DecoderBackend::SSE41 : DecoderBackend::Scalar;
+        }
+
+#ifdef SPME_X86
+        if (backend == DecoderBackend::AVX2 && cpu_has_avx2()) {
+            switch (format)
+            {
+                case TPLImageFormat::RGB565: return DecodeRGB565Block_AVX2;
+                case TPLImageFormat::RGB5A3: return DecodeRGB5A3Block_AVX2;
+                case TPLImageFormat::RGBA32: return DecodeRGBA32Block_AVX2;
+                case TPLImageFormat::CMPR:   return DecodeCMPRBlock_AVX2;
+                default: break;
+            }
+        }
+
+        if ((backend == DecoderBackend::AVX2 || backend == DecoderBackend::SSE41) && cpu_has_sse41()) {
+            switch (format)
+            {
+                case TPLImageFormat::RGB565: return DecodeRGB565Block_SSE41;
+                case TPLImageFormat::RGB5A3: return DecodeRGB5A3Block_SSE41;
+                case TPLImageFormat::RGBA32: return DecodeRGBA32Block_SSE41;
+                case TPLImageFormat::CMPR:   return DecodeCMPRBlock_SSE41;
+                default: break;
+            }
+        }
+#endif
+
+        // Scalar fallback, also used for formats without a SIMD implementation
+        switch (format)
+        {
+            case TPLImageFormat::I4:     return DecodeI4Block;
+            case TPLImageFormat::I8:     return DecodeI8Block;
+            case TPLImageFormat::IA4:    return DecodeIA4Block;
+            case TPLImageFormat::IA8:    return DecodeIA8Block;
+            case TPLImageFormat::RGB565: return DecodeRGB565Block;
+            case TPLImageFormat::RGB5A3: return DecodeRGB5A3Block;
+            case TPLImageFormat::RGBA32: return DecodeRGBA32Block;
+            case TPLImageFormat::CMPR:   return DecodeCMPRBlock;
+            default:
+                int blockWidth;
+                int blockHeight;
+                GetBlockSize(format, blockWidth, blockHeight);
+                if (blockWidth == 8 && blockHeight == 8)
+                    return DecodeUnsupportedBlock<8, 8>;
+                if (blockWidth == 8)
+                    return DecodeUnsupportedBlock<8, 4>;
+                return DecodeUnsupportedBlock<4, 4>;
+        }
+    }
+
+    std::vector<Color> TPL::ReadPalette(const u8* data, const PaletteHeader& paletteHeader, TPLImageFormat imageFormat)
+    {
+        // Size the palette to cover every index the image format can hold so out of range indices read magenta instead of garbage
+        u32 indexCount = imageFormat == TPLImageFormat::C4 ? 0x10 : imageFormat == TPLImageFormat::C8 ? 0x100 : 0x4000;
+        std::vector<Color> palette(std::max<u32>(indexCount, paletteHeader.entryCount), Color(0xff, 0, 0xff, 0xff));
+
+        const u8* entries = data + paletteHeader.dataOffset;
+        for (u32 i = 0; i < paletteHeader.entryCount; i++, entries += 2) {
+            u16 val = ReadU16(entries);
+            switch (paletteHeader.format)
+            {
+                case TPLPaletteFormat::IA8:
+                    palette[i] = Color(entries[1], entries[1], entries[1], entries[0]);
+                    break;
+                case TPLPaletteFormat::RGB565:
+                    palette[i] = ReadRGB565(val);
+                    break;
+                case TPLPaletteFormat::RGB5A3:
+                    palette[i] = ReadRGB5A3(val);
+                    break;
+                default:
+                    LogWarn("Unknown TPL palette format %u", (u32)paletteHeader.format);
+                    return palette;
+            }
+        }
+
+        return palette;
+    }
+
+    void TPL::DecodeImage(const u8* data, int width, int height, TPLImageFormat format, Color* output, const Color* palette)
+    {
+        ImageHeader header = {};
+        header.width = width;
+        header.height = height;
+        header.format = format;
+        ReadImageInto(data, header, output, palette);
+    }
+
+    void TPL::ReadImageInto(const u8* data, const ImageHeader& imageHeader, Color* output, const Color* palette, int firstBlockRow, int blockRowCount)
+    {
+        int blockWidth;
+        int blockHeight;
+        GetBlockSize(imageHeader.format, blockWidth, blockHeight);
+        const u32 blockByteSize = GetBlockByteSize(imageHeader.format);
+
+        // Palette formats without a palette fall through to the magenta decoder
+        const PaletteBlockDecoder paletteDecoder = palette ? GetPaletteBlockDecoder(imageHeader.format) : nullptr;
+        const BlockDecoder decoder = paletteDecoder ? nullptr : GetBlockDecoder(imageHeader.format);
+        auto decodeBlock = [&](const u8* block, Color* destination, int stride) {
+            if (paletteDecoder)
+                paletteDecoder(block, palette, destination, stride);
+            else
+                decoder(block, destination, stride);
+        };
+
+        const int width = imageHeader.width;
+        const int height = imageHeader.height;
+
+        // Get the number of blocks on each axis
+        int numBlocksX = (width + blockWidth - 1) / blockWidth;
+        int numBlocksY = (height + blockHeight - 1) / blockHeight;
+
+        // Only decode the requested band of block rows
+        int lastBlockRow = blockRowCount < 0 ? numBlocksY : std::min(numBlocksY, firstBlockRow + blockRowCount);
+        data += (u64)firstBlockRow * numBlocksX * blockByteSize;
+
+        for (int blockY = firstBlockRow; blockY < lastBlockRow; blockY++) {
+            const int yPos = blockY * blockHeight;
+            const int rowCount = std::min(blockHeight, height - yPos);
+
+            for (int blockX = 0; blockX < numBlocksX; blockX++, data += blockByteSize) {
+                const int xPos = blockX * blockWidth;
+                const int columnCount = std::min(blockWidth, width - xPos);
+                Color* destination = output + xPos + yPos * width;
+
+                // Interior blocks are decoded straight into the image
+                if (columnCount == blockWidth && rowCount == blockHeight) {
+                    decodeBlock(data, destination, width);
+                    continue;
+                }
+
+                // Edge blocks are decoded to the stack then only the visible part is copied
+                Color block[64];
+                decodeBlock(data, block, blockWidth);
+                for (int y = 0; y < rowCount; y++) {
+                    memcpy(destination + y * width, block + y * blockWidth, columnCount * sizeof(Color));
+                }
+            }
+        }
     }
 
     TPL TPL::CreateTPL(const TPLCreateInfo& createInfo) {
         std::vector<TPL::Image> images(createInfo.mImageCreateInfoCount);
+        u64 autoSize = 0;
+        u64 autoUncompressedSize = 0; // Totals of the images using TPLImageFormat::Auto
 
         for (size_t i = 0; i < createInfo.mImageCreateInfoCount; i++) {
             TPLImageCreateInfo& info = createInfo.mImageCreateInfos[i];
-            // TODO: Implement more image formats
-            Assert(info.mFormat == TPLImageFormat::RGBA32, "CreateTPL cannot create image, unsupported image format %d. The only supported tpl type is RGBA32.", (int)info.mFormat);
+            Assert(info.mFormat == TPLImageFormat::Auto || TPLEncoder::SupportsFormat(info.mFormat), "CreateTPL cannot create image, unsupported image format %s (%d).", GetFormatName(info.mFormat), (int)info.mFormat);
 
             Image image;
             ImageHeader header = {
@@ -392,12 +960,12 @@ namespace SPMEditor {
                 .imageDataAddress = 0, // HACK: Fix this please otherwise it will not break
                 .wrapS = ImageWrapMode::Repeat,
                 .wrapT = ImageWrapMode::Repeat,
-                .minFilter = 0,
-                .magFilter = 0,
+                .minFilter = (u32)ImageFilter::Near,
+                .magFilter = (u32)ImageFilter::Near,
                 .LODBias = 1.0f,
                 .edgeLODEnable = 1,
                 .minLOD = 0,
-                .maxLOD = 1,
+                .maxLOD = 0,
                 .padding = 0,
             };
 
@@ -405,40 +973,63 @@ namespace SPMEditor {
             images[i] = (TPL::Image) {
                 .header = header,
                 .name = info.mTexture->mFilename.C_Str(),
+                .quality = info.mQuality,
+                .dither = info.mDither,
             };
 
             // Get and write pixels
-            u8* pixelData = (u8*)info.mTexture->pcData;
-            u32 pixelDataSize = header.width * header.height * 4;
-            if (info.mTexture->mHeight == 0) {
-                // texture is compressed
-                int channels = 0;
-                int height = 0;
-                int width = 0;
-                u8* decompressedPixels = stbi_load_from_memory(pixelData, info.mTexture->mWidth, &width, &height, &channels, 4);
-                Assert(pixelData, "Failed to load image %d", i);
-                LogInfo("writing image '%s' with %d channels", info.mTexture->mFilename.C_Str(), channels);
-
-                images[i].header.width = width;
-                images[i].header.height = height;
-                pixelDataSize = width * height * channels;
-
-                // Copy pixel data into image data
-                images[i].pixels.resize(width * height);
-                u8* imagePixelData = (u8*)images[i].pixels.data();
-                // NOTE: This only works because we force the number of channels to 4
-                memcpy(imagePixelData, decompressedPixels, height * width * 4);
-
-                // Free stb image data if the file was compressed
-                stbi_image_free(decompressedPixels);
-            } else {
-                // Copy pixel data into image data
-                images[i].pixels.resize(pixelDataSize / sizeof(Color));
-                memcpy(images[i].pixels.data(), pixelData, pixelDataSize);
-            }
+            int width = 0;
+            int height = 0;
+            images[i].pixels = ReadTexturePixels(info.mTexture, width, height);
+            images[i].header.width = width;
+            images[i].header.height = height;
 
             Assert(images[i].header.height > 0 && images[i].header.width > 0, "Trying to read aiTexture and got invalid size. Height: %d, Width: %d", images[i].header.height, images[i].header.width);
 
+            if (info.mFormat == TPLImageFormat::Auto) {
+                Image& image = images[i];
+                u32 uncompressedSize = GetImageDataSize(TPLImageFormat::RGBA32, image.header.width, image.header.height);
+                TPLFormatChoice choice = TPLEncoder::ChooseFormat(image.pixels.data(), image.header.width, image.header.height, image.quality, image.dither);
+                image.header.format = choice.mFormat;
+
+                autoUncompressedSize += uncompressedSize;
+                autoSize += choice.mSize;
+                LogInfo("Texture '%s' (%ux%u) will be %s: %u bytes, saving %u bytes over RGBA32, PSNR %.2f dB", image.name.c_str(), image.header.width, image.header.height,
+                        GetFormatName(choice.mFormat), choice.mSize, uncompressedSize - choice.mSize, choice.mPSNR);
+            }
+
+            if (info.mGenerateMipmaps) {
+                Image& image = images[i];
+                int mipmapCount = TPLEncoder::GetMipmapCount(image.header.width, image.header.height);
+                if (IsPaletteFormat(image.header.format)) {
+                    LogWarn("Not generating mipmaps for texture '%s', palette formats can't share one palette across levels", image.name.c_str());
+                } else if (mipmapCount == 1) {
+                    LogWarn("Not generating mipmaps for texture '%s', its size %ux%u is not a power of two", image.name.c_str(), image.header.width, image.header.height);
+                } else {
+                    if (info.mMaxMipmapCount > 0)
+                        mipmapCount = std::min(mipmapCount, info.mMaxMipmapCount);
+
+                    int width = image.header.width;
+                    int height = image.header.height;
+                    const std::vector<Color>* level = &image.pixels;
+                    image.mipmaps.reserve(mipmapCount - 1);
+                    for (int j = 1; j < mipmapCount; j++) {
+                        image.mipmaps.push_back(TPLEncoder::Downsample(level->data(), width, height));
+                        level = &image.mipmaps.back();
+                        width = std::max(width / 2, 1);
+                        height = std::max(height / 2, 1);
+                    }
+
+                    image.header.minFilter = (u32)ImageFilter::LinearMipLinear;
+                    image.header.magFilter = (u32)ImageFilter::Linear;
+                    image.header.LODBias = 0.0f;
+                    image.header.maxLOD = mipmapCount - 1;
+                }
+            }
+        }
+
+        if (autoUncompressedSize > 0) {
+            LogInfo("Automatic texture formats use %llu of %llu bytes (%.1f%%)", (unsigned long long)autoSize, (unsigned long long)autoUncompressedSize, 100.0 * autoSize / autoUncompressedSize);
         }
 
         TPL outTpl = {
@@ -448,40 +1039,127 @@ namespace SPMEditor {
         return outTpl;
     }
 
+    std::vector<Color> TPL::ReadTexturePixels(const aiTexture* texture, int& width, int& height) {
+        std::vector<Color> pixels;
+        if (texture->mHeight == 0) {
+            // texture is compressed
+            int channels = 0;
+            u8* decompressedPixels = stbi_load_from_memory((const u8*)texture->pcData, texture->mWidth, &width, &height, &channels, 4);
+            Assert(decompressedPixels, "Failed to load image '%s'", texture->mFilename.C_Str());
+            LogInfo("writing image '%s' with %d channels", texture->mFilename.C_Str(), channels);
+
+            // NOTE: This only works because we force the number of channels to 4
+            pixels.resize(width * height);
+            memcpy(pixels.data(), decompressedPixels, width * height * 4);
+
+            // Free stb image data if the file was compressed
+            stbi_image_free(decompressedPixels);
+        } else {
+            // Uncompressed textures are aiTexels, which are stored BGRA
+            width = texture->mWidth;
+            height = texture->mHeight;
+            pixels.resize(width * height);
+            for (size_t i = 0; i < pixels.size(); i++) {
+                const aiTexel& texel = texture->pcData[i];
+                pixels[i] = Color(texel.r, texel.g, texel.b, texel.a);
+            }
+        }
+
+        return pixels;
+    }
+
+    aiTexture* TPL::CreateTexture(const Image& image) {
+        aiTexture* texture = new aiTexture();
+        texture->mWidth = image.header.width;
+        texture->mHeight = image.header.height;
+        texture->mFilename = aiString(image.name.c_str());
+        memcpy(texture->achFormatHint, "bgra8888", 9);
+
+        texture->pcData = new aiTexel[image.pixels.size()];
+        for (size_t i = 0; i < image.pixels.size(); i++) {
+            const Color& color = image.pixels[i];
+            texture->pcData[i] = { color.b, color.g, color.r, color.a };
+        }
+
+        return texture;
+    }
+
     void TPL::Write(const std::string& path) {
-        std::ofstream outStream(path);
+        // Encode every image first, palette sizes are only known after quantizing
+        std::vector<std::vector<u8>> imageData(images.size());
+        std::vector<TPLPalette> palettes(images.size());
+        parallel_for(images.size(), [&](u32 i) {
+            const TPL::Image& image = images[i];
+            bool hasPalette = IsPaletteFormat(image.header.format);
+            imageData[i] = TPLEncoder::EncodeImage(image.pixels.data(), image.header.width, image.header.height, image.header.format, image.quality, image.dither, hasPalette ? &palettes[i] : nullptr);
+
+            // Mipmap levels follow the base level back to back, each in the same format
+            Assert(!hasPalette || image.mipmaps.empty(), "TPL image '%s' has mipmaps but palette formats can't be mipmapped", image.name.c_str());
+            int width = image.header.width;
+            int height = image.header.height;
+            for (const std::vector<Color>& level : image.mipmaps) {
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+                std::vector<u8> levelData = TPLEncoder::EncodeImage(level.data(), width, height, image.header.format, image.quality);
+                imageData[i].insert(imageData[i].end(), levelData.begin(), levelData.end());
+            }
+        });
+
+        int paletteCount = 0;
+        for (const TPL::Image& image : images) {
+            paletteCount += IsPaletteFormat(image.header.format);
+        }
+
+        // Palette headers go after the image headers, then the data of each image is preceded by its palette
+        int imageTableSize = sizeof(TPL::ImageOffset) * images.size();
+        int imageTableStart = sizeof(TPL::Header) + imageTableSize;
+        int paletteTableStart = imageTableStart + sizeof(TPL::ImageHeader) * images.size();
+
+        int imageDataOffset = paletteTableStart + sizeof(TPL::PaletteHeader) * paletteCount;
+        imageDataOffset += 0x20 - (imageDataOffset % 0x20); // Padding
+
+        std::vector<int> paletteHeaderOffsets(images.size());
+        std::vector<int> paletteDataOffsets(images.size());
+        std::vector<int> imageDataOffsets(images.size());
+        for (size_t i = 0, paletteIndex = 0; i < images.size(); i++) {
+            if (IsPaletteFormat(images[i].header.format)) {
+                paletteHeaderOffsets[i] = paletteTableStart + sizeof(TPL::PaletteHeader) * paletteIndex++;
+                paletteDataOffsets[i] = imageDataOffset;
+                imageDataOffset += (palettes[i].mData.size() + 0x1f) & ~0x1f;
+            }
+
+            imageDataOffsets[i] = imageDataOffset;
+            imageDataOffset += imageData[i].size();
+        }
+
+        // The whole file is built in memory and written at once, padding is left zeroed
+        std::vector<u8> file(imageDataOffset);
+        u8* output = file.data();
 
-        // Create and write header
         TPL::Header header = {
             .magic = ByteSwap(0x0020AF30),
             .numImages = ByteSwap((int)images.size()),
             .imageTableOffset = ByteSwap(0xC),
         };
 
-        outStream.write((const char*)&header, sizeof(TPL::Header));
-
-        // Write the image offset table
-        int imageTableSize = sizeof(TPL::ImageOffset) * images.size();
-        int imageTableStart = sizeof(TPL::Header) + imageTableSize;
+        memcpy(output, &header, sizeof(TPL::Header));
 
         for (size_t i = 0; i < images.size(); i++) {
             TPL::ImageOffset imageOffset = {
                 .headerOffset = ByteSwap((int)(imageTableStart + i * sizeof(TPL::ImageHeader))),
-                .paletteOffset = 0, // TODO: Add palettes
+                .paletteOffset = ByteSwap(paletteHeaderOffsets[i]),
             };
 
-            outStream.write((const char*)&imageOffset, sizeof(TPL::ImageOffset));
+            memcpy(output + sizeof(TPL::Header) + i * sizeof(TPL::ImageOffset), &imageOffset, sizeof(TPL::ImageOffset));
         }
 
-        // Write the image headers
-        int imageDataOffset = sizeof(TPL::Header) + (sizeof(TPL::ImageHeader) + sizeof(TPL::ImageOffset)) * images.size();
-        imageDataOffset += 0x20 - (imageDataOffset % 0x20); // Padding
         for (size_t i = 0; i < images.size(); i++) {
             const TPL::ImageHeader& baseHeader = images[i].header;
             TPL::ImageHeader header = { 
                 .height = ByteSwap(baseHeader.height),
                 .width = ByteSwap(baseHeader.width),
                 .format = (TPLImageFormat)ByteSwap((u32)baseHeader.format),
+                .imageDataAddress = ByteSwap((u32)imageDataOffsets[i]),
                 .wrapS = (ImageWrapMode)ByteSwap((u32)baseHeader.wrapS), // TODO: Add user configured wrap mode
                 .wrapT = (ImageWrapMode)ByteSwap((u32)baseHeader.wrapT), // TODO: Add user configured wrap mode
                 .minFilter = ByteSwap(baseHeader.minFilter),
@@ -495,56 +1173,30 @@ namespace SPMEditor {
 
             Assert(header.height > 0 && header.width > 0, "Trying to write tpl texture %d and got invalid size. Height: %u, Width: %u", i, header.height, header.width);
 
-            header.imageDataAddress = ByteSwap(imageDataOffset);
+            memcpy(output + imageTableStart + i * sizeof(TPL::ImageHeader), &header, sizeof(TPL::ImageHeader));
+        }
 
-            // TODO: this assumes that the color is RGBA. Other formats will break this
-            imageDataOffset += images[i].pixels.size() * sizeof(Color); 
+        for (size_t i = 0; i < images.size(); i++) {
+            if (!IsPaletteFormat(images[i].header.format))
+                continue;
 
-            outStream.write((const char*)&header, sizeof(TPL::ImageHeader));
-        }
+            TPL::PaletteHeader paletteHeader = {
+                .entryCount = palettes[i].mEntryCount,
+                .unpacked = 0,
+                .padding = 0,
+                .format = palettes[i].mFormat,
+                .dataOffset = (u32)paletteDataOffsets[i],
+            };
 
-        // Write padding before first image
-        char paddingBuffer[0x20] = {};
-        int padAmount = 0x20 - (outStream.tellp() % 0x20);
-        outStream.write(paddingBuffer, padAmount);
+            paletteHeader = paletteHeader.SwapBytes();
+            memcpy(output + paletteHeaderOffsets[i], &paletteHeader, sizeof(TPL::PaletteHeader));
+            memcpy(output + paletteDataOffsets[i], palettes[i].mData.data(), palettes[i].mData.size());
+        }
 
-        // Now write all the pixels
         for (size_t i = 0; i < images.size(); i++) {
-            TPL::Image& image = images[i];
-            int blockXCount = image.header.width / 4;
-            int blockYCount = image.header.height / 4;
-            for (int blockY = 0; blockY < blockYCount; blockY++) {
-                for (int blockX = 0; blockX < blockXCount; blockX++) {
-                    u8 pixelBuffer[64];
-                    u32 pixelBufferOffset = 0;
-                    for (int y = 0; y < 4; y++) {
-                        for (int x = 0; x < 4; x++) {
-                            // Write A then R
-                            size_t pixelIndex = x + blockX * 4 + (y + blockY * 4) * image.header.width;
-                            Assert(pixelIndex < image.pixels.size(), "TPLWrite() trying to read image pixel from out of bounds index");
-                            Color color = image.pixels[pixelIndex];
-
-                            pixelBuffer[pixelBufferOffset++] = color.a;
-                            pixelBuffer[pixelBufferOffset++] = color.r;
-                        }
-                    }
-                    for (int y = 0; y < 4; y++) {
-                        for (int x = 0; x < 4; x++) {
-                            size_t pixelIndex = x + blockX * 4 + (y + blockY * 4) * image.header.width;
-                            Assert(pixelIndex < image.pixels.size(), "TPLWrite() trying to read image pixel from out of bounds index");
-                            Color color = image.pixels[pixelIndex];
-
-                            pixelBuffer[pixelBufferOffset++] = color.g;
-                            pixelBuffer[pixelBufferOffset++] = color.b;
-                        }
-                    }
-
-                    outStream.write((const char*)pixelBuffer, 64);
-                }
-            }
+            memcpy(output + imageDataOffsets[i], imageData[i].data(), imageData[i].size());
         }
 
-        outStream.flush();
-        outStream.close();
+        filesystem_write_file(path.c_str(), file.data(), file.size());
     }
 }
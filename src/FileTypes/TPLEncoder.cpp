@@ -0,0 +1,1081 @@
+#include "FileTypes/TPLEncoder.h"
+#include "FileTypes/TPL.h"
+#include "Types/Types.h"
+#include "core/cpu.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <vector>
+
+#ifdef SPME_X86
+#include <immintrin.h>
+#endif
+
+namespace SPMEditor {
+
+    // ---------------- /
+    // Color helpers
+    // ---------------- /
+
+    struct ColorF {
+        float r, g, b;
+    };
+
+    static inline void WriteU16(u8* data, u16 val) {
+        data[0] = val >> 8;
+        data[1] = val & 0xff;
+    }
+
+    static inline Color Unpack565(u16 val)
+    {
+        u8 r = (val >> 11) & 0x1f;
+        u8 g = (val >> 5) & 0x3f;
+        u8 b = (val >> 0) & 0x1f;
+
+        return Color((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0xff);
+    }
+
+    static inline u16 Pack565(ColorF color)
+    {
+        int r = (int)(std::clamp(color.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        int g = (int)(std::clamp(color.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+        int b = (int)(std::clamp(color.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        return (u16)((r << 11) | (g << 5) | b);
+    }
+
+    static inline Color Unpack5A3(u16 val)
+    {
+        if ((val >> 0xf) == 0) // has alpha encoding
+        {
+            u8 a = (val >> 12) & 0x7;
+            u8 r = (val >> 8) & 0xf;
+            u8 g = (val >> 4) & 0xf;
+            u8 b = (val >> 0) & 0xf;
+
+            return Color(r * 0x11, g * 0x11, b * 0x11, (a << 5) | (a << 2) | (a >> 1));
+        }
+
+        u8 r = (val >> 10) & 0x1f;
+        u8 g = (val >> 5) & 0x1f;
+        u8 b = (val >> 0) & 0x1f;
+
+        return Color((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), 0xff);
+    }
+
+    static inline u16 Pack5A3(Color color)
+    {
+        // Alpha that rounds to fully opaque uses the 555 encoding which has an extra bit of color precision
+        int a = (color.a * 7 + 127) / 255;
+        if (a == 7)
+            return 0x8000 | ((color.r * 31 + 127) / 255) << 10 | ((color.g * 31 + 127) / 255) << 5 | ((color.b * 31 + 127) / 255);
+
+        return a << 12 | ((color.r * 15 + 127) / 255) << 8 | ((color.g * 15 + 127) / 255) << 4 | ((color.b * 15 + 127) / 255);
+    }
+
+    // Rec. 601 luma, used as the intensity of I and IA formats
+    static inline u8 GetIntensity(Color color)
+    {
+        return (color.r * 77 + color.g * 150 + color.b * 29 + 128) >> 8;
+    }
+
+    static inline u8 To4Bit(u8 val)
+    {
+        return (val * 15 + 127) / 255;
+    }
+
+    // Must match the palette the decoder builds, so the error is measured against what will actually be displayed
+    static void BuildDXT1Palette(u16 c0, u16 c1, Color palette[4])
+    {
+        Color a = Unpack565(c0);
+        Color b = Unpack565(c1);
+
+        palette[0] = a;
+        palette[1] = b;
+
+        if (c0 > c1)
+        {
+            palette[2] = Color(((a.r << 1) + b.r) / 3, ((a.g << 1) + b.g) / 3, ((a.b << 1) + b.b) / 3, 0xff);
+            palette[3] = Color(((b.r << 1) + a.r) / 3, ((b.g << 1) + a.g) / 3, ((b.b << 1) + a.b) / 3, 0xff);
+        }
+        else
+        {
+            palette[2] = Color((a.r + b.r) / 2, (a.g + b.g) / 2, (a.b + b.b) / 2, 0xff);
+            palette[3] = Color(0, 0, 0, 0);
+        }
+    }
+
+    static inline int ColorDistance(Color a, Color b)
+    {
+        int dr = a.r - b.r;
+        int dg = a.g - b.g;
+        int db = a.b - b.b;
+        return dr * dr + dg * dg + db * db;
+    }
+
+    struct DXT1Result {
+        u16 c0;
+        u16 c1;
+        u8 indices[16];
+        int error;
+    };
+
+    /**
+     * @brief Picks the endpoint order for the block's mode then assigns every pixel its nearest palette entry
+     *
+     * @param a, b The quantized endpoints, in any order
+     * @param transparent Per pixel flag, transparent pixels always use index 3 of the 3 color mode
+     */
+    static DXT1Result EvaluateEndpoints(u16 a, u16 b, const Color pixels[16], const bool transparent[16], bool hasAlpha)
+    {
+        DXT1Result result;
+        // 3 color mode requires c0 <= c1, 4 color mode requires c0 > c1. Equal endpoints can only be 3 color mode
+        bool threeColor = hasAlpha || a == b;
+        result.c0 = threeColor ? std::min(a, b) : std::max(a, b);
+        result.c1 = threeColor ? std::max(a, b) : std::min(a, b);
+        result.error = 0;
+
+        Color palette[4];
+        BuildDXT1Palette(result.c0, result.c1, palette);
+        int paletteSize = threeColor ? 3 : 4;
+
+        for (int i = 0; i < 16; i++) {
+            if (transparent[i]) {
+                result.indices[i] = 3;
+                continue;
+            }
+
+            int bestIndex = 0;
+            int bestError = INT32_MAX;
+            for (int j = 0; j < paletteSize; j++) {
+                int error = ColorDistance(pixels[i], palette[j]);
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = j;
+                }
+            }
+
+            result.indices[i] = bestIndex;
+            result.error += bestError;
+        }
+
+        return result;
+    }
+
+    // Finds the direction of greatest variance of the colors with power iteration on the covariance matrix
+    static ColorF GetPrincipalAxis(const ColorF* colors, int count, ColorF mean)
+    {
+        float cov[6] = {}; // rr, rg, rb, gg, gb, bb
+        for (int i = 0; i < count; i++) {
+            float r = colors[i].r - mean.r;
+            float g = colors[i].g - mean.g;
+            float b = colors[i].b - mean.b;
+            cov[0] += r * r;
+            cov[1] += r * g;
+            cov[2] += r * b;
+            cov[3] += g * g;
+            cov[4] += g * b;
+            cov[5] += b * b;
+        }
+
+        ColorF axis = { 1.0f, 1.0f, 1.0f };
+        for (int i = 0; i < 8; i++) {
+            ColorF next = {
+                cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b,
+            };
+
+            float length = std::max({ std::abs(next.r), std::abs(next.g), std::abs(next.b) });
+            if (length < FLT_EPSILON)
+                break;
+
+            axis = { next.r / length, next.g / length, next.b / length };
+        }
+
+        return axis;
+    }
+
+    /**
+     * @brief Solves for the endpoints that best fit the colors in the least squares sense, given the weight of endpoint a for every color
+     *
+     * @return false if the system is singular (every color was given the same weight)
+     */
+    static bool SolveEndpoints(const ColorF* colors, const float* weights, int count, ColorF& a, ColorF& b)
+    {
+        float aa = 0, ab = 0, bb = 0;
+        ColorF ax = {}, bx = {};
+        for (int i = 0; i < count; i++) {
+            float alpha = weights[i];
+            float beta = 1.0f - alpha;
+            aa += alpha * alpha;
+            ab += alpha * beta;
+            bb += beta * beta;
+            ax = { ax.r + alpha * colors[i].r, ax.g + alpha * colors[i].g, ax.b + alpha * colors[i].b };
+            bx = { bx.r + beta * colors[i].r, bx.g + beta * colors[i].g, bx.b + beta * colors[i].b };
+        }
+
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < FLT_EPSILON)
+            return false;
+
+        float inv = 1.0f / det;
+        a = { (ax.r * bb - bx.r * ab) * inv, (ax.g * bb - bx.g * ab) * inv, (ax.b * bb - bx.b * ab) * inv };
+        b = { (bx.r * aa - ax.r * ab) * inv, (bx.g * aa - ax.g * ab) * inv, (bx.b * aa - ax.b * ab) * inv };
+        return true;
+    }
+
+    // ---------------- /
+    // Block encoders
+    // ---------------- /
+
+    // Each encoder writes exactly one block, where stride is the width in pixels of the input rows
+    typedef void (*BlockEncoder)(const Color* pixels, int stride, u8* output);
+
+    static void EncodeI4Block(const Color* pixels, int stride, u8* output)
+    {
+        for (int y = 0; y < 8; y++, pixels += stride) {
+            for (int x = 0; x < 8; x += 2) {
+                *output++ = To4Bit(GetIntensity(pixels[x])) << 4 | To4Bit(GetIntensity(pixels[x + 1]));
+            }
+        }
+    }
+
+    static void EncodeI8Block(const Color* pixels, int stride, u8* output)
+    {
+        for (int y = 0; y < 4; y++, pixels += stride) {
+            for (int x = 0; x < 8; x++) {
+                *output++ = GetIntensity(pixels[x]);
+            }
+        }
+    }
+
+    static void EncodeIA4Block(const Color* pixels, int stride, u8* output)
+    {
+        for (int y = 0; y < 4; y++, pixels += stride) {
+            for (int x = 0; x < 8; x++) {
+                *output++ = To4Bit(pixels[x].a) << 4 | To4Bit(GetIntensity(pixels[x]));
+            }
+        }
+    }
+
+    static void EncodeIA8Block(const Color* pixels, int stride, u8* output)
+    {
+        for (int y = 0; y < 4; y++, pixels += stride) {
+            for (int x = 0; x < 4; x++, output += 2) {
+                output[0] = pixels[x].a;
+                output[1] = GetIntensity(pixels[x]);
+            }
+        }
+    }
+
+    static void EncodeRGB565Block(const Color* pixels, int stride, u8* output)
+    {
+        for (int y = 0; y < 4; y++, pixels += stride) {
+            for (int x = 0; x < 4; x++, output += 2) {
+                WriteU16(output, Pack565({ (float)pixels[x].r, (float)pixels[x].g, (float)pixels[x].b }));
+            }
+        }
+    }
+
+    static void EncodeRGB5A3Block(const Color* pixels, int stride, u8* output)
+    {
+        for (int y = 0; y < 4; y++, pixels += stride) {
+            for (int x = 0; x < 4; x++, output += 2) {
+                WriteU16(output, Pack5A3(pixels[x]));
+            }
+        }
+    }
+
+    static void EncodeRGBA32Block(const Color* pixels, int stride, u8* output)
+    {
+        // The first 32 bytes hold AR pairs and the second 32 bytes GB pairs
+        for (int y = 0; y < 4; y++, pixels += stride) {
+            for (int x = 0; x < 4; x++, output += 2) {
+                Color color = pixels[x];
+                output[0] = color.a;
+                output[1] = color.r;
+                output[32] = color.g;
+                output[33] = color.b;
+            }
+        }
+    }
+
+#ifdef SPME_X86
+    SPME_TARGET("sse4.1")
+    static void EncodeRGBA32Block_SSE41(const Color* pixels, int stride, u8* output)
+    {
+        // Splits each row into its AR pairs in the low half and GB pairs in the high half, two rows fill a 16 byte store per plane
+        const __m128i toARGB = _mm_setr_epi8(3, 0, 7, 4, 11, 8, 15, 12, 1, 2, 5, 6, 9, 10, 13, 14);
+        for (int y = 0; y < 4; y += 2, pixels += stride * 2, output += 16) {
+            __m128i row0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)pixels), toARGB);
+            __m128i row1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pixels + stride)), toARGB);
+            _mm_storeu_si128((__m128i*)output, _mm_unpacklo_epi64(row0, row1));
+            _mm_storeu_si128((__m128i*)(output + 32), _mm_unpackhi_epi64(row0, row1));
+        }
+    }
+#endif
+
+    void TPLEncoder::EncodeDXT1Block(const Color* pixels, int stride, TPLCompressionQuality quality, u8* output)
+    {
+        Color block[16];
+        bool transparent[16];
+        ColorF colors[16];
+        int colorCount = 0;
+
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int i = y * 4 + x;
+                block[i] = pixels[y * stride + x];
+                transparent[i] = block[i].a < 0x80;
+                if (!transparent[i])
+                    colors[colorCount++] = { (float)block[i].r, (float)block[i].g, (float)block[i].b };
+            }
+        }
+
+        bool hasAlpha = colorCount < 16;
+        if (colorCount == 0) {
+            // Fully transparent, 3 color mode with every pixel on the transparent index
+            memset(output, 0, 4);
+            memset(output + 4, 0xff, 4);
+            return;
+        }
+
+        ColorF mean = {};
+        for (int i = 0; i < colorCount; i++)
+            mean = { mean.r + colors[i].r, mean.g + colors[i].g, mean.b + colors[i].b };
+        mean = { mean.r / colorCount, mean.g / colorCount, mean.b / colorCount };
+
+        ColorF axis = GetPrincipalAxis(colors, colorCount, mean);
+
+        // Range fit, the endpoints are the colors furthest along the axis in each direction
+        float projections[16];
+        int minIndex = 0;
+        int maxIndex = 0;
+        for (int i = 0; i < colorCount; i++) {
+            projections[i] = colors[i].r * axis.r + colors[i].g * axis.g + colors[i].b * axis.b;
+            if (projections[i] < projections[minIndex])
+                minIndex = i;
+            if (projections[i] > projections[maxIndex])
+                maxIndex = i;
+        }
+
+        DXT1Result best = EvaluateEndpoints(Pack565(colors[maxIndex]), Pack565(colors[minIndex]), block, transparent, hasAlpha);
+
+        if (quality == TPLCompressionQuality::High && best.error > 0) {
+            // Cluster fit, sort the colors along the axis and try every way of splitting them into ordered clusters,
+            // each cluster snapping to one palette entry
+            int order[16];
+            for (int i = 0; i < colorCount; i++)
+                order[i] = i;
+            std::sort(order, order + colorCount, [&](int l, int r) { return projections[l] > projections[r]; });
+
+            ColorF sorted[16];
+            for (int i = 0; i < colorCount; i++)
+                sorted[i] = colors[order[i]];
+
+            float weights[16];
+            auto tryWeights = [&]() {
+                ColorF a, b;
+                if (!SolveEndpoints(sorted, weights, colorCount, a, b))
+                    return;
+
+                DXT1Result result = EvaluateEndpoints(Pack565(a), Pack565(b), block, transparent, hasAlpha);
+                if (result.error < best.error)
+                    best = result;
+            };
+
+            if (hasAlpha) {
+                // 3 clusters weighted 1, 1/2, 0
+                for (int i = 0; i <= colorCount; i++) {
+                    for (int j = i; j <= colorCount; j++) {
+                        for (int k = 0; k < colorCount; k++)
+                            weights[k] = k < i ? 1.0f : k < j ? 0.5f : 0.0f;
+                        tryWeights();
+                    }
+                }
+            }
+            else {
+                // 4 clusters weighted 1, 2/3, 1/3, 0
+                for (int i = 0; i <= colorCount; i++) {
+                    for (int j = i; j <= colorCount; j++) {
+                        for (int k = j; k <= colorCount; k++) {
+                            for (int l = 0; l < colorCount; l++)
+                                weights[l] = l < i ? 1.0f : l < j ? 2.0f / 3.0f : l < k ? 1.0f / 3.0f : 0.0f;
+                            tryWeights();
+                        }
+                    }
+                }
+            }
+        }
+
+        WriteU16(output, best.c0);
+        WriteU16(output + 2, best.c1);
+        for (int y = 0; y < 4; y++) {
+            const u8* row = best.indices + y * 4;
+            output[4 + y] = (row[0] << 6) | (row[1] << 4) | (row[2] << 2) | row[3];
+        }
+    }
+
+    void TPLEncoder::EncodeCMPRBlock(const Color* pixels, int stride, TPLCompressionQuality quality, u8* output)
+    {
+        // 2x2 DXT1 sub blocks ordered top left, top right, bottom left, bottom right
+        for (int subY = 0; subY < 2; subY++) {
+            for (int subX = 0; subX < 2; subX++, output += 8) {
+                EncodeDXT1Block(pixels + subX * 4 + subY * 4 * stride, stride, quality, output);
+            }
+        }
+    }
+
+    // ---------------- /
+    // Palette quantization
+    // ---------------- /
+
+    static inline int ColorDistanceRGBA(Color a, Color b)
+    {
+        int da = a.a - b.a;
+        return ColorDistance(a, b) + da * da;
+    }
+
+    static inline u32 ToU32(Color color)
+    {
+        u32 val;
+        memcpy(&val, &color, sizeof(u32));
+        return val;
+    }
+
+    static inline Color FromU32(u32 val)
+    {
+        Color color;
+        memcpy(&color, &val, sizeof(u32));
+        return color;
+    }
+
+    static int FindNearestColor(Color color, const std::vector<Color>& palette)
+    {
+        int bestIndex = 0;
+        int bestError = INT32_MAX;
+        for (size_t i = 0; i < palette.size(); i++) {
+            int error = ColorDistanceRGBA(color, palette[i]);
+            if (error < bestError) {
+                bestError = error;
+                bestIndex = i;
+            }
+        }
+
+        return bestIndex;
+    }
+
+    struct ColorCount {
+        Color color;
+        u32 count;
+    };
+
+    /**
+     * @brief Reduces the colors to at most maxColors with median cut, then refines the palette with a few rounds of k-means on High quality
+     *
+     * @param colors Every unique color in the image and how many times it appears
+     */
+    static std::vector<Color> QuantizeColors(std::vector<ColorCount>& colors, u32 maxColors, TPLCompressionQuality quality)
+    {
+        std::vector<Color> palette;
+        if (colors.size() <= maxColors) {
+            for (const ColorCount& color : colors)
+                palette.push_back(color.color);
+            return palette;
+        }
+
+        struct Box {
+            u32 begin;
+            u32 end;
+            int channel; // Channel with the largest range
+            int range;
+        };
+
+        auto measureBox = [&](Box& box) {
+            u8 min[4] = { 0xff, 0xff, 0xff, 0xff };
+            u8 max[4] = {};
+            for (u32 i = box.begin; i < box.end; i++) {
+                const u8* channels = &colors[i].color.r;
+                for (int c = 0; c < 4; c++) {
+                    min[c] = std::min(min[c], channels[c]);
+                    max[c] = std::max(max[c], channels[c]);
+                }
+            }
+
+            box.range = -1;
+            for (int c = 0; c < 4; c++) {
+                if (max[c] - min[c] > box.range) {
+                    box.range = max[c] - min[c];
+                    box.channel = c;
+                }
+            }
+        };
+
+        std::vector<Box> boxes;
+        boxes.push_back({ 0, (u32)colors.size(), 0, 0 });
+        measureBox(boxes[0]);
+
+        while (boxes.size() < maxColors) {
+            // Split the box with the widest channel at the median pixel, not the median color, so common colors get more entries
+            auto widest = std::max_element(boxes.begin(), boxes.end(), [](const Box& l, const Box& r) { return l.range < r.range; });
+            if (widest->range <= 0)
+                break;
+
+            Box box = *widest;
+            std::sort(colors.begin() + box.begin, colors.begin() + box.end, [&](const ColorCount& l, const ColorCount& r) {
+                return (&l.color.r)[box.channel] < (&r.color.r)[box.channel];
+            });
+
+            u64 total = 0;
+            for (u32 i = box.begin; i < box.end; i++)
+                total += colors[i].count;
+
+            u32 split = box.begin + 1;
+            u64 accumulated = colors[box.begin].count;
+            while (split < box.end - 1 && accumulated * 2 < total)
+                accumulated += colors[split++].count;
+
+            Box low = { box.begin, split, 0, 0 };
+            Box high = { split, box.end, 0, 0 };
+            measureBox(low);
+            measureBox(high);
+            *widest = low;
+            boxes.push_back(high);
+        }
+
+        // Each entry is the pixel weighted mean of its box
+        std::vector<u32> assignments(colors.size());
+        for (size_t i = 0; i < boxes.size(); i++) {
+            for (u32 j = boxes[i].begin; j < boxes[i].end; j++)
+                assignments[j] = i;
+        }
+
+        palette.resize(boxes.size());
+        int iterations = quality == TPLCompressionQuality::High ? 4 : 0;
+        for (int iteration = 0; ; iteration++) {
+            std::vector<u64> sums(palette.size() * 5);
+            for (size_t i = 0; i < colors.size(); i++) {
+                u64* sum = &sums[assignments[i] * 5];
+                const Color& color = colors[i].color;
+                u32 count = colors[i].count;
+                sum[0] += color.r * count;
+                sum[1] += color.g * count;
+                sum[2] += color.b * count;
+                sum[3] += color.a * count;
+                sum[4] += count;
+            }
+
+            for (size_t i = 0; i < palette.size(); i++) {
+                const u64* sum = &sums[i * 5];
+                if (sum[4] == 0)
+                    continue; // Keep the old entry of an empty cluster
+                palette[i] = Color((sum[0] + sum[4] / 2) / sum[4], (sum[1] + sum[4] / 2) / sum[4], (sum[2] + sum[4] / 2) / sum[4], (sum[3] + sum[4] / 2) / sum[4]);
+            }
+
+            if (iteration >= iterations)
+                break;
+
+            for (size_t i = 0; i < colors.size(); i++)
+                assignments[i] = FindNearestColor(colors[i].color, palette);
+        }
+
+        return palette;
+    }
+
+    /**
+     * @brief Builds a palette for the image and maps every pixel to a palette index
+     *
+     * @param indices Output, one index per pixel
+     * @return The palette entries as they will be decoded
+     */
+    static std::vector<Color> BuildPaletteImage(const Color* pixels, int width, int height, u32 maxColors, TPLCompressionQuality quality, bool dither, TPLPalette& palette, std::vector<u8>& indices)
+    {
+        u64 pixelCount = (u64)width * height;
+
+        // Gather the unique colors, sorted so pixels can find their color with a binary search later
+        std::vector<u32> sortedPixels(pixelCount);
+        memcpy(sortedPixels.data(), pixels, pixelCount * sizeof(Color));
+        std::sort(sortedPixels.begin(), sortedPixels.end());
+
+        std::vector<ColorCount> colors;
+        bool isGrayscale = true;
+        bool hasAlpha = false;
+        for (u64 i = 0; i < pixelCount; i++) {
+            if (i > 0 && sortedPixels[i] == sortedPixels[i - 1]) {
+                colors.back().count++;
+                continue;
+            }
+
+            Color color = FromU32(sortedPixels[i]);
+            isGrayscale &= color.r == color.g && color.g == color.b;
+            hasAlpha |= color.a != 0xff;
+            colors.push_back({ color, 1 });
+        }
+
+        std::vector<u32> uniqueColors(colors.size());
+        for (size_t i = 0; i < colors.size(); i++)
+            uniqueColors[i] = ToU32(colors[i].color);
+
+        // Quantize the entries into the palette format so pixels are matched against what will actually be displayed
+        std::vector<Color> entries = QuantizeColors(colors, maxColors, quality);
+        palette.mFormat = isGrayscale ? TPLPaletteFormat::IA8 : hasAlpha ? TPLPaletteFormat::RGB5A3 : TPLPaletteFormat::RGB565;
+        palette.mEntryCount = entries.size();
+        palette.mData.resize(entries.size() * 2);
+        for (size_t i = 0; i < entries.size(); i++) {
+            Color entry = entries[i];
+            u16 val;
+            switch (palette.mFormat)
+            {
+                case TPLPaletteFormat::IA8:
+                    val = entry.a << 8 | entry.r;
+                    entries[i] = Color(entry.r, entry.r, entry.r, entry.a);
+                    break;
+                case TPLPaletteFormat::RGB565:
+                    val = Pack565({ (float)entry.r, (float)entry.g, (float)entry.b });
+                    entries[i] = Unpack565(val);
+                    break;
+                case TPLPaletteFormat::RGB5A3:
+                    val = Pack5A3(entry);
+                    entries[i] = Unpack5A3(val);
+                    break;
+            }
+
+            WriteU16(palette.mData.data() + i * 2, val);
+        }
+
+        indices.resize(pixelCount);
+        if (!dither) {
+            std::vector<u8> uniqueIndices(uniqueColors.size());
+            for (size_t i = 0; i < uniqueColors.size(); i++)
+                uniqueIndices[i] = FindNearestColor(FromU32(uniqueColors[i]), entries);
+
+            for (u64 i = 0; i < pixelCount; i++) {
+                size_t unique = std::lower_bound(uniqueColors.begin(), uniqueColors.end(), ToU32(pixels[i])) - uniqueColors.begin();
+                indices[i] = uniqueIndices[unique];
+            }
+
+            return entries;
+        }
+
+        // Floyd Steinberg dithering, the error of each pixel is spread over its unvisited neighbours
+        std::vector<int> errors((width + 2) * 2 * 4);
+        for (int y = 0; y < height; y++) {
+            int* current = errors.data() + (y & 1) * (width + 2) * 4 + 4;
+            int* next = errors.data() + ((y + 1) & 1) * (width + 2) * 4 + 4;
+            memset(next - 4, 0, (width + 2) * 4 * sizeof(int));
+
+            for (int x = 0; x < width; x++) {
+                const Color& source = pixels[y * width + x];
+                const u8* sourceChannels = &source.r;
+                int* error = current + x * 4;
+
+                u8 target[4];
+                for (int c = 0; c < 4; c++)
+                    target[c] = std::clamp(sourceChannels[c] + error[c] / 16, 0, 0xff);
+
+                int index = FindNearestColor(Color(target[0], target[1], target[2], target[3]), entries);
+                indices[y * width + x] = index;
+
+                const u8* chosen = &entries[index].r;
+                for (int c = 0; c < 4; c++) {
+                    int difference = target[c] - chosen[c];
+                    error[c + 4] += difference * 7;
+                    next[(x - 1) * 4 + c] += difference * 3;
+                    next[x * 4 + c] += difference * 5;
+                    next[(x + 1) * 4 + c] += difference;
+                }
+            }
+        }
+
+        return entries;
+    }
+
+    // ---------------- /
+    // Mipmaps
+    // ---------------- /
+
+    struct GammaTables {
+        float toLinear[256];
+        u8 toSRGB[4096]; // Indexed by linear * 4095
+
+        GammaTables()
+        {
+            for (int i = 0; i < 256; i++) {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+
+            for (int i = 0; i < 4096; i++) {
+                float c = i / 4095.0f;
+                float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                toSRGB[i] = (u8)(srgb * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    static const GammaTables s_GammaTables;
+
+    int TPLEncoder::GetMipmapCount(int width, int height)
+    {
+        // GX can only mipmap power of two textures, and LODs stop at 10 (1024x1024)
+        if ((width & (width - 1)) != 0 || (height & (height - 1)) != 0)
+            return 1;
+
+        int count = 1;
+        while ((width > 1 || height > 1) && count < 11) {
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+            count++;
+        }
+
+        return count;
+    }
+
+    std::vector<Color> TPLEncoder::Downsample(const Color* pixels, int width, int height)
+    {
+        int outputWidth = std::max(width / 2, 1);
+        int outputHeight = std::max(height / 2, 1);
+        std::vector<Color> output(outputWidth * outputHeight);
+
+        const float* toLinear = s_GammaTables.toLinear;
+        const u8* toSRGB = s_GammaTables.toSRGB;
+        for (int y = 0; y < outputHeight; y++) {
+            const Color* row0 = pixels + std::min(y * 2, height - 1) * width;
+            const Color* row1 = pixels + std::min(y * 2 + 1, height - 1) * width;
+
+            for (int x = 0; x < outputWidth; x++) {
+                int x0 = std::min(x * 2, width - 1);
+                int x1 = std::min(x * 2 + 1, width - 1);
+                const Color source[4] = { row0[x0], row0[x1], row1[x0], row1[x1] };
+
+                // Colors are averaged in linear space and weighted by alpha, so transparent pixels don't bleed their color into the edges.
+                // There is no SIMD path, each pixel is only a few table lookups and one path keeps mipmaps the same on every CPU
+                float sum[4] = {};
+                for (const Color& color : source) {
+                    float alpha = color.a / 255.0f;
+                    sum[0] += toLinear[color.r] * alpha;
+                    sum[1] += toLinear[color.g] * alpha;
+                    sum[2] += toLinear[color.b] * alpha;
+                    sum[3] += alpha;
+                }
+
+                float alphaSum = sum[3];
+                int index[3];
+                for (int c = 0; c < 3; c++)
+                    index[c] = alphaSum > 0.0f ? (int)(std::min(sum[c] / alphaSum * 4095.0f, 4095.0f) + 0.5f) : 0;
+
+                output[y * outputWidth + x] = Color(toSRGB[index[0]], toSRGB[index[1]], toSRGB[index[2]], (u8)(alphaSum * 255.0f / 4.0f + 0.5f));
+            }
+        }
+
+        return output;
+    }
+
+    // Lanczos windowed sinc with 3 lobes
+    static float Lanczos3(float x)
+    {
+        x = std::abs(x);
+        if (x < 1e-5f)
+            return 1.0f;
+        if (x >= 3.0f)
+            return 0.0f;
+
+        float pix = std::numbers::pi_v<float> * x;
+        return 3.0f * std::sin(pix) * std::sin(pix / 3.0f) / (pix * pix);
+    }
+
+    // The source pixels and normalized weights that make up each output pixel along one axis
+    struct ResizeContribution {
+        int first;
+        std::vector<float> weights;
+    };
+
+    static std::vector<ResizeContribution> GetResizeContributions(int size, int outputSize)
+    {
+        // When shrinking, the filter is stretched to cover every source pixel
+        float scale = (float)size / outputSize;
+        float filterScale = std::max(scale, 1.0f);
+        float radius = 3.0f * filterScale;
+
+        std::vector<ResizeContribution> contributions(outputSize);
+        for (int i = 0; i < outputSize; i++) {
+            float center = (i + 0.5f) * scale - 0.5f;
+            int first = (int)std::floor(center - radius) + 1;
+            int last = (int)std::ceil(center + radius) - 1;
+
+            ResizeContribution& contribution = contributions[i];
+            contribution.first = first;
+            float total = 0.0f;
+            for (int j = first; j <= last; j++) {
+                float weight = Lanczos3((j - center) / filterScale);
+                contribution.weights.push_back(weight);
+                total += weight;
+            }
+
+            for (float& weight : contribution.weights)
+                weight /= total;
+        }
+
+        return contributions;
+    }
+
+    // Sums weighted RGBA float pixels, source pixels are stride floats apart and clamped to the edge
+    static inline void ResizeFilter(const float* source, int size, int stride, const ResizeContribution& contribution, float* output)
+    {
+#ifdef SPME_X86
+        __m128 sum = _mm_setzero_ps();
+        for (size_t i = 0; i < contribution.weights.size(); i++) {
+            int index = std::clamp(contribution.first + (int)i, 0, size - 1);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + index * stride), _mm_set1_ps(contribution.weights[i])));
+        }
+        _mm_storeu_ps(output, sum);
+#else
+        float sum[4] = {};
+        for (size_t i = 0; i < contribution.weights.size(); i++) {
+            const float* pixel = source + std::clamp(contribution.first + (int)i, 0, size - 1) * stride;
+            for (int c = 0; c < 4; c++)
+                sum[c] += pixel[c] * contribution.weights[i];
+        }
+        memcpy(output, sum, sizeof(sum));
+#endif
+    }
+
+    std::vector<Color> TPLEncoder::Resize(const Color* pixels, int width, int height, int outputWidth, int outputHeight)
+    {
+        // Filter in linear space with premultiplied alpha so transparent pixels don't bleed their color
+        const float* toLinear = s_GammaTables.toLinear;
+        std::vector<float> linear(width * height * 4);
+        for (int i = 0; i < width * height; i++) {
+            float alpha = pixels[i].a / 255.0f;
+            linear[i * 4 + 0] = toLinear[pixels[i].r] * alpha;
+            linear[i * 4 + 1] = toLinear[pixels[i].g] * alpha;
+            linear[i * 4 + 2] = toLinear[pixels[i].b] * alpha;
+            linear[i * 4 + 3] = alpha;
+        }
+
+        // Resize rows then columns
+        std::vector<ResizeContribution> horizontal = GetResizeContributions(width, outputWidth);
+        std::vector<float> rows(outputWidth * height * 4);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < outputWidth; x++) {
+                ResizeFilter(linear.data() + y * width * 4, width, 4, horizontal[x], rows.data() + (y * outputWidth + x) * 4);
+            }
+        }
+
+        std::vector<ResizeContribution> vertical = GetResizeContributions(height, outputHeight);
+        std::vector<Color> output(outputWidth * outputHeight);
+        const u8* toSRGB = s_GammaTables.toSRGB;
+        for (int y = 0; y < outputHeight; y++) {
+            for (int x = 0; x < outputWidth; x++) {
+                float pixel[4];
+                ResizeFilter(rows.data() + x * 4, height, outputWidth * 4, vertical[y], pixel);
+
+                // Lanczos rings, so the result can leave the 0-1 range
+                float alpha = std::clamp(pixel[3], 0.0f, 1.0f);
+                int index[3] = {};
+                for (int c = 0; c < 3 && alpha > 0.0f; c++)
+                    index[c] = (int)std::lround(std::clamp(pixel[c] / alpha, 0.0f, 1.0f) * 4095.0f);
+
+                output[y * outputWidth + x] = Color(toSRGB[index[0]], toSRGB[index[1]], toSRGB[index[2]], (u8)(alpha * 255.0f + 0.5f));
+            }
+        }
+
+        return output;
+    }
+
+    // ---------------- /
+    // Image encoding
+    // ---------------- /
+
+    bool TPLEncoder::SupportsFormat(TPLImageFormat format)
+    {
+        switch (format) {
+            case TPLImageFormat::I4:
+            case TPLImageFormat::I8:
+            case TPLImageFormat::IA4:
+            case TPLImageFormat::IA8:
+            case TPLImageFormat::RGB565:
+            case TPLImageFormat::RGB5A3:
+            case TPLImageFormat::RGBA32:
+            case TPLImageFormat::C4:
+            case TPLImageFormat::C8:
+            case TPLImageFormat::CMPR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    std::vector<u8> TPLEncoder::EncodeImage(const Color* pixels, int width, int height, TPLImageFormat format, TPLCompressionQuality quality, bool dither, TPLPalette* palette)
+    {
+        Assert(SupportsFormat(format), "TPLEncoder cannot encode image format %s (%d)", TPL::GetFormatName(format), (int)format);
+
+        int blockWidth;
+        int blockHeight;
+        TPL::GetBlockSize(format, blockWidth, blockHeight);
+        u32 blockByteSize = TPL::GetBlockByteSize(format);
+
+        std::vector<u8> output(TPL::GetImageDataSize(format, width, height));
+        u8* data = output.data();
+
+        if (TPL::IsPaletteFormat(format)) {
+            Assert(palette, "TPLEncoder needs a palette to encode %s images", TPL::GetFormatName(format));
+
+            std::vector<u8> indices;
+            palette->mColors = BuildPaletteImage(pixels, width, height, format == TPLImageFormat::C4 ? 16 : 256, quality, dither, *palette, indices);
+
+            // C4 packs two indices per byte, left pixel in the high nibble. Edge blocks repeat the edge indices
+            for (int blockY = 0; blockY < height; blockY += blockHeight) {
+                for (int blockX = 0; blockX < width; blockX += blockWidth) {
+                    for (int y = 0; y < blockHeight; y++) {
+                        const u8* row = indices.data() + std::min(blockY + y, height - 1) * width;
+                        for (int x = 0; x < blockWidth; x++) {
+                            u8 index = row[std::min(blockX + x, width - 1)];
+                            if (format == TPLImageFormat::C8)
+                                *data++ = index;
+                            else if (x & 1)
+                                *data++ |= index;
+                            else
+                                *data = index << 4;
+                        }
+                    }
+                }
+            }
+
+            return output;
+        }
+
+        BlockEncoder encoder = nullptr;
+        switch (format)
+        {
+            case TPLImageFormat::I4:     encoder = EncodeI4Block; break;
+            case TPLImageFormat::I8:     encoder = EncodeI8Block; break;
+            case TPLImageFormat::IA4:    encoder = EncodeIA4Block; break;
+            case TPLImageFormat::IA8:    encoder = EncodeIA8Block; break;
+            case TPLImageFormat::RGB565: encoder = EncodeRGB565Block; break;
+            case TPLImageFormat::RGB5A3: encoder = EncodeRGB5A3Block; break;
+            case TPLImageFormat::RGBA32: encoder = EncodeRGBA32Block; break;
+            default: break;
+        }
+
+#ifdef SPME_X86
+        if (format == TPLImageFormat::RGBA32 && cpu_has_sse41())
+            encoder = EncodeRGBA32Block_SSE41;
+#endif
+
+        Color block[64];
+        for (int blockY = 0; blockY < height; blockY += blockHeight) {
+            for (int blockX = 0; blockX < width; blockX += blockWidth, data += blockByteSize) {
+                const Color* source = pixels + blockY * width + blockX;
+                int stride = width;
+
+                // Blocks hanging off the edge of the image are padded with the edge pixels so they don't skew lossy encoders
+                if (blockX + blockWidth > width || blockY + blockHeight > height) {
+                    for (int y = 0; y < blockHeight; y++) {
+                        int sourceY = std::min(blockY + y, height - 1);
+                        for (int x = 0; x < blockWidth; x++) {
+                            int sourceX = std::min(blockX + x, width - 1);
+                            block[y * blockWidth + x] = pixels[sourceY * width + sourceX];
+                        }
+                    }
+
+                    source = block;
+                    stride = blockWidth;
+                }
+
+                if (format == TPLImageFormat::CMPR)
+                    EncodeCMPRBlock(source, stride, quality, data);
+                else
+                    encoder(source, stride, data);
+            }
+        }
+
+        return output;
+    }
+
+    double TPLEncoder::GetPSNR(const Color* a, const Color* b, u64 pixelCount)
+    {
+        u64 squaredError = 0;
+        u64 channelCount = 0;
+        for (u64 i = 0; i < pixelCount; i++) {
+            int da = a[i].a - b[i].a;
+            squaredError += da * da;
+            channelCount++;
+
+            if (a[i].a == 0 && b[i].a == 0)
+                continue;
+
+            squaredError += ColorDistance(a[i], b[i]);
+            channelCount += 3;
+        }
+
+        if (squaredError == 0)
+            return INFINITY;
+
+        double meanSquaredError = (double)squaredError / channelCount;
+        return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+    }
+
+    TPLFormatChoice TPLEncoder::ChooseFormat(const Color* pixels, int width, int height, TPLCompressionQuality quality, bool dither)
+    {
+        u64 pixelCount = (u64)width * height;
+
+        // Classify the content so formats that can't represent it are never tried
+        bool isGrayscale = true;
+        bool hasAlpha = false;
+        bool hasGradedAlpha = false;
+        for (u64 i = 0; i < pixelCount; i++) {
+            const Color& color = pixels[i];
+            isGrayscale &= std::abs(color.r - color.g) <= 2 && std::abs(color.g - color.b) <= 2;
+            hasAlpha |= color.a != 0xff;
+            hasGradedAlpha |= color.a != 0xff && color.a != 0;
+        }
+
+        // Every candidate is tried in order of size, RGBA32 is lossless so something always fits
+        struct Candidate {
+            TPLImageFormat format;
+            bool usable;
+        };
+
+        const Candidate candidates[] = {
+            { TPLImageFormat::I4, isGrayscale && !hasAlpha },
+            { TPLImageFormat::CMPR, !hasGradedAlpha },
+            { TPLImageFormat::C4, true },
+            { TPLImageFormat::IA4, isGrayscale },
+            { TPLImageFormat::I8, isGrayscale && !hasAlpha },
+            { TPLImageFormat::C8, true },
+            { TPLImageFormat::IA8, isGrayscale },
+            { TPLImageFormat::RGB565, !hasAlpha },
+            { TPLImageFormat::RGB5A3, true },
+            { TPLImageFormat::RGBA32, true },
+        };
+
+        std::vector<Color> decoded(pixelCount);
+        TPLFormatChoice best = { TPLImageFormat::RGBA32, TPL::GetImageDataSize(TPLImageFormat::RGBA32, width, height), INFINITY };
+        for (const Candidate& candidate : candidates) {
+            if (!candidate.usable)
+                continue;
+
+            TPLPalette palette;
+            bool hasPalette = TPL::IsPaletteFormat(candidate.format);
+            u32 size = TPL::GetImageDataSize(candidate.format, width, height);
+            if (size >= best.mSize)
+                break;
+
+            std::vector<u8> data = EncodeImage(pixels, width, height, candidate.format, quality, dither, hasPalette ? &palette : nullptr);
+            TPL::DecodeImage(data.data(), width, height, candidate.format, decoded.data(), hasPalette ? palette.mColors.data() : nullptr);
+            if (hasPalette)
+                size += (palette.mData.size() + 0x1f) & ~0x1f;
+
+            double psnr = GetPSNR(pixels, decoded.data(), pixelCount);
+            if (psnr >= AutoFormatMinPSNR && size < best.mSize) {
+                best = { candidate.format, size, psnr };
+                break;
+            }
+        }
+
+        return best;
+    }
+}
@@ -0,0 +1,2 @@
+#define FPNG_NO_SSE 1
+#include "fpng.cpp"
@@ -0,0 +1,97 @@
+#include "FileTypes/LevelGeometry/AnimationEvaluator.h"
+#include "UnitTests/AnimationTests.h"
+#include <cmath>
+#include <cstdlib>
+
+namespace SPMEditor::Testing {
+
+    // Samples a channel by searching every key, like the preview did before the evaluator
+    static Vector3 ReferencePosition(const SceneAnimation& animation, const SceneAnimationChannel& channel, float frame) {
+        frame = std::fmod(frame, animation.mDuration);
+        const SceneKeyframe* keys = channel.mKeyframes;
+        if (frame <= keys[0].mTime)
+            return keys[0].mPosition;
+
+        for (u32 k = 0; k + 1 < channel.mKeyframeCount; k++) {
+            if (frame < keys[k + 1].mTime) {
+                float t = (frame - keys[k].mTime) / (keys[k + 1].mTime - keys[k].mTime);
+                return Vector3(keys[k].mPosition.x + (keys[k + 1].mPosition.x - keys[k].mPosition.x) * t, 0, 0);
+            }
+        }
+
+        return keys[channel.mKeyframeCount - 1].mPosition;
+    }
+
+    bool TestAnimationEvaluator() {
+        Scene scene;
+        scene.mNodeCount = 3;
+        scene.mNodes = arena_alloc_array<SceneNode>(scene.mArena, scene.mNodeCount);
+
+        // Two animations with a channel each, keys at uneven times and the first one after frame 0
+        scene.mAnimationCount = 2;
+        scene.mAnimations = arena_alloc_array<SceneAnimation>(scene.mArena, scene.mAnimationCount);
+        for (u32 a = 0; a < scene.mAnimationCount; a++) {
+            SceneAnimation& animation = scene.mAnimations[a];
+            animation.mName = "Test";
+            animation.mDuration = 100 + a * 20;
+            animation.mChannelCount = 1;
+            animation.mChannels = arena_alloc_array<SceneAnimationChannel>(scene.mArena, 1);
+
+            SceneAnimationChannel& channel = animation.mChannels[0];
+            channel.mNode = a + 1;
+            channel.mKeyframeCount = 6 + a;
+            channel.mKeyframes = arena_alloc_array<SceneKeyframe>(scene.mArena, channel.mKeyframeCount);
+            float time = 5;
+            for (u32 k = 0; k < channel.mKeyframeCount; k++) {
+                channel.mKeyframes[k] = { time, Vector3(rand() % 100, 0, 0), Vector3(0, 0, 0), Vector3(1, 1, 1) };
+                time += 1 + rand() % 15;
+            }
+        }
+
+        AnimationEvaluator evaluator(&scene);
+        if (evaluator.GetChannelCount() != 2 || evaluator.GetChannelNode(0) != 1 || evaluator.GetChannelNode(1) != 2) {
+            LogError("Animation evaluator did not keep the channels' nodes");
+            return false;
+        }
+
+        const SceneKeyframe* keys = scene.mAnimations[0].mChannels[0].mKeyframes;
+        float middle = (keys[1].mTime + keys[2].mTime) / 2;
+        float expected = (keys[1].mPosition.x + keys[2].mPosition.x) / 2;
+        if (std::abs(evaluator.Sample(0, middle).mPosition.x - expected) > 1e-4f) {
+            LogError("Animation evaluator does not interpolate between keys");
+            return false;
+        }
+
+        if (evaluator.Sample(0, 0).mPosition.x != keys[0].mPosition.x || evaluator.Sample(0, 99).mPosition.x != keys[5].mPosition.x) {
+            LogError("Animation evaluator does not hold the first and last keys");
+            return false;
+        }
+
+        if (evaluator.Sample(0, middle + 300).mPosition.x != evaluator.Sample(0, middle).mPosition.x) {
+            LogError("Animation evaluator does not loop the animation");
+            return false;
+        }
+
+        // Days of frames at 60 fps, where a float frame would have lost the fraction before wrapping
+        if (std::abs(evaluator.Sample(0, middle + 100.0 * 100000000).mPosition.x - expected) > 1e-3f) {
+            LogError("Animation evaluator loses precision on large frames");
+            return false;
+        }
+
+        // Play forward, then jump around in time so the cached keys have to be searched again
+        AnimationPose poses[2];
+        for (int i = 0; i < 2000; i++) {
+            float frame = i < 1000 ? i * 0.37f : (float)(rand() % 50000) / 100;
+            evaluator.Evaluate(frame, poses);
+            for (u32 c = 0; c < 2; c++) {
+                Vector3 reference = ReferencePosition(scene.mAnimations[c], scene.mAnimations[c].mChannels[0], frame);
+                if (std::abs(poses[c].mPosition.x - reference.x) > 1e-3f) {
+                    LogError("Animation channel %u at frame %f is %f, expected %f", c, frame, poses[c].mPosition.x, reference.x);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
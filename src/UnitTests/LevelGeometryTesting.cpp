@@ -0,0 +1,139 @@
+#include "FileTypes/LevelGeometry/GeometryExporter.h"
+#include "FileTypes/LevelGeometry/LevelGeometry.h"
+#include "UnitTests/LevelGeometryTests.h"
+#include "core/filesystem.h"
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+namespace SPMEditor::Testing {
+    constexpr u32 GridSize = 3; // Quads on each side of the test mesh
+
+    // A single untextured mesh of GridSize x GridSize quads, the kind of mesh that shares most of its vertices between strips
+    static aiScene* CreateGridScene() {
+        constexpr u32 Side = GridSize + 1;
+        aiMesh* mesh = new aiMesh();
+        mesh->mName = aiString("grid");
+        mesh->mNumVertices = Side * Side;
+        mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+        mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+        mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+        mesh->mNumUVComponents[0] = 2;
+        for (u32 y = 0; y < Side; y++) {
+            for (u32 x = 0; x < Side; x++) {
+                u32 v = y * Side + x;
+                mesh->mVertices[v] = aiVector3D((float)x, 0, (float)y);
+                mesh->mNormals[v] = aiVector3D(0, 1, 0);
+                mesh->mTextureCoords[0][v] = aiVector3D((float)x / GridSize, (float)y / GridSize, 0);
+            }
+        }
+
+        mesh->mNumFaces = GridSize * GridSize * 2;
+        mesh->mFaces = new aiFace[mesh->mNumFaces];
+        for (u32 y = 0, f = 0; y < GridSize; y++) {
+            for (u32 x = 0; x < GridSize; x++) {
+                u32 v = y * Side + x;
+                mesh->mFaces[f].mNumIndices = 3;
+                mesh->mFaces[f++].mIndices = new u32[3] { v, v + 1, v + Side };
+                mesh->mFaces[f].mNumIndices = 3;
+                mesh->mFaces[f++].mIndices = new u32[3] { v + 1, v + Side + 1, v + Side };
+            }
+        }
+
+        aiMaterial* material = new aiMaterial();
+        aiString materialName("grid_material");
+        material->AddProperty(&materialName, AI_MATKEY_NAME);
+
+        aiScene* scene = new aiScene();
+        scene->mNumMeshes = 1;
+        scene->mMeshes = new aiMesh*[1] { mesh };
+        scene->mNumMaterials = 1;
+        scene->mMaterials = new aiMaterial*[1] { material };
+        scene->mRootNode = new aiNode();
+        scene->mRootNode->mName = aiString("RootNode");
+        scene->mRootNode->mNumMeshes = 1;
+        scene->mRootNode->mMeshes = new u32[1] { 0 };
+        return scene;
+    }
+
+    static bool ScenesMatch(const Scene* a, const Scene* b) {
+        if (a->mMeshCount != b->mMeshCount || a->mMaterialCount != b->mMaterialCount || a->mNodeCount != b->mNodeCount)
+            return false;
+
+        for (u32 i = 0; i < a->mNodeCount; i++) {
+            if (strcmp(a->mNodes[i].mName, b->mNodes[i].mName) != 0 || a->mNodes[i].mMeshCount != b->mNodes[i].mMeshCount)
+                return false;
+        }
+
+        for (u32 i = 0; i < a->mMeshCount; i++) {
+            const SceneMesh& meshA = a->mMeshes[i];
+            const SceneMesh& meshB = b->mMeshes[i];
+            if (meshA.mVertexCount != meshB.mVertexCount || meshA.mIndexCount != meshB.mIndexCount || meshA.mMaterialIndex != meshB.mMaterialIndex)
+                return false;
+
+            if (memcmp(meshA.mPositions, meshB.mPositions, meshA.mVertexCount * sizeof(Vector3)) != 0
+                    || memcmp(meshA.mNormals, meshB.mNormals, meshA.mVertexCount * sizeof(Vector3)) != 0
+                    || memcmp(meshA.mUVs, meshB.mUVs, meshA.mVertexCount * sizeof(Vector2)) != 0
+                    || memcmp(meshA.mIndices, meshB.mIndices, meshA.mIndexCount * sizeof(u32)) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool TestLevelGeometryParallelLoad() {
+        // Export a map to load back, the exporter writes to dvd/map/<name> in the output directory
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "spme_geometry_test";
+        std::filesystem::create_directories(directory / "dvd" / "map" / "test");
+
+        aiScene* source = CreateGridScene();
+        MapConfig config;
+        config.mMapName = "test";
+        config.mMaterialConfigs.push_back({ .mName = "grid_material", .mUseTransparency = false, .mUseVertexColor = false });
+        std::unique_ptr<GeometryExporter> exporter(GeometryExporter::Create());
+        exporter->Write(source, config, directory.string());
+        delete source;
+
+        std::string mapPath = (directory / "dvd" / "map" / "test" / "map.dat").string();
+        FileHandle file = filesystem_read_file(mapPath.c_str());
+        std::unique_ptr<u8[]> data((u8*)file.data);
+        TPL textures = TPL::LoadFromFile((directory / "dvd" / "map" / "test" / "texture.tpl").string());
+        std::filesystem::remove_all(directory);
+
+        std::unique_ptr<Scene> reference(LevelGeometry::LoadFromBytes(data.get(), file.size, textures, nullptr));
+        if (reference->mMeshCount != 1) {
+            LogError("Map loaded with %u meshes, expected 1", reference->mMeshCount);
+            return false;
+        }
+
+        // Strips repeat the grid's vertices, which the loader merges back into one vertex per position, normal and uv
+        const SceneMesh& mesh = reference->mMeshes[0];
+        constexpr u32 VertexCount = (GridSize + 1) * (GridSize + 1);
+        constexpr u32 IndexCount = GridSize * GridSize * 6;
+        if (mesh.mVertexCount != VertexCount || mesh.mIndexCount != IndexCount) {
+            LogError("Grid loaded with %u vertices and %u indices, expected %u and %u", mesh.mVertexCount, mesh.mIndexCount, VertexCount, IndexCount);
+            return false;
+        }
+
+        // Every load has its own parse state, so loads on other threads must give the same scene
+        constexpr u32 ThreadCount = 8;
+        std::unique_ptr<Scene> scenes[ThreadCount];
+        std::vector<std::thread> threads;
+        for (u32 i = 0; i < ThreadCount; i++) {
+            threads.emplace_back([&, i]() { scenes[i].reset(LevelGeometry::LoadFromBytes(data.get(), file.size, textures, nullptr)); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (u32 i = 0; i < ThreadCount; i++) {
+            if (!ScenesMatch(reference.get(), scenes[i].get())) {
+                LogError("Map loaded on thread %u does not match the map loaded on the main thread", i);
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,347 @@
+#include "FileTypes/TPL.h"
+#include "FileTypes/TPLEncoder.h"
+#include "UnitTests/TPLTests.h"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace SPMEditor::Testing {
+    // Writes the TPL to a temporary file and loads it back, also as a view when one is given
+    static TPL WriteAndLoad(TPL& tpl, const char* name, TPLView* view = nullptr) {
+        std::string path = (std::filesystem::temp_directory_path() / name).string();
+        tpl.Write(path);
+        TPL loaded = TPL::LoadFromFile(path);
+        if (view)
+            *view = TPLView::LoadFromFile(path);
+        std::filesystem::remove(path);
+        return loaded;
+    }
+
+    // Returns the first pixel with a channel more than tolerance off, or count when they all match
+    static size_t FindPixelMismatch(const Color* expected, const Color* actual, size_t count, int tolerance) {
+        for (size_t i = 0; i < count; i++) {
+            Color a = expected[i];
+            Color b = actual[i];
+            if (abs(a.r - b.r) > tolerance || abs(a.g - b.g) > tolerance || abs(a.b - b.b) > tolerance || abs(a.a - b.a) > tolerance)
+                return i;
+        }
+
+        return count;
+    }
+
+
+    bool TestTPLDecoderBackends() {
+        const TPLImageFormat formats[] = {
+            TPLImageFormat::RGB565,
+            TPLImageFormat::RGB5A3,
+            TPLImageFormat::RGBA32,
+            TPLImageFormat::CMPR,
+        };
+
+        // Decode random blocks with every backend and make sure they match the scalar reference
+        constexpr int Stride = 16;
+        for (TPLImageFormat format : formats) {
+            for (int i = 0; i < 1000; i++) {
+                u8 block[64];
+                for (u8& byte : block) {
+                    byte = rand() % 256;
+                }
+
+                Color reference[Stride * 8] = {};
+                Color sse41[Stride * 8] = {};
+                Color avx2[Stride * 8] = {};
+                TPL::GetBlockDecoder(format, TPL::DecoderBackend::Scalar)(block, reference, Stride);
+                TPL::GetBlockDecoder(format, TPL::DecoderBackend::SSE41)(block, sse41, Stride);
+                TPL::GetBlockDecoder(format, TPL::DecoderBackend::AVX2)(block, avx2, Stride);
+
+                if (memcmp(reference, sse41, sizeof(reference)) != 0) {
+                    LogError("SSE4.1 decoder for format %d does not match the scalar decoder", (int)format);
+                    return false;
+                }
+
+                if (memcmp(reference, avx2, sizeof(reference)) != 0) {
+                    LogError("AVX2 decoder for format %d does not match the scalar decoder", (int)format);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool TestTPLCMPREncoder() {
+        // A diagonal gradient with transparent holes, sized so the edge blocks need padding.
+        // The colors of each sub block lie on a line, so DXT1 can represent them closely
+        constexpr int Width = 21;
+        constexpr int Height = 13;
+        Color pixels[Width * Height];
+        for (int y = 0; y < Height; y++) {
+            for (int x = 0; x < Width; x++) {
+                u8 t = (x + y) * 7;
+                pixels[y * Width + x] = Color(t, 0xff - t, t / 2, (x * y) % 5 == 1 ? 0 : 0xff);
+            }
+        }
+
+        const TPLCompressionQuality qualities[] = { TPLCompressionQuality::Fast, TPLCompressionQuality::High };
+        for (TPLCompressionQuality quality : qualities) {
+            std::vector<u8> data = TPLEncoder::EncodeImage(pixels, Width, Height, TPLImageFormat::CMPR, quality);
+            if (data.size() != TPL::GetImageDataSize(TPLImageFormat::CMPR, Width, Height)) {
+                LogError("CMPR encoder wrote %zu bytes, expected %u", data.size(), TPL::GetImageDataSize(TPLImageFormat::CMPR, Width, Height));
+                return false;
+            }
+
+            constexpr int BlocksX = (Width + 7) / 8;
+            constexpr int BlocksY = (Height + 7) / 8;
+            constexpr int Stride = BlocksX * 8;
+            Color decoded[Stride * BlocksY * 8];
+            TPL::BlockDecoder decode = TPL::GetBlockDecoder(TPLImageFormat::CMPR, TPL::DecoderBackend::Scalar);
+            for (int i = 0; i < BlocksX * BlocksY; i++) {
+                decode(data.data() + i * 32, decoded + (i / BlocksX) * 8 * Stride + (i % BlocksX) * 8, Stride);
+            }
+
+            for (int y = 0; y < Height; y++) {
+                for (int x = 0; x < Width; x++) {
+                    Color expected = pixels[y * Width + x];
+                    Color actual = decoded[y * Stride + x];
+                    if ((expected.a == 0) != (actual.a == 0)) {
+                        LogError("CMPR encoder lost the alpha of pixel (%d, %d)", x, y);
+                        return false;
+                    }
+
+                    // Every opaque pixel should land near its original color
+                    if (expected.a != 0 && (abs(expected.r - actual.r) > 16 || abs(expected.g - actual.g) > 16 || abs(expected.b - actual.b) > 16)) {
+                        LogError("CMPR encoder error too large at pixel (%d, %d)", x, y);
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool TestTPLPaletteRoundTrip() {
+        // Few enough colors that C8 is lossless, and alpha gradients that CMPR can't keep
+        constexpr int Width = 19;
+        constexpr int Height = 11;
+        TPL tpl;
+        const TPLImageFormat formats[] = { TPLImageFormat::C8, TPLImageFormat::C4 };
+        for (TPLImageFormat format : formats) {
+            TPL::Image image = {};
+            image.header.width = Width;
+            image.header.height = Height;
+            image.header.format = format;
+            image.name = TPL::GetFormatName(format);
+            image.pixels.resize(Width * Height);
+            for (int i = 0; i < Width * Height; i++) {
+                u8 shade = (i % 12) * 0x11;
+                image.pixels[i] = Color(shade, 0xff - shade, 0x40, (i / 12 % 4) * 0x55);
+            }
+
+            tpl.images.push_back(image);
+        }
+
+        TPL loaded = WriteAndLoad(tpl, "spme_palette_test.tpl");
+
+        if (loaded.images.size() != tpl.images.size()) {
+            LogError("Palette round trip wrote %zu images but read %zu", tpl.images.size(), loaded.images.size());
+            return false;
+        }
+
+        for (size_t i = 0; i < tpl.images.size(); i++) {
+            const TPL::Image& expected = tpl.images[i];
+            const TPL::Image& actual = loaded.images[i];
+            if (actual.header.format != expected.header.format || actual.pixels.size() != expected.pixels.size()) {
+                LogError("Palette round trip changed the format or size of image %zu", i);
+                return false;
+            }
+
+            // C8 holds every color, only the RGB5A3 quantization is lost. C4 has to merge colors
+            int tolerance = expected.header.format == TPLImageFormat::C8 ? 0x12 : 0x60;
+            size_t mismatch = FindPixelMismatch(expected.pixels.data(), actual.pixels.data(), expected.pixels.size(), tolerance);
+            if (mismatch != expected.pixels.size()) {
+                LogError("Palette round trip of %s image differs at pixel %zu", TPL::GetFormatName(expected.header.format), mismatch);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool TestTPLAutoFormat() {
+        constexpr int Width = 32;
+        constexpr int Height = 16;
+        Color pixels[Width * Height];
+
+        // Grayscale images with alpha gradients can only go to IA formats or larger
+        for (int i = 0; i < Width * Height; i++) {
+            u8 shade = (i % Width) * 8;
+            pixels[i] = Color(shade, shade, shade, (i / Width) * 16);
+        }
+
+        TPLFormatChoice choice = TPLEncoder::ChooseFormat(pixels, Width, Height, TPLCompressionQuality::Fast, false);
+        if (choice.mFormat == TPLImageFormat::CMPR || choice.mFormat == TPLImageFormat::I4 || choice.mFormat == TPLImageFormat::I8) {
+            LogError("Auto format picked %s for a grayscale image with graded alpha", TPL::GetFormatName(choice.mFormat));
+            return false;
+        }
+
+        // An exact fit should be found for an image with only a few colors
+        for (int i = 0; i < Width * Height; i++) {
+            pixels[i] = (i / 3) % 2 ? Color(0xff, 0x00, 0x00, 0xff) : Color(0x00, 0x00, 0xff, 0xff);
+        }
+
+        choice = TPLEncoder::ChooseFormat(pixels, Width, Height, TPLCompressionQuality::Fast, false);
+        if (choice.mSize >= TPL::GetImageDataSize(TPLImageFormat::RGBA32, Width, Height) || choice.mPSNR < TPLEncoder::AutoFormatMinPSNR) {
+            LogError("Auto format picked %s (%u bytes, %.2f dB) for a two color image", TPL::GetFormatName(choice.mFormat), choice.mSize, choice.mPSNR);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool TestTPLMipmaps() {
+        if (TPLEncoder::GetMipmapCount(256, 64) != 9 || TPLEncoder::GetMipmapCount(100, 64) != 1 || TPLEncoder::GetMipmapCount(1, 1) != 1) {
+            LogError("Wrong mipmap count");
+            return false;
+        }
+
+        // Black and white average to linear half intensity, not sRGB 128
+        Color checker[4] = { Color(0, 0, 0, 0xff), Color(0xff, 0xff, 0xff, 0xff), Color(0xff, 0xff, 0xff, 0xff), Color(0, 0, 0, 0xff) };
+        Color gray = TPLEncoder::Downsample(checker, 2, 2)[0];
+        if (abs(gray.r - 188) > 1 || gray.r != gray.g || gray.g != gray.b || gray.a != 0xff) {
+            LogError("Downsampling is not gamma correct, got %u %u %u %u", gray.r, gray.g, gray.b, gray.a);
+            return false;
+        }
+
+        // Transparent pixels must not bleed their color
+        Color cutout[4] = { Color(0xff, 0, 0, 0xff), Color(0, 0xff, 0, 0), Color(0, 0xff, 0, 0), Color(0xff, 0, 0, 0xff) };
+        Color red = TPLEncoder::Downsample(cutout, 2, 2)[0];
+        if (red.r != 0xff || red.g != 0 || red.b != 0 || abs(red.a - 0x80) > 1) {
+            LogError("Downsampling bled transparent colors, got %u %u %u %u", red.r, red.g, red.b, red.a);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool TestTPLResize() {
+        // A flat color survives the filter, even with sizes that aren't multiples of each other
+        constexpr int Width = 37;
+        constexpr int Height = 23;
+        std::vector<Color> flat(Width * Height, Color(0x40, 0x80, 0xc0, 0xff));
+        std::vector<Color> resized = TPLEncoder::Resize(flat.data(), Width, Height, 16, 12);
+        if (resized.size() != 16 * 12) {
+            LogError("Resized image has %zu pixels instead of %d", resized.size(), 16 * 12);
+            return false;
+        }
+
+        for (const Color& color : resized) {
+            if (abs(color.r - 0x40) > 1 || abs(color.g - 0x80) > 1 || abs(color.b - 0xc0) > 1 || color.a != 0xff) {
+                LogError("Resizing changed a flat color to %u %u %u %u", color.r, color.g, color.b, color.a);
+                return false;
+            }
+        }
+
+        // Transparent pixels must not bleed their color into the opaque half
+        std::vector<Color> cutout(64 * 64);
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                cutout[y * 64 + x] = x < 32 ? Color(0xff, 0, 0, 0xff) : Color(0, 0xff, 0, 0);
+            }
+        }
+
+        resized = TPLEncoder::Resize(cutout.data(), 64, 64, 24, 24);
+        for (const Color& color : resized) {
+            if (color.a > 0 && (color.r < 0xfe || color.g > 1 || color.b > 1)) {
+                LogError("Resizing bled transparent colors, got %u %u %u %u", color.r, color.g, color.b, color.a);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool TestTPLParallelDecode() {
+        // Large enough images that LoadFromBytes splits them into several bands
+        constexpr int Width = 300;
+        constexpr int Height = 250;
+        TPL tpl;
+        const TPLImageFormat formats[] = { TPLImageFormat::RGBA32, TPLImageFormat::CMPR, TPLImageFormat::C8, TPLImageFormat::IA4 };
+        for (TPLImageFormat format : formats) {
+            TPL::Image image = {};
+            image.header.width = Width;
+            image.header.height = Height;
+            image.header.format = format;
+            image.name = TPL::GetFormatName(format);
+            image.pixels.resize(Width * Height);
+            for (Color& pixel : image.pixels) {
+                pixel = Color(rand() % 256, rand() % 256, rand() % 256, rand() % 2 ? 0xff : 0);
+            }
+
+            tpl.images.push_back(image);
+        }
+
+        TPL parallel = WriteAndLoad(tpl, "spme_parallel_test.tpl");
+
+        // Re-encode each image on its own and decode it serially to get the reference
+        for (size_t i = 0; i < tpl.images.size(); i++) {
+            const TPL::Image& image = tpl.images[i];
+            TPLPalette palette;
+            bool hasPalette = TPL::IsPaletteFormat(image.header.format);
+            std::vector<u8> data = TPLEncoder::EncodeImage(image.pixels.data(), Width, Height, image.header.format, image.quality, image.dither, hasPalette ? &palette : nullptr);
+
+            std::vector<Color> reference(Width * Height);
+            TPL::DecodeImage(data.data(), Width, Height, image.header.format, reference.data(), hasPalette ? palette.mColors.data() : nullptr);
+            if (FindPixelMismatch(reference.data(), parallel.images[i].pixels.data(), reference.size(), 0) != reference.size()) {
+                LogError("Parallel decode of %s image does not match the serial decode", TPL::GetFormatName(image.header.format));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool TestTPLLazyDecode() {
+        TPL tpl;
+        const TPLImageFormat formats[] = { TPLImageFormat::RGB5A3, TPLImageFormat::C4, TPLImageFormat::I8 };
+        for (TPLImageFormat format : formats) {
+            TPL::Image image = {};
+            image.header.width = 24;
+            image.header.height = 20;
+            image.header.format = format;
+            image.pixels.resize(24 * 20);
+            for (Color& pixel : image.pixels) {
+                pixel = Color(rand() % 256, rand() % 256, rand() % 256, 0xff);
+            }
+
+            tpl.images.push_back(image);
+        }
+
+        TPLView view;
+        TPL loaded = WriteAndLoad(tpl, "spme_lazy_test.tpl", &view);
+
+        if (view.GetImageCount() != loaded.images.size()) {
+            LogError("Lazy TPL has %u images, expected %zu", view.GetImageCount(), loaded.images.size());
+            return false;
+        }
+
+        // Decode out of order, each image must not depend on the ones before it
+        for (int i = view.GetImageCount() - 1; i >= 0; i--) {
+            const TPL::Image& expected = loaded.images[i];
+            if (memcmp(&view.GetImageHeader(i), &expected.header, sizeof(TPL::ImageHeader)) != 0) {
+                LogError("Lazy TPL header of image %d does not match", i);
+                return false;
+            }
+
+            const size_t count = expected.pixels.size();
+            std::vector<Color> pixels(count);
+            view.DecodeImageInto(i, pixels);
+            if (FindPixelMismatch(expected.pixels.data(), pixels.data(), count, 0) != count || FindPixelMismatch(expected.pixels.data(), view.DecodeImage(i).pixels.data(), count, 0) != count) {
+                LogError("Lazy decode of %s image does not match the full load", TPL::GetFormatName(expected.header.format));
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
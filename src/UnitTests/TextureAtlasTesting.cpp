@@ -0,0 +1,64 @@
+#include "FileTypes/LevelGeometry/TextureAtlas.h"
+#include "UnitTests/TextureAtlasTests.h"
+#include <cstdlib>
+
+namespace SPMEditor::Testing {
+
+    bool TestTextureAtlasPacking() {
+        constexpr int PageSize = 256;
+        std::vector<TextureAtlasRect> rects;
+        for (int i = 0; i < 200; i++) {
+            rects.push_back({ .mWidth = 1 + rand() % 64, .mHeight = 1 + rand() % 64 });
+        }
+
+        std::vector<TextureAtlasPage> pages = TextureAtlas::Pack(rects, PageSize);
+
+        // Every texture and its guard band must be inside its page, start on a block and not overlap any other
+        constexpr int Guard = TextureAtlas::GuardBand;
+        for (size_t i = 0; i < rects.size(); i++) {
+            const TextureAtlasRect& a = rects[i];
+            if (a.mPage < 0 || a.mPage >= (int)pages.size() || a.mX % 4 != 0 || a.mY % 4 != 0) {
+                LogError("Atlas rect %zu was not placed on a block, page %d at %d, %d", i, a.mPage, a.mX, a.mY);
+                return false;
+            }
+
+            if (a.mX - Guard < 0 || a.mY - Guard < 0 || a.mX + a.mWidth + Guard > pages[a.mPage].mWidth || a.mY + a.mHeight + Guard > pages[a.mPage].mHeight) {
+                LogError("Atlas rect %zu is outside of its %dx%d page", i, pages[a.mPage].mWidth, pages[a.mPage].mHeight);
+                return false;
+            }
+
+            for (size_t j = i + 1; j < rects.size(); j++) {
+                const TextureAtlasRect& b = rects[j];
+                if (a.mPage == b.mPage && a.mX - Guard < b.mX + b.mWidth + Guard && b.mX - Guard < a.mX + a.mWidth + Guard && a.mY - Guard < b.mY + b.mHeight + Guard && b.mY - Guard < a.mY + a.mHeight + Guard) {
+                    LogError("Atlas rects %zu and %zu overlap", i, j);
+                    return false;
+                }
+            }
+        }
+
+        // The guard band continues the texture with its wrap modes
+        std::vector<TextureAtlasRect> single = { { .mWidth = 2, .mHeight = 2 } };
+        TextureAtlasPage page = TextureAtlas::Pack(single, PageSize)[0];
+        Color texture[4] = { Color(1, 0, 0, 0xff), Color(2, 0, 0, 0xff), Color(3, 0, 0, 0xff), Color(4, 0, 0, 0xff) };
+        std::vector<Color> pixels(page.mWidth * page.mHeight);
+        TextureAtlas::Blit(texture, single[0], MapStructures::MapTexture::WrapMode::Repeat, MapStructures::MapTexture::WrapMode::Clamp, pixels.data(), page.mWidth);
+
+        const Color* origin = pixels.data() + single[0].mY * page.mWidth + single[0].mX;
+        if (origin[0].r != 1 || origin[-1].r != 2 || origin[-page.mWidth].r != 1 || origin[-page.mWidth - 1].r != 2 || origin[page.mWidth * 2].r != 3) {
+            LogError("Atlas guard band does not follow the wrap modes");
+            return false;
+        }
+
+        // The padding up to the block size is filled as well, so no block of the page is partly empty
+        for (int y = -Guard; y < 4 + Guard; y++) {
+            for (int x = -Guard; x < 4 + Guard; x++) {
+                if (origin[y * page.mWidth + x].a != 0xff) {
+                    LogError("Atlas cell pixel %d, %d was left empty", x, y);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
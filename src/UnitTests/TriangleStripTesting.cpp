@@ -0,0 +1,106 @@
+#include "FileTypes/LevelGeometry/TriangleStripper.h"
+#include "UnitTests/TriangleStripTests.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace SPMEditor::Testing {
+
+    // Rotates a triangle to start at its smallest vertex, which keeps its winding
+    static std::array<u32, 3> Canonical(u32 a, u32 b, u32 c) {
+        if (b < a && b < c)
+            return { b, c, a };
+        if (c < a && c < b)
+            return { c, a, b };
+        return { a, b, c };
+    }
+
+    // Decodes strips the way LevelGeometry::ReadVertices does
+    static std::vector<std::array<u32, 3>> DecodeStrips(const std::vector<std::vector<u32>>& strips) {
+        std::vector<std::array<u32, 3>> triangles;
+        for (const std::vector<u32>& strip : strips) {
+            for (size_t i = 2; i < strip.size(); i++) {
+                u32 a = strip[i - 2], b = strip[i - 1], c = strip[i];
+                if (a == b || b == c || a == c)
+                    continue;
+                triangles.push_back(i % 2 == 0 ? Canonical(a, b, c) : Canonical(c, b, a));
+            }
+        }
+
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    static bool CheckStrips(const char* name, const std::vector<u32>& triangles, bool stitch, u32 maxLength, u32& vertexCount, u32& stripCount) {
+        std::vector<std::array<u32, 3>> expected;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            if (triangles[t] != triangles[t + 1] && triangles[t + 1] != triangles[t + 2] && triangles[t] != triangles[t + 2])
+                expected.push_back(Canonical(triangles[t], triangles[t + 1], triangles[t + 2]));
+        }
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<std::vector<u32>> strips = TriangleStripper::Build(triangles, stitch, maxLength);
+        vertexCount = 0;
+        for (const std::vector<u32>& strip : strips) {
+            if (strip.size() < 3 || strip.size() > maxLength) {
+                LogError("%s: strip of %zu vertices is outside of 3-%u", name, strip.size(), maxLength);
+                return false;
+            }
+            vertexCount += strip.size();
+        }
+        stripCount = strips.size();
+
+        // Every triangle has to come out exactly once with its winding
+        if (DecodeStrips(strips) != expected) {
+            LogError("%s: strips do not contain the same triangles as the mesh (stitch %d, max length %u)", name, stitch, maxLength);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool TestTriangleStrips() {
+        // A grid with consistent winding, which should become a few long strips
+        constexpr u32 GridSize = 32;
+        std::vector<u32> grid;
+        for (u32 y = 0; y < GridSize; y++) {
+            for (u32 x = 0; x < GridSize; x++) {
+                u32 v = y * (GridSize + 1) + x;
+                grid.insert(grid.end(), { v, v + 1, v + GridSize + 1 });
+                grid.insert(grid.end(), { v + 1, v + GridSize + 2, v + GridSize + 1 });
+            }
+        }
+
+        u32 vertexCount, stripCount;
+        u32 triangleCount = grid.size() / 3;
+        if (!CheckStrips("Grid", grid, false, TriangleStripper::MaxStripLength, vertexCount, stripCount))
+            return false;
+        if (vertexCount > triangleCount * 3 / 2) {
+            LogError("Grid of %u triangles took %u strip vertices in %u strips", triangleCount, vertexCount, stripCount);
+            return false;
+        }
+
+        if (!CheckStrips("Stitched grid", grid, true, TriangleStripper::MaxStripLength, vertexCount, stripCount))
+            return false;
+        if (stripCount != 1) {
+            LogError("Stitched grid has %u strips", stripCount);
+            return false;
+        }
+
+        if (!CheckStrips("Short grid strips", grid, true, 16, vertexCount, stripCount))
+            return false;
+
+        // Random triangles with shared, degenerate and non manifold edges
+        std::vector<u32> soup;
+        for (int i = 0; i < 3000; i++) {
+            soup.push_back(rand() % 200);
+        }
+        soup.insert(soup.end(), { 1, 1, 2 });
+        for (u32 maxLength : { 3u, 4u, 5u, TriangleStripper::MaxStripLength }) {
+            if (!CheckStrips("Soup", soup, false, maxLength, vertexCount, stripCount) || !CheckStrips("Stitched soup", soup, true, maxLength, vertexCount, stripCount))
+                return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,60 @@
+#include "FileTypes/LevelGeometry/VertexCache.h"
+#include "UnitTests/VertexCacheTests.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace SPMEditor::Testing {
+
+    static std::vector<std::array<u32, 3>> SortedTriangles(const std::vector<u32>& triangles) {
+        std::vector<std::array<u32, 3>> sorted;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            sorted.push_back({ triangles[t], triangles[t + 1], triangles[t + 2] });
+        }
+
+        std::sort(sorted.begin(), sorted.end());
+        return sorted;
+    }
+
+    bool TestVertexCacheOptimize() {
+        // A FIFO cache doesn't move vertices to the front when they are used again
+        std::vector<u32> stream = { 0, 1, 2, 0, 1, 2, 3, 4, 0 };
+        if (VertexCache::CountMisses(stream.data(), stream.size(), 4) != 6) {
+            LogError("Vertex cache simulation counted %u misses, expected 6", VertexCache::CountMisses(stream.data(), stream.size(), 4));
+            return false;
+        }
+
+        // A grid with its triangles shuffled, like a mesh exported in no particular order
+        constexpr u32 GridSize = 48;
+        std::vector<u32> grid;
+        for (u32 y = 0; y < GridSize; y++) {
+            for (u32 x = 0; x < GridSize; x++) {
+                u32 v = y * (GridSize + 1) + x;
+                grid.insert(grid.end(), { v, v + 1, v + GridSize + 1 });
+                grid.insert(grid.end(), { v + 1, v + GridSize + 2, v + GridSize + 1 });
+            }
+        }
+        grid.insert(grid.end(), { 7, 7, 8 });
+
+        u32 triangleCount = grid.size() / 3;
+        for (u32 t = triangleCount - 1; t > 0; t--) {
+            u32 other = rand() % (t + 1);
+            std::swap_ranges(grid.begin() + t * 3, grid.begin() + t * 3 + 3, grid.begin() + other * 3);
+        }
+
+        std::vector<u32> optimized = VertexCache::Optimize(grid, (GridSize + 1) * (GridSize + 1));
+        if (SortedTriangles(optimized) != SortedTriangles(grid)) {
+            LogError("Vertex cache optimization changed the mesh's triangles");
+            return false;
+        }
+
+        float before = (float)VertexCache::CountMisses(grid.data(), grid.size()) / triangleCount;
+        float after = (float)VertexCache::CountMisses(optimized.data(), optimized.size()) / triangleCount;
+        if (after > 0.8f) {
+            LogError("Vertex cache optimization only got the ACMR from %f to %f", before, after);
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -2,6 +2,7 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <mutex>
 
 namespace SPMEditor {
     
@@ -12,6 +13,7 @@ namespace SPMEditor {
     };
 
     static LoggingContext* context;
+    static std::mutex s_LogMutex; // Logs can come from parallel_for jobs, which would otherwise share messageBuffer
 
     void LoggingInitialize() {
         context = new LoggingContext();
@@ -29,6 +31,8 @@ namespace SPMEditor {
             "\x1B[31m[FATAL]: ",
         };
 
+        std::lock_guard lock(s_LogMutex);
+
         // Format original message.
         // NOTE: Oddly enough, MS's headers override the GCC/Clang va_list type with a "typedef char* va_list" in some
         // cases, and as a result throws a strange error here. The workaround for now is to just use __builtin_va_list,
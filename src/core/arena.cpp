@@ -0,0 +1,93 @@
+#include "core/arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace SPMEditor {
+    struct ArenaBlock {
+        ArenaBlock* previous;
+        u64 size;
+        u64 used;
+        // Followed by size bytes of memory
+    };
+
+    struct Arena {
+        std::mutex mutex;
+        ArenaBlock* current;
+        u64 blockSize;
+        u64 used;
+    };
+
+    static u8* BlockMemory(ArenaBlock* block) {
+        return (u8*)(block + 1);
+    }
+
+    Arena* arena_create(u64 blockSize) {
+        Arena* arena = new Arena();
+        arena->current = nullptr;
+        arena->blockSize = blockSize;
+        arena->used = 0;
+        return arena;
+    }
+
+    void arena_destroy(Arena* arena) {
+        if (arena == nullptr)
+            return;
+
+        ArenaBlock* block = arena->current;
+        while (block) {
+            ArenaBlock* previous = block->previous;
+            free(block);
+            block = previous;
+        }
+
+        delete arena;
+    }
+
+    void* arena_alloc(Arena* arena, u64 size, u64 alignment) {
+        std::lock_guard lock(arena->mutex);
+        arena->used += size;
+
+        ArenaBlock* block = arena->current;
+        if (block) {
+            u64 start = ((u64)BlockMemory(block) + block->used + alignment - 1) & ~(alignment - 1);
+            u64 offset = start - (u64)BlockMemory(block);
+            if (offset + size <= block->size) {
+                block->used = offset + size;
+                return (void*)start;
+            }
+        }
+
+        // Blocks come from calloc, and memory is never reused, so every allocation starts out zeroed.
+        // Oversized allocations get a block of their own, behind the current one so its free space isn't lost
+        u64 blockSize = std::max(arena->blockSize, size + alignment);
+        ArenaBlock* newBlock = (ArenaBlock*)calloc(1, sizeof(ArenaBlock) + blockSize);
+        Assert(newBlock != nullptr, "Failed to allocate an arena block of %llu bytes", (unsigned long long)blockSize);
+        newBlock->size = blockSize;
+
+        u64 start = ((u64)BlockMemory(newBlock) + alignment - 1) & ~(alignment - 1);
+        newBlock->used = start - (u64)BlockMemory(newBlock) + size;
+
+        if (block && blockSize > arena->blockSize) {
+            newBlock->previous = block->previous;
+            block->previous = newBlock;
+        } else {
+            newBlock->previous = block;
+            arena->current = newBlock;
+        }
+
+        return (void*)start;
+    }
+
+    const char* arena_copy_string(Arena* arena, const char* string) {
+        u64 length = strlen(string);
+        char* copy = (char*)arena_alloc(arena, length + 1, 1);
+        memcpy(copy, string, length); // The terminator is already there, arena memory is zeroed
+        return copy;
+    }
+
+    u64 arena_used(const Arena* arena) {
+        return arena->used;
+    }
+}
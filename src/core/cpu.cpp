@@ -0,0 +1,54 @@
+#include "core/cpu.h"
+#include <cstdlib>
+
+#if defined(SPME_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace SPMEditor {
+    struct CPUFeatures {
+        bool sse41;
+        bool avx2;
+    };
+
+    static CPUFeatures DetectCPUFeatures() {
+        CPUFeatures features = {};
+        if (getenv("SPME_NO_SIMD") != nullptr)
+            return features;
+
+#if defined(SPME_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        features.sse41 = __builtin_cpu_supports("sse4.1");
+        features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(SPME_X86) && defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        features.sse41 = (info[2] & (1 << 19)) != 0;
+        bool osSavesYMM = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6; // OSXSAVE and XMM/YMM state enabled
+
+        if (maxLeaf >= 7 && osSavesYMM) {
+            __cpuidex(info, 7, 0);
+            features.avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#endif
+
+        return features;
+    }
+
+    static const CPUFeatures& GetCPUFeatures() {
+        static const CPUFeatures features = DetectCPUFeatures();
+        return features;
+    }
+
+    bool cpu_has_sse41() {
+        return GetCPUFeatures().sse41;
+    }
+
+    bool cpu_has_avx2() {
+        return GetCPUFeatures().avx2;
+    }
+}
@@ -0,0 +1,48 @@
+#include "core/hash.h"
+#include <cstring>
+
+namespace SPMEditor {
+    static constexpr u64 HashPrime1 = 0x9E3779B185EBCA87ull;
+    static constexpr u64 HashPrime2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr u64 HashPrime3 = 0x165667B19E3779F9ull;
+
+    static inline u64 RotateLeft(u64 value, int amount) {
+        return (value << amount) | (value >> (64 - amount));
+    }
+
+    // Final avalanche so that small differences in the input change every output bit
+    static inline u64 Finalize(u64 hash) {
+        hash ^= hash >> 33;
+        hash *= HashPrime2;
+        hash ^= hash >> 29;
+        hash *= HashPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    u64 hash_bytes(const void* data, u64 size, u64 seed) {
+        const u8* bytes = (const u8*)data;
+        u64 hash = seed + HashPrime3 + size;
+
+        // Bulk of the data is consumed 8 bytes at a time
+        u64 i = 0;
+        for (; i + 8 <= size; i += 8) {
+            u64 word;
+            memcpy(&word, bytes + i, sizeof(word)); // memcpy since the input is not guaranteed to be aligned
+            hash ^= RotateLeft(word * HashPrime2, 31) * HashPrime1;
+            hash = RotateLeft(hash, 27) * HashPrime1 + HashPrime3;
+        }
+
+        // Then the remaining tail one byte at a time
+        for (; i < size; i++) {
+            hash ^= bytes[i] * HashPrime3;
+            hash = RotateLeft(hash, 11) * HashPrime1;
+        }
+
+        return Finalize(hash);
+    }
+
+    u64 hash_combine(u64 hash, u64 value) {
+        return Finalize(hash ^ (RotateLeft(value * HashPrime2, 31) * HashPrime1));
+    }
+}
@@ -0,0 +1,133 @@
+#include "core/jobs.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SPMEditor {
+    // Set on worker threads and on a thread while it runs parallel_for, so nested calls don't wait on themselves
+    static thread_local bool t_InParallelFor = false;
+
+    class ThreadPool {
+        public:
+            ThreadPool(u32 threadCount) {
+                for (u32 i = 1; i < threadCount; i++) {
+                    m_Workers.emplace_back([this]() { WorkerLoop(); });
+                }
+            }
+
+            ~ThreadPool() {
+                {
+                    std::lock_guard lock(m_Mutex);
+                    m_Stop = true;
+                }
+
+                m_WakeCondition.notify_all();
+                for (std::thread& worker : m_Workers) {
+                    worker.join();
+                }
+            }
+
+            u32 GetThreadCount() const { return m_Workers.size() + 1; }
+
+            bool TryRun(u32 count, const std::function<void(u32)>& job) {
+                // Only one batch runs at a time, other threads fall back to running their jobs serially
+                std::unique_lock runLock(m_RunMutex, std::try_to_lock);
+                if (!runLock.owns_lock())
+                    return false;
+
+                {
+                    std::lock_guard lock(m_Mutex);
+                    m_Job = &job;
+                    m_JobCount = count;
+                    m_NextJob = 0;
+                    m_ActiveWorkers = m_Workers.size();
+                    m_Generation++;
+                }
+
+                m_WakeCondition.notify_all();
+                RunJobs();
+
+                std::unique_lock lock(m_Mutex);
+                m_DoneCondition.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+                m_Job = nullptr;
+                return true;
+            }
+
+        private:
+            void RunJobs() {
+                for (u32 i = m_NextJob++; i < m_JobCount; i = m_NextJob++) {
+                    (*m_Job)(i);
+                }
+            }
+
+            void WorkerLoop() {
+                t_InParallelFor = true;
+                u64 generation = 0;
+                while (true) {
+                    {
+                        std::unique_lock lock(m_Mutex);
+                        m_WakeCondition.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+                        if (m_Stop)
+                            return;
+                        generation = m_Generation;
+                    }
+
+                    RunJobs();
+
+                    std::lock_guard lock(m_Mutex);
+                    if (--m_ActiveWorkers == 0)
+                        m_DoneCondition.notify_one();
+                }
+            }
+
+            std::vector<std::thread> m_Workers;
+            std::mutex m_RunMutex;
+            std::mutex m_Mutex;
+            std::condition_variable m_WakeCondition;
+            std::condition_variable m_DoneCondition;
+
+            const std::function<void(u32)>* m_Job = nullptr;
+            u32 m_JobCount = 0;
+            std::atomic<u32> m_NextJob = 0;
+            u32 m_ActiveWorkers = 0;
+            u64 m_Generation = 0;
+            bool m_Stop = false;
+    };
+
+    static u32 GetConfiguredThreadCount() {
+        const char* threads = getenv("SPME_THREADS");
+        if (threads != nullptr && atoi(threads) > 0)
+            return atoi(threads);
+
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    static ThreadPool& GetThreadPool() {
+        static ThreadPool pool(GetConfiguredThreadCount());
+        return pool;
+    }
+
+    u32 parallel_thread_count() {
+        return GetThreadPool().GetThreadCount();
+    }
+
+    void parallel_for(u32 count, const std::function<void(u32 index)>& job) {
+        if (count == 0)
+            return;
+
+        if (count > 1 && !t_InParallelFor && GetThreadPool().GetThreadCount() > 1) {
+            t_InParallelFor = true;
+            bool ran = GetThreadPool().TryRun(count, job);
+            t_InParallelFor = false;
+            if (ran)
+                return;
+        }
+
+        for (u32 i = 0; i < count; i++) {
+            job(i);
+        }
+    }
+}
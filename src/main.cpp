@@ -62,10 +62,16 @@ Command mapCommands[] = {
 Command tplCommands[] = {
     {
         .name = "dump",
-        .format = "<texture.tpl> <output directory>",
-        .description = "Writes all textures in a tpl to a directory",
+        .format = "<texture.tpl> <output directory> [fpng|stb]",
+        .description = "Writes all textures in a tpl to a directory as pngs. Uses fpng by default, stb is slower but makes smaller files",
         .parameter_count = 2,
         .run = TPLCommands::Dump,
+    }, {
+        .name = "list",
+        .format = "<texture.tpl>",
+        .description = "Prints the size and format of every texture in a tpl without decoding them",
+        .parameter_count = 1,
+        .run = TPLCommands::List,
     },
 };
  
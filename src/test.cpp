@@ -1,5 +1,25 @@
+#include "UnitTests/AnimationTests.h"
 #include "UnitTests/LZSSTests.h"
+#include "UnitTests/LevelGeometryTests.h"
+#include "UnitTests/TPLTests.h"
+#include "UnitTests/TextureAtlasTests.h"
+#include "UnitTests/TriangleStripTests.h"
+#include "UnitTests/VertexCacheTests.h"
 
 int main() {
+    SPMEditor::LoggingInitialize();
     Assert(SPMEditor::Testing::TestLZSSCompression(), "U8 Failed compression test");
+    Assert(SPMEditor::Testing::TestTPLDecoderBackends(), "TPL SIMD decoders do not match the scalar decoders");
+    Assert(SPMEditor::Testing::TestTPLCMPREncoder(), "TPL CMPR encoder round trip failed");
+    Assert(SPMEditor::Testing::TestTPLPaletteRoundTrip(), "TPL palette round trip failed");
+    Assert(SPMEditor::Testing::TestTPLAutoFormat(), "TPL automatic format selection failed");
+    Assert(SPMEditor::Testing::TestTPLMipmaps(), "TPL mipmap generation failed");
+    Assert(SPMEditor::Testing::TestTPLResize(), "TPL resizing is not gamma correct or bleeds transparent colors");
+    Assert(SPMEditor::Testing::TestTPLParallelDecode(), "TPL parallel decode does not match the serial decode");
+    Assert(SPMEditor::Testing::TestTPLLazyDecode(), "TPL lazy decode does not match the full load");
+    Assert(SPMEditor::Testing::TestTextureAtlasPacking(), "Texture atlas packing produced overlapping or misplaced textures");
+    Assert(SPMEditor::Testing::TestAnimationEvaluator(), "Animation evaluator does not match sampling the keys directly");
+    Assert(SPMEditor::Testing::TestTriangleStrips(), "Triangle strips lost triangles, flipped their winding or are too short");
+    Assert(SPMEditor::Testing::TestVertexCacheOptimize(), "Vertex cache optimization changed triangles or did not improve the cache miss ratio");
+    Assert(SPMEditor::Testing::TestLevelGeometryParallelLoad(), "Map loads on several threads differ or strip vertices were not merged");
 }